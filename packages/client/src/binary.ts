@@ -0,0 +1,291 @@
+/**
+ * Binary Update Decoding
+ *
+ * When the client lists 'binary' in the init support array, the interpreter
+ * writes updates as binary frames instead of JSON lines (see the "Binary
+ * Update Encoding" section of protocol.zig for the record layout). Frames
+ * decode to the same RemGlkUpdate objects as the JSON updates, so nothing
+ * past the worker needs to know which encoding was used.
+ */
+
+import type {
+  ContentSpan,
+  ContentUpdate,
+  DrawOperation,
+  GridLine,
+  InputRequest,
+  RemGlkUpdate,
+  SpecialInput,
+  TextParagraph,
+  WindowUpdate,
+} from './protocol';
+import { IMAGE_ALIGNMENT_VALUES } from './protocol';
+
+/** First byte of a binary frame (never the first byte of a JSON line). */
+export const FRAME_MARKER = 0xff;
+
+// Record tags (BinaryRecord in protocol.zig)
+const RECORD_UPDATE = 1;
+const RECORD_WINDOW = 2;
+const RECORD_CONTENT = 3;
+const RECORD_PARAGRAPH = 4;
+const RECORD_TEXT = 5;
+const RECORD_IMAGE = 6;
+const RECORD_DRAW = 7;
+const RECORD_LINE = 8;
+const RECORD_INPUT = 9;
+const RECORD_SPECIALINPUT = 10;
+const RECORD_DEBUG = 11;
+
+const UPDATE_DISABLE = 1;
+const UPDATE_EXIT = 2;
+const UPDATE_WINDOWS = 4;
+const UPDATE_TIMER = 8;
+
+const INPUT_MOUSE = 1;
+const INPUT_HYPERLINK = 2;
+const INPUT_POSITION = 4;
+
+const WINDOW_TYPES: WindowUpdate['type'][] = ['buffer', 'grid', 'graphics', 'pair'];
+
+// Glk style numbers to GlkOte style names (matches styleToString in protocol.zig)
+const STYLE_NAMES = [
+  'normal', 'emphasized', 'preformatted', 'header', 'subheader', 'alert',
+  'note', 'blockquote', 'input', 'user1', 'user2',
+];
+
+const decoder = new TextDecoder();
+
+class RecordReader {
+  private bytes: Uint8Array;
+  private view: DataView;
+  pos: number;
+
+  constructor(bytes: Uint8Array, start: number) {
+    this.bytes = bytes;
+    this.view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+    this.pos = start;
+  }
+
+  u8(): number {
+    return this.view.getUint8(this.pos++);
+  }
+
+  u32(): number {
+    const value = this.view.getUint32(this.pos, true);
+    this.pos += 4;
+    return value;
+  }
+
+  i32(): number {
+    const value = this.view.getInt32(this.pos, true);
+    this.pos += 4;
+    return value;
+  }
+
+  f64(): number {
+    const value = this.view.getFloat64(this.pos, true);
+    this.pos += 8;
+    return value;
+  }
+
+  string(): string {
+    const len = this.u32();
+    const text = decoder.decode(this.bytes.subarray(this.pos, this.pos + len));
+    this.pos += len;
+    return text;
+  }
+}
+
+function colorHex(color: number): string {
+  return '#' + color.toString(16).toUpperCase().padStart(6, '0');
+}
+
+/**
+ * Decode the payload of one binary frame (the bytes after the marker and
+ * length) into an update.
+ */
+export function decodeBinaryUpdate(payload: Uint8Array): RemGlkUpdate {
+  const update: RemGlkUpdate = { type: 'update', gen: 0 };
+  let content: ContentUpdate | null = null;
+  // Where text and image records go: the last paragraph or grid line
+  let spanOwner: { content?: ContentSpan[] } | null = null;
+
+  let pos = 0;
+  while (pos < payload.length) {
+    const r = new RecordReader(payload, pos + 5);
+    const tag = payload[pos];
+    const end = r.pos + new DataView(payload.buffer, payload.byteOffset + pos + 1, 4).getUint32(0, true);
+
+    switch (tag) {
+      case RECORD_UPDATE: {
+        update.gen = r.u32();
+        const flags = r.u8();
+        const timer = r.u32();
+        if (flags & UPDATE_WINDOWS) update.windows = [];
+        if (flags & UPDATE_TIMER) update.timer = timer || null;
+        if (flags & UPDATE_DISABLE) update.disable = true;
+        if (flags & UPDATE_EXIT) update.exit = true;
+        break;
+      }
+      case RECORD_WINDOW: {
+        const win: WindowUpdate = {
+          id: r.u32(),
+          type: WINDOW_TYPES[r.u8()] ?? 'buffer',
+          rock: r.u32(),
+          left: r.f64(),
+          top: r.f64(),
+          width: r.f64(),
+          height: r.f64(),
+        };
+        const cols = r.u32();
+        const rows = r.u32();
+        if (win.type === 'grid') {
+          win.gridwidth = cols;
+          win.gridheight = rows;
+        } else if (win.type === 'graphics') {
+          win.graphwidth = cols;
+          win.graphheight = rows;
+        }
+        (update.windows ??= []).push(win);
+        break;
+      }
+      case RECORD_CONTENT: {
+        content = { id: r.u32() };
+        if (r.u8()) content.clear = true;
+        spanOwner = null;
+        (update.content ??= []).push(content);
+        break;
+      }
+      case RECORD_PARAGRAPH: {
+        const flags = r.u8();
+        const para: TextParagraph = {};
+        if (flags & 1) para.append = true;
+        if (flags & 2) para.flowbreak = true;
+        spanOwner = para;
+        (content!.text ??= []).push(para);
+        break;
+      }
+      case RECORD_TEXT: {
+        const style = STYLE_NAMES[r.u8()] ?? 'normal';
+        const hyperlink = r.u32();
+        const text = r.string();
+        (spanOwner!.content ??= []).push(hyperlink ? { style, text, hyperlink } : { style, text });
+        break;
+      }
+      case RECORD_IMAGE: {
+        const image = r.u32();
+        const alignment = IMAGE_ALIGNMENT_VALUES[r.u8()] ?? 'inlineup';
+        const width = r.u32();
+        const height = r.u32();
+        (spanOwner!.content ??= []).push({ special: 'image', image, alignment, width, height } as unknown as ContentSpan);
+        break;
+      }
+      case RECORD_DRAW: {
+        const kind = r.u8();
+        const color = r.u32();
+        const image = r.u32();
+        const x = r.i32();
+        const y = r.i32();
+        const width = r.u32();
+        const height = r.u32();
+        let op: DrawOperation;
+        switch (kind) {
+          case 0: op = { special: 'fill', color: colorHex(color), x, y, width, height }; break;
+          case 1: op = { special: 'fill', x, y, width, height }; break;
+          case 2: op = { special: 'setcolor', color: colorHex(color) }; break;
+          case 3: op = { special: 'image', image, x, y, width, height }; break;
+          default: {
+            const runs = new Array<number>(r.u32());
+            for (let i = 0; i < runs.length; i++) runs[i] = r.u32();
+            op = { special: 'raster', x, y, width, height, runs };
+          }
+        }
+        (content!.draw ??= []).push(op);
+        break;
+      }
+      case RECORD_LINE: {
+        const line: GridLine = { line: r.u32(), content: [] };
+        spanOwner = line;
+        (content!.lines ??= []).push(line);
+        break;
+      }
+      case RECORD_INPUT: {
+        const req: InputRequest = { id: r.u32(), type: r.u8() === 1 ? 'char' : 'line', gen: r.u32() };
+        const flags = r.u8();
+        const xpos = r.u32();
+        const ypos = r.u32();
+        const initial = r.string();
+        const terminators = Array.from({ length: r.u8() }, () => r.string());
+        if (initial) req.initial = initial;
+        if (flags & INPUT_MOUSE) req.mouse = true;
+        if (flags & INPUT_HYPERLINK) req.hyperlink = true;
+        if (flags & INPUT_POSITION) {
+          req.xpos = xpos;
+          req.ypos = ypos;
+        }
+        if (terminators.length > 0) req.terminators = terminators;
+        (update.input ??= []).push(req);
+        break;
+      }
+      case RECORD_SPECIALINPUT: {
+        update.specialinput = {
+          type: r.string(),
+          filemode: r.string(),
+          filetype: r.string(),
+        } as SpecialInput;
+        break;
+      }
+      case RECORD_DEBUG:
+        (update.debugoutput ??= []).push(r.string());
+        break;
+      // Unknown records are skipped
+    }
+    pos = end;
+  }
+  return update;
+}
+
+/**
+ * Splits the interpreter's stdout into messages. JSON messages are lines;
+ * binary frames are a marker byte and a little-endian u32 payload length.
+ * Bytes arrive in arbitrary chunks, so anything incomplete is kept for the
+ * next push.
+ */
+export class UpdateStreamReader {
+  private onUpdate: (update: RemGlkUpdate) => void;
+  private onText: (line: string) => void;
+  private pending = new Uint8Array(0);
+
+  constructor(onUpdate: (update: RemGlkUpdate) => void, onText: (line: string) => void) {
+    this.onUpdate = onUpdate;
+    this.onText = onText;
+  }
+
+  push(chunk: Uint8Array): void {
+    let bytes = chunk;
+    if (this.pending.length > 0) {
+      bytes = new Uint8Array(this.pending.length + chunk.length);
+      bytes.set(this.pending);
+      bytes.set(chunk, this.pending.length);
+    }
+
+    let pos = 0;
+    while (pos < bytes.length) {
+      if (bytes[pos] === FRAME_MARKER) {
+        if (bytes.length - pos < 5) break;
+        const len = new DataView(bytes.buffer, bytes.byteOffset + pos + 1, 4).getUint32(0, true);
+        if (bytes.length - pos - 5 < len) break;
+        this.onUpdate(decodeBinaryUpdate(bytes.subarray(pos + 5, pos + 5 + len)));
+        pos += 5 + len;
+      } else {
+        const nl = bytes.indexOf(0x0a, pos);
+        if (nl < 0) break;
+        this.onText(decoder.decode(bytes.subarray(pos, nl)));
+        pos = nl + 1;
+      }
+    }
+    // Copy the remainder: the chunk may be a view of memory that is reused
+    this.pending = bytes.slice(pos);
+  }
+}
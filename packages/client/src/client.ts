@@ -1,13 +1,18 @@
 /**
  * WasiGlk Client
  *
- * Runs IF interpreters in a Web Worker using JSPI for async I/O.
+ * Runs IF interpreters in a Web Worker using JSPI for async I/O, or
+ * Atomics.wait over a shared mailbox where JSPI is unavailable.
  */
 
 import { BlorbParser } from './blorb';
-import { detectFormat, type FormatInfo, type StoryFormat } from './format';
+import { fingerprint, readFingerprinted } from './fingerprint';
+import { detectFormat, interpreterArgs, type FormatInfo, type StoryFormat } from './format';
+import { compileInterpreterModule, loadInterpreterModule } from './module-cache';
+import { WorkerPool } from './worker-pool';
 import type { Metrics, RemGlkUpdate } from './protocol';
-import type { MainToWorkerMessage, WorkerToMainMessage } from './worker/messages';
+import { Mailbox } from './worker/mailbox';
+import type { MainToWorkerMessage, StdinMode, WorkerToMainMessage } from './worker/messages';
 
 /** Configuration for creating a WasiGlk client instance. */
 export interface ClientConfig {
@@ -21,8 +26,13 @@ export interface ClientConfig {
   interpreterData?: ArrayBuffer;
   /** Override format detection */
   format?: StoryFormat;
-  /** URL to the worker script (required) */
-  workerUrl: string | URL;
+  /** URL to the worker script (required unless `pool` is given) */
+  workerUrl?: string | URL;
+  /**
+   * Run sessions on workers from this pool instead of spawning one per
+   * session. The worker goes back to the pool after {@link WasiGlkClient.stop}.
+   */
+  pool?: WorkerPool;
   /**
    * File system configuration.
    * - 'auto' (default): OPFS if available, falls back to memory
@@ -33,8 +43,26 @@ export interface ClientConfig {
   filesystem?: 'auto' | 'opfs' | 'memory' | 'dialog';
   /** Display metrics for the interpreter output area. */
   metrics?: Metrics;
-  /** Features the display supports (per GlkOte spec). Defaults to ['timer', 'graphics', 'graphicswin', 'hyperlinks']. */
+  /** Features the display supports (per GlkOte spec). Defaults to ['timer', 'graphics', 'graphicswin', 'hyperlinks']. Add 'raster' to receive graphics windows as run-length rasters, only if your GraphicsRenderer implements drawRaster, and 'binary' to have the interpreter send updates as binary frames (decoded in the worker, so updates arrive in the same form). */
   support?: string[];
+  /**
+   * How the interpreter waits for input. The mode in use is reported by
+   * {@link WasiGlkClient.stdinMode}.
+   * - 'auto' (default): 'jspi' if the browser supports it, otherwise 'atomics'
+   * - 'jspi': suspend the interpreter with JSPI
+   * - 'atomics': block the worker on Atomics.wait while the main thread
+   *   fills a SharedArrayBuffer mailbox. Needs a cross-origin isolated page
+   *   (throws if SharedArrayBuffer is unavailable). Files are kept in memory
+   *   whatever the `filesystem` option, since nothing can be awaited.
+   */
+  stdin?: 'auto' | StdinMode;
+  /**
+   * Resume where the last session left off. The interpreter autosaves at
+   * every input request into the story's storage, and restores that autosave
+   * when it starts. Glulx stories only (ignored for other formats); needs a
+   * persistent `filesystem` to survive a reload.
+   */
+  autosave?: boolean;
 }
 
 /**
@@ -49,38 +77,51 @@ export interface ClientConfig {
  */
 export class WasiGlkClient {
   private storyData: Uint8Array;
-  private interpreterData: ArrayBuffer;
+  private interpreterModule: WebAssembly.Module;
   private formatInfo: FormatInfo;
   private blorb: BlorbParser | null = null;
   private worker: Worker | null = null;
   private running = false;
   private pendingUpdates: RemGlkUpdate[] = [];
   private updateResolve: ((value: IteratorResult<RemGlkUpdate>) => void) | null = null;
-  private workerUrl: string | URL;
+  private workerSource: string | URL | WorkerPool;
   private storyId: string;
+  private legacyStoryId: string;
   private filesystem: 'auto' | 'opfs' | 'memory' | 'dialog';
   private metrics: Metrics;
   private support?: string[];
+  private mode: StdinMode;
+  private autosave: boolean;
+  private mailbox: Mailbox | null = null;
+  // Messages waiting for room in the mailbox
+  private outbox: string[] = [];
+  private outboxTimer: ReturnType<typeof setTimeout> | null = null;
 
   private constructor(
     storyData: Uint8Array,
-    interpreterData: ArrayBuffer,
+    interpreterModule: WebAssembly.Module,
     formatInfo: FormatInfo,
     blorb: BlorbParser | null,
-    workerUrl: string | URL,
+    workerSource: string | URL | WorkerPool,
     storyId: string,
+    legacyStoryId: string,
     filesystem: 'auto' | 'opfs' | 'memory' | 'dialog',
     metrics: Metrics,
+    mode: StdinMode,
+    autosave: boolean,
     support?: string[],
   ) {
     this.storyData = storyData;
-    this.interpreterData = interpreterData;
+    this.interpreterModule = interpreterModule;
     this.formatInfo = formatInfo;
     this.blorb = blorb;
-    this.workerUrl = workerUrl;
+    this.workerSource = workerSource;
     this.storyId = storyId;
+    this.legacyStoryId = legacyStoryId;
     this.filesystem = filesystem;
     this.metrics = metrics;
+    this.mode = mode;
+    this.autosave = autosave;
     this.support = support;
   }
 
@@ -91,21 +132,29 @@ export class WasiGlkClient {
    * @param config - Client configuration with story URL/data and worker URL
    */
   static async create(config: ClientConfig): Promise<WasiGlkClient> {
+    const workerSource = config.pool ?? config.workerUrl;
+    if (!workerSource) throw new Error('Either workerUrl or pool must be provided');
+
     // Load story
     let storyData: Uint8Array;
     let storyUrl: string | null = null;
+    // Full-content hash, computed as the story downloads
+    let versionHash: string;
 
     if (config.storyData) {
       storyData = config.storyData;
+      versionHash = fingerprint(storyData);
     } else if (config.storyUrl) {
       storyUrl = config.storyUrl;
       const response = await fetch(config.storyUrl);
       if (!response.ok) throw new Error(`Failed to load story: ${response.status}`);
-      storyData = new Uint8Array(await response.arrayBuffer());
+      ({ data: storyData, fingerprint: versionHash } = await readFingerprinted(response));
     } else {
       throw new Error('Either storyUrl or storyData must be provided');
     }
 
+    const stdinMode = resolveStdinMode(config.stdin ?? 'auto');
+
     // Detect format
     const formatInfo = config.format
       ? { format: config.format, interpreter: getInterpreterName(config.format), isBlorb: false }
@@ -130,26 +179,21 @@ export class WasiGlkClient {
       }
     }
 
-    // Load interpreter
-    let interpreterData: ArrayBuffer;
-    if (config.interpreterData) {
-      interpreterData = config.interpreterData;
-    } else {
-      const interpreterUrl = config.interpreterUrl ?? `/${formatInfo.interpreter}.wasm`;
-      const response = await fetch(interpreterUrl);
-      if (!response.ok) throw new Error(`Failed to load interpreter: ${response.status}`);
-      interpreterData = await response.arrayBuffer();
-    }
+    // Load and compile the interpreter (shared by all sessions in the page)
+    const interpreterModule = config.interpreterData
+      ? await compileInterpreterModule(config.interpreterData)
+      : await loadInterpreterModule(config.interpreterUrl ?? `/${formatInfo.interpreter}.wasm`);
 
     // Generate story ID for save isolation: gameName/versionHash
     // This ensures different versions of the same game have separate saves
     const gameName = storyUrl
       ? storyUrl.split('/').pop()?.replace(/\.[^.]+$/, '') ?? 'unknown'
       : 'story';
-    const versionHash = hashBytes(storyData).toString(16).padStart(8, '0');
     const storyId = `${gameName}/${versionHash}`;
+    // Saves made before full-content fingerprints are found under this
+    const legacyStoryId = `${gameName}/${legacyHash(storyData)}`;
 
-    return new WasiGlkClient(executableData, interpreterData, formatInfo, blorb, config.workerUrl, storyId, config.filesystem ?? 'auto', config.metrics ?? { width: 80, height: 24 }, config.support);
+    return new WasiGlkClient(executableData, interpreterModule, formatInfo, blorb, workerSource, storyId, legacyStoryId, config.filesystem ?? 'auto', config.metrics ?? { width: 80, height: 24 }, stdinMode, config.autosave ?? false, config.support);
   }
 
   /** The detected format and interpreter for the loaded story. */
@@ -157,6 +201,11 @@ export class WasiGlkClient {
     return this.formatInfo;
   }
 
+  /** How the interpreter waits for input: 'jspi' or 'atomics'. */
+  get stdinMode(): StdinMode {
+    return this.mode;
+  }
+
   /** Get the Blorb parser if the story is a Blorb file, or null otherwise. */
   getBlorb(): BlorbParser | null {
     return this.blorb;
@@ -175,9 +224,11 @@ export class WasiGlkClient {
    * Send line or character input to the interpreter.
    * Call this in response to an `input-request` update.
    * @param value - The input string (full line for line input, single char for char input)
+   * @throws RangeError in the 'atomics' stdin mode if the event is too large
+   *   for the mailbox (64 KB)
    */
   sendInput(value: string): void {
-    this.worker?.postMessage({ type: 'input', value } satisfies MainToWorkerMessage);
+    this.send({ type: 'input', value });
   }
 
   /**
@@ -193,10 +244,10 @@ export class WasiGlkClient {
    * This should be called when the display dimensions change.
    */
   sendArrange(metrics: Metrics): void {
-    this.worker?.postMessage({
+    this.send({
       type: 'arrange',
       metrics,
-    } satisfies MainToWorkerMessage);
+    });
   }
 
   /**
@@ -207,12 +258,12 @@ export class WasiGlkClient {
    * @param y - The y coordinate of the click (in window-relative units)
    */
   sendMouse(windowId: number, x: number, y: number): void {
-    this.worker?.postMessage({
+    this.send({
       type: 'mouse',
       windowId,
       x,
       y,
-    } satisfies MainToWorkerMessage);
+    });
   }
 
   /**
@@ -222,11 +273,11 @@ export class WasiGlkClient {
    * @param linkValue - The link value (number) that was set with glk_set_hyperlink
    */
   sendHyperlink(windowId: number, linkValue: number): void {
-    this.worker?.postMessage({
+    this.send({
       type: 'hyperlink',
       windowId,
       linkValue,
-    } satisfies MainToWorkerMessage);
+    });
   }
 
   /**
@@ -235,10 +286,10 @@ export class WasiGlkClient {
    * @param windowId - Optional window ID. If omitted, all graphics windows need redrawing.
    */
   sendRedraw(windowId?: number): void {
-    this.worker?.postMessage({
+    this.send({
       type: 'redraw',
       windowId,
-    } satisfies MainToWorkerMessage);
+    });
   }
 
   /**
@@ -246,20 +297,17 @@ export class WasiGlkClient {
    * This requests a full state refresh from the game.
    */
   sendRefresh(): void {
-    this.worker?.postMessage({
+    this.send({
       type: 'refresh',
-    } satisfies MainToWorkerMessage);
+    });
   }
 
-  /** Stop the interpreter and terminate the Web Worker. */
+  /** Stop the interpreter and terminate the Web Worker (or return it to the pool). */
   stop(): void {
     this.running = false;
+    this.clearOutbox();
     this.blorb?.dispose();
-    if (this.worker) {
-      this.worker.postMessage({ type: 'stop' } satisfies MainToWorkerMessage);
-      this.worker.terminate();
-      this.worker = null;
-    }
+    this.releaseWorker();
     if (this.updateResolve) {
       this.updateResolve({ value: undefined as any, done: true });
       this.updateResolve = null;
@@ -286,7 +334,9 @@ export class WasiGlkClient {
     this.running = true;
 
     try {
-      this.worker = new Worker(this.workerUrl, { type: 'module' });
+      this.worker = this.workerSource instanceof WorkerPool
+        ? this.workerSource.acquire()
+        : new Worker(this.workerSource, { type: 'module' });
 
       this.worker.onmessage = (e: MessageEvent<WorkerToMainMessage>) => {
         this.handleWorkerMessage(e.data);
@@ -297,17 +347,23 @@ export class WasiGlkClient {
         this.resolveNextUpdate();
       };
 
+      const mailboxBuffer = this.mode === 'atomics' ? Mailbox.create() : undefined;
+      this.mailbox = mailboxBuffer ? new Mailbox(mailboxBuffer) : null;
+
       const initMessage: MainToWorkerMessage = {
         type: 'init',
-        interpreter: this.interpreterData,
+        interpreter: this.interpreterModule,
         story: this.storyData,
-        args: [this.formatInfo.interpreter, '/sys/story.ulx'],
+        args: interpreterArgs(this.formatInfo, '/sys/story.ulx', this.autosave),
         metrics: this.metrics,
         support: this.support,
         storyId: this.storyId,
+        legacyStoryId: this.legacyStoryId,
         filesystem: this.filesystem,
+        stdin: this.mode,
+        mailbox: mailboxBuffer,
       };
-      this.worker.postMessage(initMessage, [this.interpreterData]);
+      this.worker.postMessage(initMessage);
 
       while (this.running) {
         if (this.pendingUpdates.length > 0) {
@@ -323,11 +379,65 @@ export class WasiGlkClient {
       }
     } finally {
       this.running = false;
-      this.worker?.terminate();
-      this.worker = null;
+      this.clearOutbox();
+      this.releaseWorker();
+    }
+  }
+
+  /** Hand the worker back to its pool, or stop and terminate it. */
+  private releaseWorker(): void {
+    const worker = this.worker;
+    if (!worker) return;
+    this.worker = null;
+    if (this.workerSource instanceof WorkerPool) {
+      // A worker blocked in Atomics.wait cannot receive the reset message
+      this.workerSource.release(worker, this.mode === 'jspi');
+    } else {
+      worker.postMessage({ type: 'stop' } satisfies MainToWorkerMessage);
+      worker.terminate();
     }
   }
 
+  /**
+   * Deliver an event message to the worker. In the 'atomics' mode the worker
+   * is blocked in Atomics.wait, so events go through the mailbox instead of
+   * postMessage. An event too large for the mailbox is refused, since it
+   * would hold up every event queued after it.
+   */
+  private send(msg: MainToWorkerMessage): void {
+    if (!this.worker) return;
+    if (!this.mailbox) {
+      this.worker.postMessage(msg);
+      return;
+    }
+    const text = JSON.stringify(msg);
+    if (!this.mailbox.canHold(text)) {
+      throw new RangeError(`The ${msg.type} event is too large for the 'atomics' stdin mailbox`);
+    }
+    this.outbox.push(text);
+    this.flushOutbox();
+  }
+
+  private flushOutbox(): void {
+    while (this.outbox.length > 0 && this.mailbox?.send(this.outbox[0])) {
+      this.outbox.shift();
+    }
+    // The mailbox is full: retry once the worker has caught up
+    if (this.outbox.length > 0 && this.outboxTimer === null) {
+      this.outboxTimer = setTimeout(() => {
+        this.outboxTimer = null;
+        this.flushOutbox();
+      }, 10);
+    }
+  }
+
+  private clearOutbox(): void {
+    if (this.outboxTimer !== null) clearTimeout(this.outboxTimer);
+    this.outboxTimer = null;
+    this.outbox = [];
+    this.mailbox = null;
+  }
+
   private handleWorkerMessage(msg: WorkerToMainMessage): void {
     switch (msg.type) {
       case 'update':
@@ -428,12 +538,24 @@ function getInterpreterName(format: StoryFormat): string {
   return names[format] ?? 'glulxe';
 }
 
-function hashBytes(data: Uint8Array): number {
+function resolveStdinMode(mode: 'auto' | StdinMode): StdinMode {
+  const atomicsAvailable = typeof SharedArrayBuffer !== 'undefined';
+  if (mode === 'auto') {
+    return 'Suspending' in WebAssembly || !atomicsAvailable ? 'jspi' : 'atomics';
+  }
+  if (mode === 'atomics' && !atomicsAvailable) {
+    throw new Error('The atomics stdin mode needs SharedArrayBuffer (serve the page cross-origin isolated)');
+  }
+  return mode;
+}
+
+// The story version hash used before full-content fingerprints
+function legacyHash(data: Uint8Array): string {
   let hash = 0;
   for (let i = 0; i < Math.min(data.length, 1024); i++) {
     hash = ((hash << 5) - hash + data[i]) | 0;
   }
-  return hash >>> 0;
+  return (hash >>> 0).toString(16).padStart(8, '0');
 }
 
 function getFileTypeInfo(filetype: 'save' | 'data' | 'transcript' | 'command'): { extension: string; description: string } {
@@ -0,0 +1,164 @@
+/**
+ * Content Fingerprints
+ *
+ * A fast hash of a file's full content, used to key per-story storage and
+ * the interpreter module cache. It is xxHash32 run with two seeds, which
+ * gives 64 bits. Input can be fed in chunks, so a download is fingerprinted
+ * as it arrives rather than in a second pass.
+ */
+
+const PRIME1 = 0x9e3779b1;
+const PRIME2 = 0x85ebca77;
+const PRIME3 = 0xc2b2ae3d;
+const PRIME4 = 0x27d4eb2f;
+const PRIME5 = 0x165667b1;
+
+function rotl(x: number, r: number): number {
+  return (x << r) | (x >>> (32 - r));
+}
+
+function round(acc: number, input: number): number {
+  return Math.imul(rotl((acc + Math.imul(input, PRIME2)) | 0, 13), PRIME1);
+}
+
+/** Incremental xxHash32. */
+class Xxh32 {
+  private seed: number;
+  private v1: number;
+  private v2: number;
+  private v3: number;
+  private v4: number;
+  private total = 0;
+  // Bytes left over from the last update, short of a 16-byte stripe
+  private tail = new Uint8Array(16);
+  private tailLength = 0;
+
+  constructor(seed: number) {
+    this.seed = seed | 0;
+    this.v1 = (seed + PRIME1 + PRIME2) | 0;
+    this.v2 = (seed + PRIME2) | 0;
+    this.v3 = seed | 0;
+    this.v4 = (seed - PRIME1) | 0;
+  }
+
+  update(bytes: Uint8Array): void {
+    this.total += bytes.length;
+    let pos = 0;
+
+    if (this.tailLength > 0) {
+      const take = Math.min(16 - this.tailLength, bytes.length);
+      this.tail.set(bytes.subarray(0, take), this.tailLength);
+      this.tailLength += take;
+      pos = take;
+      if (this.tailLength < 16) return;
+      this.stripes(this.tail, 0, 16);
+      this.tailLength = 0;
+    }
+
+    const end = pos + ((bytes.length - pos) & ~15);
+    this.stripes(bytes, pos, end);
+    this.tail.set(bytes.subarray(end));
+    this.tailLength = bytes.length - end;
+  }
+
+  digest(): number {
+    let h = this.total >= 16
+      ? (rotl(this.v1, 1) + rotl(this.v2, 7) + rotl(this.v3, 12) + rotl(this.v4, 18)) | 0
+      : (this.seed + PRIME5) | 0;
+    h = (h + this.total) | 0;
+
+    let i = 0;
+    for (; i + 4 <= this.tailLength; i += 4) {
+      h = (h + Math.imul(readU32(this.tail, i), PRIME3)) | 0;
+      h = Math.imul(rotl(h, 17), PRIME4);
+    }
+    for (; i < this.tailLength; i++) {
+      h = (h + Math.imul(this.tail[i], PRIME5)) | 0;
+      h = Math.imul(rotl(h, 11), PRIME1);
+    }
+
+    h ^= h >>> 15;
+    h = Math.imul(h, PRIME2);
+    h ^= h >>> 13;
+    h = Math.imul(h, PRIME3);
+    h ^= h >>> 16;
+    return h >>> 0;
+  }
+
+  private stripes(bytes: Uint8Array, start: number, end: number): void {
+    let { v1, v2, v3, v4 } = this;
+    for (let p = start; p < end; p += 16) {
+      v1 = round(v1, readU32(bytes, p));
+      v2 = round(v2, readU32(bytes, p + 4));
+      v3 = round(v3, readU32(bytes, p + 8));
+      v4 = round(v4, readU32(bytes, p + 12));
+    }
+    this.v1 = v1;
+    this.v2 = v2;
+    this.v3 = v3;
+    this.v4 = v4;
+  }
+}
+
+function readU32(bytes: Uint8Array, pos: number): number {
+  return bytes[pos] | (bytes[pos + 1] << 8) | (bytes[pos + 2] << 16) | (bytes[pos + 3] << 24);
+}
+
+/** Incremental content fingerprint: feed chunks with update(), then digest(). */
+export class Fingerprint {
+  private low = new Xxh32(0);
+  private high = new Xxh32(PRIME1);
+
+  update(chunk: Uint8Array): this {
+    this.low.update(chunk);
+    this.high.update(chunk);
+    return this;
+  }
+
+  /** The fingerprint as 16 hex digits. */
+  digest(): string {
+    return hex(this.high.digest()) + hex(this.low.digest());
+  }
+}
+
+function hex(value: number): string {
+  return value.toString(16).padStart(8, '0');
+}
+
+/** Fingerprint a complete file. */
+export function fingerprint(data: Uint8Array): string {
+  return new Fingerprint().update(data).digest();
+}
+
+/**
+ * Read a response body, fingerprinting it as the chunks arrive.
+ * @param response - A successful fetch response
+ */
+export async function readFingerprinted(response: Response): Promise<{ data: Uint8Array; fingerprint: string }> {
+  if (!response.body) {
+    const data = new Uint8Array(await response.arrayBuffer());
+    return { data, fingerprint: fingerprint(data) };
+  }
+
+  const hash = new Fingerprint();
+  const chunks: Uint8Array[] = [];
+  let length = 0;
+  const reader = response.body.getReader();
+  for (;;) {
+    const { done, value } = await reader.read();
+    if (done) break;
+    hash.update(value);
+    chunks.push(value);
+    length += value.length;
+  }
+
+  // A single chunk is used as it is
+  if (chunks.length === 1) return { data: chunks[0], fingerprint: hash.digest() };
+  const data = new Uint8Array(length);
+  let pos = 0;
+  for (const chunk of chunks) {
+    data.set(chunk, pos);
+    pos += chunk.length;
+  }
+  return { data, fingerprint: hash.digest() };
+}
@@ -128,6 +128,18 @@ const MAGIC_SIGNATURES: Array<{
   },
 ];
 
+/**
+ * Command line for running a story. With `autosave`, interpreters that
+ * support it (Glulxe) save the session in /var/ at every input request and
+ * resume from that autosave when started again.
+ */
+export function interpreterArgs(info: FormatInfo, storyPath: string, autosave = false): string[] {
+  const flags = autosave && info.interpreter === 'glulxe'
+    ? ['-autosave', '-autorestore', '-autodir', '/var']
+    : [];
+  return [info.interpreter, ...flags, storyPath];
+}
+
 /**
  * Detect story format from URL (by extension)
  */
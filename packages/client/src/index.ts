@@ -57,6 +57,7 @@
 // Main client API
 export { WasiGlkClient, createClient } from './client';
 export type { ClientConfig } from './client';
+export { WorkerPool } from './worker-pool';
 
 // Protocol types (raw RemGlk protocol)
 export type {
@@ -83,7 +84,7 @@ export { BlorbParser } from './blorb';
 export type { BlorbImage, BlorbResource } from './blorb';
 
 // Format detection
-export { detectFormat, detectFormatFromUrl, detectFormatFromData } from './format';
+export { detectFormat, detectFormatFromUrl, detectFormatFromData, interpreterArgs } from './format';
 export type { StoryFormat, FormatInfo } from './format';
 
 // Renderers (optional)
@@ -96,4 +97,5 @@ export type {
   MainToWorkerMessage,
   WorkerToMainMessage,
   FilesystemMode,
+  StdinMode,
 } from './worker/messages';
@@ -0,0 +1,61 @@
+/**
+ * Interpreter Module Cache
+ *
+ * Compiled interpreter modules are shared by every session in the page,
+ * keyed by a fingerprint of the module's content, so a second session (or
+ * the same interpreter fetched from another URL) skips compilation. Modules
+ * fetched by URL are compiled with WebAssembly.compileStreaming, which
+ * compiles as the bytes arrive and lets the browser reuse its code cache on
+ * repeat visits.
+ */
+
+import { fingerprint, readFingerprinted } from './fingerprint';
+
+// Content fingerprint -> compiled module
+const modules = new Map<string, Promise<WebAssembly.Module>>();
+// URL -> content fingerprint of what it served
+const urls = new Map<string, string>();
+
+/**
+ * Fetch and compile an interpreter, or return the cached module.
+ * @param url - URL of the interpreter WASM module
+ */
+export async function loadInterpreterModule(url: string): Promise<WebAssembly.Module> {
+  const known = urls.get(url);
+  if (known) return modules.get(known)!;
+
+  const response = await fetch(url);
+  if (!response.ok) throw new Error(`Failed to load interpreter: ${response.status}`);
+
+  // Compile from one copy of the stream while the other is fingerprinted.
+  // compileStreaming needs the application/wasm content type; other
+  // responses are compiled from the bytes.
+  const streaming = response.headers.get('Content-Type')?.split(';')[0].trim() === 'application/wasm';
+  const compiling = streaming ? WebAssembly.compileStreaming(response.clone()) : null;
+  compiling?.catch(() => {}); // Reported where it is awaited
+  const { data, fingerprint: key } = await readFingerprinted(response);
+  if (!modules.has(key)) modules.set(key, compiling ?? WebAssembly.compile(data as BufferSource));
+  urls.set(url, key);
+  return cached(key);
+}
+
+/**
+ * Compile interpreter bytes, or return the cached module for the same content.
+ * @param data - The interpreter WASM module bytes
+ */
+export async function compileInterpreterModule(data: ArrayBuffer): Promise<WebAssembly.Module> {
+  const key = fingerprint(new Uint8Array(data));
+  if (!modules.has(key)) modules.set(key, WebAssembly.compile(data));
+  return cached(key);
+}
+
+// A failed compile is not kept, so a later attempt can retry
+async function cached(key: string): Promise<WebAssembly.Module> {
+  try {
+    return await modules.get(key)!;
+  } catch (err) {
+    modules.delete(key);
+    for (const [url, hash] of urls) if (hash === key) urls.delete(url);
+    throw err;
+  }
+}
@@ -10,7 +10,7 @@ export interface InitEvent {
   type: 'init';
   gen: number;
   metrics: Metrics;
-  support?: string[];  // Features the display supports: 'timer', 'graphics', 'graphicswin', 'hyperlinks'
+  support?: string[];  // Features the display supports: 'timer', 'graphics', 'graphicswin', 'hyperlinks', 'raster', 'binary'
 }
 
 export interface LineInputEvent {
@@ -146,7 +146,7 @@ export interface GridLine {
 
 // Graphics window draw operations (GlkOte spec)
 export interface DrawOperation {
-  special: 'setcolor' | 'fill' | 'image';
+  special: 'setcolor' | 'fill' | 'image' | 'raster';
   color?: string;  // CSS hex color like "#RRGGBB"
   x?: number;
   y?: number;
@@ -154,6 +154,7 @@ export interface DrawOperation {
   height?: number;
   image?: number;
   url?: string;
+  runs?: number[];  // raster: row-major (count, 0xAARRGGBB) pairs; alpha 0 leaves pixels unchanged
 }
 
 export type ContentSpan = string | TextSpan | SpecialSpan;
@@ -14,6 +14,11 @@ export class SvgRenderer implements GraphicsRenderer {
   private width = 0;
   private height = 0;
   private backgroundColor = 0xffffff;
+  // Rasters are composited into one canvas, shown through a single <image>.
+  // Anything else drawn afterwards ends that layer, and the next raster
+  // starts a new one above it.
+  private rasterCanvas: HTMLCanvasElement | null = null;
+  private rasterImage: SVGImageElement | null = null;
 
   mount(container: HTMLElement): void {
     this.svg = document.createElementNS('http://www.w3.org/2000/svg', 'svg');
@@ -59,6 +64,7 @@ export class SvgRenderer implements GraphicsRenderer {
     rect.setAttribute('fill', colorToCSS(color));
 
     this.svg.appendChild(rect);
+    this.endRasterLayer();
   }
 
   eraseRect(x: number, y: number, width: number, height: number): void {
@@ -93,6 +99,47 @@ export class SvgRenderer implements GraphicsRenderer {
     image.setAttribute('preserveAspectRatio', 'xMidYMid meet');
 
     this.svg.appendChild(image);
+    this.endRasterLayer();
+  }
+
+  drawRaster(
+    x: number,
+    y: number,
+    width: number,
+    height: number,
+    runs: number[]
+  ): void {
+    if (!this.svg || width <= 0 || height <= 0) return;
+
+    const canvas = this.rasterLayer(x + width, y + height);
+    const ctx = canvas.getContext('2d');
+    if (!ctx) return;
+
+    // Alpha 0 pixels keep what the layer already has there
+    const image = ctx.getImageData(x, y, width, height);
+    const data = image.data;
+    let offset = 0;
+    for (let i = 0; i + 1 < runs.length; i += 2) {
+      const pixel = runs[i + 1];
+      const end = offset + runs[i] * 4;
+      const a = (pixel >>> 24) & 0xff;
+      if (a === 0) {
+        offset = end;
+        continue;
+      }
+      const r = (pixel >>> 16) & 0xff;
+      const g = (pixel >>> 8) & 0xff;
+      const b = pixel & 0xff;
+      for (; offset < end; offset += 4) {
+        data[offset] = r;
+        data[offset + 1] = g;
+        data[offset + 2] = b;
+        data[offset + 3] = a;
+      }
+    }
+    ctx.putImageData(image, x, y);
+
+    this.rasterImage!.setAttributeNS('http://www.w3.org/1999/xlink', 'href', canvas.toDataURL());
   }
 
   clear(): void {
@@ -102,6 +149,7 @@ export class SvgRenderer implements GraphicsRenderer {
     while (this.svg.lastChild && this.svg.lastChild !== this.defs) {
       this.svg.removeChild(this.svg.lastChild);
     }
+    this.endRasterLayer();
   }
 
   dispose(): void {
@@ -110,6 +158,38 @@ export class SvgRenderer implements GraphicsRenderer {
     }
     this.svg = null;
     this.defs = null;
+    this.endRasterLayer();
+  }
+
+  // The current raster layer, created or grown to cover (right, bottom)
+  private rasterLayer(right: number, bottom: number): HTMLCanvasElement {
+    const width = Math.max(this.width, right);
+    const height = Math.max(this.height, bottom);
+    let canvas = this.rasterCanvas;
+    if (canvas && canvas.width >= width && canvas.height >= height) return canvas;
+
+    const old = canvas;
+    canvas = document.createElement('canvas');
+    canvas.width = Math.max(width, old?.width ?? 0);
+    canvas.height = Math.max(height, old?.height ?? 0);
+    if (old) canvas.getContext('2d')?.drawImage(old, 0, 0);
+    this.rasterCanvas = canvas;
+
+    if (!this.rasterImage) {
+      this.rasterImage = document.createElementNS('http://www.w3.org/2000/svg', 'image');
+      this.rasterImage.setAttribute('x', '0');
+      this.rasterImage.setAttribute('y', '0');
+      this.rasterImage.setAttribute('preserveAspectRatio', 'none');
+      this.svg!.appendChild(this.rasterImage);
+    }
+    this.rasterImage.setAttribute('width', String(canvas.width));
+    this.rasterImage.setAttribute('height', String(canvas.height));
+    return canvas;
+  }
+
+  private endRasterLayer(): void {
+    this.rasterCanvas = null;
+    this.rasterImage = null;
   }
 
   private updateViewBox(): void {
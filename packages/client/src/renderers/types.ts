@@ -37,6 +37,20 @@ export interface GraphicsRenderer {
     height?: number
   ): void;
 
+  /**
+   * Draw a run-length encoded raster (the 'raster' draw operation).
+   * `runs` holds (count, 0xAARRGGBB) pairs covering the rectangle row by row;
+   * pixels with alpha 0 are left as they are. Optional: only request the
+   * 'raster' feature for renderers that implement it.
+   */
+  drawRaster?(
+    x: number,
+    y: number,
+    width: number,
+    height: number,
+    runs: number[]
+  ): void;
+
   /** Clear all graphics */
   clear(): void;
 
@@ -0,0 +1,94 @@
+/**
+ * Worker Pool
+ *
+ * Keeps interpreter workers spawned ahead of time, so a session starts
+ * without waiting for a worker to load, and takes workers back after
+ * {@link WasiGlkClient.stop} for the next session. Share one pool between
+ * clients via {@link ClientConfig.pool}. Interpreter modules are already
+ * shared through the module cache, so a pooled worker receives a compiled
+ * module with its init message.
+ */
+
+import type { MainToWorkerMessage, WorkerToMainMessage } from './worker/messages';
+
+// How long a released worker may take to unwind its session before it is
+// given up on (terminated and replaced)
+const RESET_TIMEOUT_MS = 5000;
+
+export class WorkerPool {
+  private workerUrl: string | URL;
+  private size: number;
+  private idle: Worker[] = [];
+  // Workers unwinding their last session
+  private resetting = new Set<Worker>();
+
+  /**
+   * @param workerUrl - URL to the worker script
+   * @param size - How many idle workers to keep ready
+   */
+  constructor(workerUrl: string | URL, size = 1) {
+    this.workerUrl = workerUrl;
+    this.size = size;
+    this.fill();
+  }
+
+  /** Take an idle worker (or spawn one if none is ready) and refill the pool. */
+  acquire(): Worker {
+    const worker = this.idle.pop() ?? this.spawn();
+    this.fill();
+    return worker;
+  }
+
+  /**
+   * Hand a worker back after its session. It is reset and kept if the pool
+   * has room, otherwise terminated. Workers that cannot take another
+   * session (`reusable` false) are always terminated.
+   */
+  release(worker: Worker, reusable = true): void {
+    worker.onmessage = null;
+    worker.onerror = null;
+    if (!reusable || this.idle.length + this.resetting.size >= this.size) {
+      worker.terminate();
+      return;
+    }
+
+    this.resetting.add(worker);
+    const discard = () => {
+      clearTimeout(timer);
+      worker.onmessage = null;
+      worker.onerror = null;
+      worker.terminate();
+      // Already gone if the pool was disposed meanwhile
+      if (this.resetting.delete(worker)) this.fill();
+    };
+    const timer = setTimeout(discard, RESET_TIMEOUT_MS);
+    worker.onmessage = (e: MessageEvent<WorkerToMainMessage>) => {
+      if (e.data.type !== 'ready') return;
+      clearTimeout(timer);
+      worker.onmessage = null;
+      worker.onerror = null;
+      this.resetting.delete(worker);
+      this.idle.push(worker);
+    };
+    worker.onerror = discard;
+    worker.postMessage({ type: 'reset' } satisfies MainToWorkerMessage);
+  }
+
+  /** Terminate every idle worker. Workers in use are not affected. */
+  dispose(): void {
+    for (const worker of [...this.idle, ...this.resetting]) worker.terminate();
+    this.idle = [];
+    this.resetting.clear();
+    this.size = 0;
+  }
+
+  private fill(): void {
+    while (this.idle.length + this.resetting.size < this.size) {
+      this.idle.push(this.spawn());
+    }
+  }
+
+  private spawn(): Worker {
+    return new Worker(this.workerUrl, { type: 'module' });
+  }
+}
@@ -0,0 +1,106 @@
+/**
+ * Atomics Mailbox
+ *
+ * A single-producer, single-consumer ring of messages in a
+ * SharedArrayBuffer, used by the 'atomics' stdin mode (browsers without
+ * JSPI). The main thread sends; the interpreter worker blocks in
+ * {@link Mailbox.receive} with Atomics.wait while the interpreter waits for
+ * input, so no stack switch is needed per event.
+ *
+ * Layout: two Int32 words (read and write positions into the data area),
+ * then the data area. Each message is a little-endian u32 byte length and
+ * the UTF-8 text, wrapping at the end of the data area. Only the receiver
+ * moves the read position and only the sender moves the write position.
+ */
+
+const READ = 0;
+const WRITE = 1;
+const HEADER_BYTES = 8;
+
+export class Mailbox {
+  private header: Int32Array;
+  private data: Uint8Array;
+  private encoder = new TextEncoder();
+  private decoder = new TextDecoder();
+
+  /** Allocate the shared buffer for a mailbox with `capacity` data bytes. */
+  static create(capacity = 64 * 1024): SharedArrayBuffer {
+    return new SharedArrayBuffer(HEADER_BYTES + capacity);
+  }
+
+  constructor(buffer: SharedArrayBuffer) {
+    this.header = new Int32Array(buffer, 0, 2);
+    this.data = new Uint8Array(buffer, HEADER_BYTES);
+  }
+
+  /** Whether a message is small enough to fit once the mailbox is empty. */
+  canHold(message: string): boolean {
+    return this.encoder.encode(message).length <= this.maxMessageBytes();
+  }
+
+  /**
+   * Queue a message and wake the receiver.
+   * Returns false if there is no room for it until the receiver catches up,
+   * and throws a RangeError if it would never fit (see {@link canHold}).
+   */
+  send(message: string): boolean {
+    const bytes = this.encoder.encode(message);
+    if (bytes.length > this.maxMessageBytes()) {
+      throw new RangeError(`Message of ${bytes.length} bytes exceeds the mailbox limit of ${this.maxMessageBytes()}`);
+    }
+    const cap = this.data.length;
+    const read = Atomics.load(this.header, READ);
+    const write = Atomics.load(this.header, WRITE);
+    const used = (write - read + cap) % cap;
+    // Keep one byte free so a full ring is distinguishable from an empty one
+    if (used + 4 + bytes.length >= cap) return false;
+
+    const length = new Uint8Array(4);
+    new DataView(length.buffer).setUint32(0, bytes.length, true);
+    const end = this.copyIn(this.copyIn(write, length), bytes);
+    Atomics.store(this.header, WRITE, end);
+    Atomics.notify(this.header, WRITE);
+    return true;
+  }
+
+  /**
+   * Take the next message, blocking for up to `timeout` milliseconds
+   * (indefinitely if omitted). Returns null if none arrived in time.
+   * Only usable off the main thread.
+   */
+  receive(timeout?: number): string | null {
+    const read = Atomics.load(this.header, READ);
+    if (Atomics.load(this.header, WRITE) === read) {
+      Atomics.wait(this.header, WRITE, read, timeout);
+      if (Atomics.load(this.header, WRITE) === read) return null;
+    }
+
+    const cap = this.data.length;
+    const length = this.copyOut(read, 4);
+    const len = new DataView(length.buffer).getUint32(0, true);
+    // Decoding needs an unshared copy anyway (TextDecoder rejects shared views)
+    const text = this.decoder.decode(this.copyOut((read + 4) % cap, len));
+    Atomics.store(this.header, READ, (read + 4 + len) % cap);
+    return text;
+  }
+
+  // Length prefix plus the byte kept free
+  private maxMessageBytes(): number {
+    return this.data.length - 5;
+  }
+
+  private copyIn(pos: number, bytes: Uint8Array): number {
+    const first = Math.min(bytes.length, this.data.length - pos);
+    this.data.set(bytes.subarray(0, first), pos);
+    this.data.set(bytes.subarray(first), 0);
+    return (pos + bytes.length) % this.data.length;
+  }
+
+  private copyOut(pos: number, len: number): Uint8Array {
+    const out = new Uint8Array(len);
+    const first = Math.min(len, this.data.length - pos);
+    out.set(this.data.subarray(pos, pos + first));
+    out.set(this.data.subarray(0, len - first), first);
+    return out;
+  }
+}
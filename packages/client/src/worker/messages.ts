@@ -7,9 +7,16 @@ import type { FilesystemMode } from './storage';
 
 export type { FilesystemMode };
 
+/**
+ * How the interpreter waits for input.
+ * - 'jspi': stdin reads suspend the interpreter via JSPI
+ * - 'atomics': the worker blocks on Atomics.wait over a shared mailbox
+ */
+export type StdinMode = 'jspi' | 'atomics';
+
 /** Messages from main thread to worker */
 export type MainToWorkerMessage =
-  | { type: 'init'; interpreter: ArrayBuffer; story: Uint8Array; args: string[]; metrics: Metrics; support?: string[]; storyId: string; filesystem: FilesystemMode }
+  | { type: 'init'; interpreter: WebAssembly.Module | ArrayBuffer; story: Uint8Array; args: string[]; metrics: Metrics; support?: string[]; storyId: string; legacyStoryId?: string; filesystem: FilesystemMode; stdin?: StdinMode; mailbox?: SharedArrayBuffer }
   | { type: 'input'; value: string }
   | { type: 'arrange'; metrics: Metrics }
   | { type: 'mouse'; windowId: number; x: number; y: number }
@@ -17,6 +24,8 @@ export type MainToWorkerMessage =
   | { type: 'redraw'; windowId?: number }
   | { type: 'refresh' }
   | { type: 'stop' }
+  // End the session but keep the worker for another (see WorkerPool)
+  | { type: 'reset' }
   // File dialog responses
   | { type: 'fileDialogResult'; filename: string | null; handle?: FileSystemFileHandle };
 
@@ -28,5 +37,7 @@ export type WorkerToMainMessage =
   | { type: 'update'; data: RemGlkUpdate }
   | { type: 'error'; message: string }
   | { type: 'exit'; code: number }
+  // The worker has been reset and can take a new init message
+  | { type: 'ready' }
   // File dialog request
   | { type: 'fileDialogRequest'; filemode: FileDialogMode; filetype: 'save' | 'data' | 'transcript' | 'command' };
@@ -8,11 +8,16 @@ export type InputProvider = () => Promise<string>;
 
 /**
  * Async stdin that suspends WASM execution while waiting for input via JSPI.
+ *
+ * Each event is kept as a string until it is read, then encoded straight
+ * into the reader's buffer (normally the interpreter's linear memory), so
+ * no intermediate byte arrays are made per event or per read.
  */
 export class AsyncStdinFd extends Fd {
   private inputProvider: InputProvider;
-  private buffer: Uint8Array = new Uint8Array(0);
-  private position = 0;
+  // Unread input, including the newline that ends the event
+  private pending = '';
+  private encoder = new TextEncoder();
   private ino = Inode.issue_ino();
 
   constructor(inputProvider: InputProvider) {
@@ -33,29 +38,32 @@ export class AsyncStdinFd extends Fd {
     };
   }
 
-  /** Async read - called via JSPI wrapper */
-  async fd_read_async(size: number): Promise<{ ret: number; data: Uint8Array }> {
-    if (this.position >= this.buffer.length) {
-      const input = await this.inputProvider();
-      this.buffer = new TextEncoder().encode(input + '\n');
-      this.position = 0;
+  /** Wait for the next event if no input is pending - called via JSPI wrapper */
+  async fd_wait(): Promise<void> {
+    if (this.pending.length === 0) {
+      this.pending = (await this.inputProvider()) + '\n';
     }
-    return this.readFromBuffer(size);
   }
 
-  /** Sync read - returns buffered data only */
-  fd_read(size: number): { ret: number; data: Uint8Array } {
-    return this.readFromBuffer(size);
+  /** Blocking variant of fd_wait for the 'atomics' mode (no JSPI) */
+  fd_wait_sync(next: () => string): void {
+    if (this.pending.length === 0) {
+      this.pending = next() + '\n';
+    }
   }
 
-  private readFromBuffer(size: number): { ret: number; data: Uint8Array } {
-    const available = this.buffer.length - this.position;
-    if (available === 0) {
-      return { ret: wasi.ERRNO_SUCCESS, data: new Uint8Array(0) };
-    }
-    const toRead = Math.min(size, available);
-    const data = this.buffer.slice(this.position, this.position + toRead);
-    this.position += toRead;
-    return { ret: wasi.ERRNO_SUCCESS, data };
+  /** Encode pending input into `target`; returns the number of bytes written */
+  fd_read_into(target: Uint8Array): number {
+    if (this.pending.length === 0) return 0;
+    const { read, written } = this.encoder.encodeInto(this.pending, target);
+    this.pending = this.pending.slice(read);
+    return written;
+  }
+
+  /** Sync read - returns buffered data only */
+  fd_read(size: number): { ret: number; data: Uint8Array } {
+    const data = new Uint8Array(size);
+    const written = this.fd_read_into(data);
+    return { ret: wasi.ERRNO_SUCCESS, data: data.subarray(0, written) };
   }
 }
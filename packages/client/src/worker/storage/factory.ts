@@ -25,8 +25,8 @@ export interface CreateStorageOptions extends StorageConfig {
 export async function createStorageProvider(
   options: CreateStorageOptions
 ): Promise<StorageProvider> {
-  const { mode, storyId } = options;
-  const config: StorageConfig = { storyId };
+  const { mode, storyId, legacyStoryId } = options;
+  const config: StorageConfig = { storyId, legacyStoryId };
 
   switch (mode) {
     case 'memory':
@@ -18,11 +18,13 @@ import { generateFilename } from './filename-generator';
 export class OpfsProvider implements StorageProvider {
   private rootDir: FileSystemDirectoryHandle | null = null;
   private readonly storyId: string;
+  private readonly legacyStoryId?: string;
   private readonly openHandles: FileSystemSyncAccessHandle[] = [];
   private rootContents: Map<string, Inode> = new Map();
 
   constructor(config: StorageConfig) {
     this.storyId = config.storyId;
+    this.legacyStoryId = config.legacyStoryId;
   }
 
   /**
@@ -50,9 +52,11 @@ export class OpfsProvider implements StorageProvider {
       const opfsRoot = await navigator.storage.getDirectory();
 
       // Create directory structure: /wasiglk/[gameName]/[versionHash]/var/
-      // storyId is hierarchical like "advent/a3f2b1c8"
+      // storyId is hierarchical like "advent/0c5f8e2a93d1b7e4"
       // Files go in /var/ to mirror WASI structure and avoid conflicts with /home/
-      let dir = await opfsRoot.getDirectoryHandle('wasiglk', { create: true });
+      const base = await opfsRoot.getDirectoryHandle('wasiglk', { create: true });
+      await this.migrateLegacyFiles(base);
+      let dir = base;
       for (const segment of this.storyId.split('/')) {
         dir = await dir.getDirectoryHandle(segment, { create: true });
       }
@@ -72,6 +76,34 @@ export class OpfsProvider implements StorageProvider {
     return this.rootContents;
   }
 
+  /**
+   * Copy files saved under the legacy story ID (a hash of the first 1024
+   * bytes) into a story directory that does not exist yet. The legacy
+   * directory is left in place: releases sharing a header had the same
+   * legacy ID, so each of them takes its own copy.
+   */
+  private async migrateLegacyFiles(base: FileSystemDirectoryHandle): Promise<void> {
+    if (!this.legacyStoryId || this.legacyStoryId === this.storyId) return;
+    if (await findDirectory(base, this.storyId)) return;
+    const legacy = await findDirectory(base, this.legacyStoryId);
+    if (!legacy) return;
+
+    const segments = this.storyId.split('/');
+    const name = segments.pop()!;
+    let parent = base;
+    for (const segment of segments) {
+      parent = await parent.getDirectoryHandle(segment, { create: true });
+    }
+    try {
+      await copyDirectory(legacy, await parent.getDirectoryHandle(name, { create: true }));
+      console.log(`[opfs] Copied files from ${this.legacyStoryId} to ${this.storyId}`);
+    } catch (err) {
+      // Remove the partial copy so the next session tries again
+      await parent.removeEntry(name, { recursive: true }).catch(() => {});
+      throw err;
+    }
+  }
+
   /**
    * Recursively load files from an OPFS directory into a Map.
    */
@@ -218,3 +250,37 @@ export class OpfsProvider implements StorageProvider {
     console.log('[opfs] Closed all file handles');
   }
 }
+
+// Look up a nested directory without creating it
+async function findDirectory(
+  dir: FileSystemDirectoryHandle,
+  path: string,
+): Promise<FileSystemDirectoryHandle | null> {
+  for (const segment of path.split('/')) {
+    try {
+      dir = await dir.getDirectoryHandle(segment);
+    } catch (err) {
+      if (err instanceof DOMException && err.name === 'NotFoundError') return null;
+      throw err;
+    }
+  }
+  return dir;
+}
+
+async function copyDirectory(from: FileSystemDirectoryHandle, to: FileSystemDirectoryHandle): Promise<void> {
+  for await (const [name, handle] of from.entries()) {
+    if (handle.kind === 'directory') {
+      await copyDirectory(handle as FileSystemDirectoryHandle, await to.getDirectoryHandle(name, { create: true }));
+      continue;
+    }
+    const data = new Uint8Array(await (await (handle as FileSystemFileHandle).getFile()).arrayBuffer());
+    const target = await (await to.getFileHandle(name, { create: true })).createSyncAccessHandle();
+    try {
+      target.truncate(0);
+      target.write(data, { at: 0 });
+      target.flush();
+    } finally {
+      target.close();
+    }
+  }
+}
@@ -33,6 +33,8 @@ export interface FilePromptResult {
 /** Configuration for storage providers */
 export interface StorageConfig {
   storyId: string;
+  /** Story ID used before full-content fingerprints, to carry old files over */
+  legacyStoryId?: string;
 }
 
 /**
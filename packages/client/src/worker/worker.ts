@@ -2,7 +2,8 @@
  * @module
  *
  * Interpreter Worker - runs the WASM interpreter in a Web Worker using
- * browser_wasi_shim. Uses JSPI for async stdin and pluggable file storage.
+ * browser_wasi_shim. Uses JSPI for async stdin (or, where JSPI is unavailable,
+ * blocks on Atomics.wait over a shared mailbox) and pluggable file storage.
  */
 
 import {
@@ -20,18 +21,24 @@ import { AsyncStdinFd } from './stdin';
 import {
   createStorageProvider,
   isDialogProvider,
+  generateFilename,
   type StorageProvider,
   type FileType,
   type FileMode,
 } from './storage';
 import { AsyncFSAFile } from './storage/async-fsa-file';
-import type { MainToWorkerMessage, WorkerToMainMessage } from './messages';
+import { Mailbox } from './mailbox';
+import type { MainToWorkerMessage, StdinMode, WorkerToMainMessage } from './messages';
+import { UpdateStreamReader } from '../binary';
 import type { InputEvent, RemGlkUpdate } from '../protocol';
 
 let inputResolve: ((value: string) => void) | null = null;
 let generation = 0;
 let currentInputRequest: { windowId: number; type: 'line' | 'char' } | null = null;
 let timerIntervalId: ReturnType<typeof setInterval> | null = null;
+let timerInterval: number | null = null;
+let nextTimerAt = 0;
+let stdinMode: StdinMode = 'jspi';
 
 // File dialog state (for dialog mode)
 let pendingFileDialog: { filemode: FileMode; filetype: FileType } | null = null;
@@ -40,6 +47,17 @@ let fileDialogResolve: ((result: { filename: string | null; handle?: FileSystemF
 // Storage provider (set during init)
 let storageProvider: StorageProvider | null = null;
 
+// The running session, and whether it is being unwound for reuse (pool)
+let session: Promise<void> | null = null;
+let resetRequested = false;
+
+/**
+ * Thrown from the stdin read to unwind a session the client has stopped.
+ * It passes through the interpreter's frames and ends runInterpreter, so
+ * the worker can start another session.
+ */
+class SessionReset extends Error {}
+
 function post(msg: WorkerToMainMessage): void {
   self.postMessage(msg);
 }
@@ -47,65 +65,11 @@ function post(msg: WorkerToMainMessage): void {
 self.onmessage = async (e: MessageEvent<MainToWorkerMessage>) => {
   const msg = e.data;
   if (msg.type === 'init') {
-    await runInterpreter(msg);
-  } else if (msg.type === 'input' && inputResolve) {
-    const resolve = inputResolve;
-    inputResolve = null;
-    // Format as RemGlk input event
-    const inputEvent = {
-      type: currentInputRequest?.type ?? 'line',
-      gen: generation,
-      window: currentInputRequest?.windowId ?? 0,
-      value: msg.value,
-    };
-    resolve(JSON.stringify(inputEvent));
-  } else if (msg.type === 'arrange' && inputResolve) {
-    // Send arrange event to interrupt current input request
-    const resolve = inputResolve;
-    inputResolve = null;
-    resolve(JSON.stringify({
-      type: 'arrange',
-      gen: generation,
-      metrics: msg.metrics,
-    }));
-  } else if (msg.type === 'mouse' && inputResolve) {
-    // Send mouse click event to interrupt current input request
-    const resolve = inputResolve;
-    inputResolve = null;
-    resolve(JSON.stringify({
-      type: 'mouse',
-      gen: generation,
-      window: msg.windowId,
-      x: msg.x,
-      y: msg.y,
-    }));
-  } else if (msg.type === 'hyperlink' && inputResolve) {
-    // Send hyperlink click event to interrupt current input request
-    const resolve = inputResolve;
-    inputResolve = null;
-    resolve(JSON.stringify({
-      type: 'hyperlink',
-      gen: generation,
-      window: msg.windowId,
-      value: msg.linkValue,
-    }));
-  } else if (msg.type === 'redraw' && inputResolve) {
-    // Send redraw request to interrupt current input request
-    const resolve = inputResolve;
-    inputResolve = null;
-    resolve(JSON.stringify({
-      type: 'redraw',
-      gen: generation,
-      window: msg.windowId,
-    }));
-  } else if (msg.type === 'refresh' && inputResolve) {
-    // Send refresh request to get full state resent
-    const resolve = inputResolve;
-    inputResolve = null;
-    resolve(JSON.stringify({
-      type: 'refresh',
-      gen: generation,
-    }));
+    session = runInterpreter(msg);
+    await session;
+  } else if (msg.type === 'reset') {
+    await resetSession();
+    post({ type: 'ready' });
   } else if (msg.type === 'fileDialogResult' && fileDialogResolve) {
     // File dialog completed, resolve the pending promise
     const resolve = fileDialogResolve;
@@ -113,15 +77,75 @@ self.onmessage = async (e: MessageEvent<MainToWorkerMessage>) => {
     resolve({ filename: msg.filename, handle: msg.handle });
   } else if (msg.type === 'stop') {
     self.close();
+  } else if (inputResolve) {
+    const event = inputEventFor(msg);
+    if (event) {
+      const resolve = inputResolve;
+      inputResolve = null;
+      resolve(event);
+    }
   }
 };
 
+/**
+ * Format a message from the main thread as a RemGlk input event, or null if
+ * it is not one. Each event interrupts the current input request.
+ */
+function inputEventFor(msg: MainToWorkerMessage): string | null {
+  switch (msg.type) {
+    case 'input':
+      return JSON.stringify({
+        type: currentInputRequest?.type ?? 'line',
+        gen: generation,
+        window: currentInputRequest?.windowId ?? 0,
+        value: msg.value,
+      });
+    case 'arrange':
+      return JSON.stringify({ type: 'arrange', gen: generation, metrics: msg.metrics });
+    case 'mouse':
+      return JSON.stringify({ type: 'mouse', gen: generation, window: msg.windowId, x: msg.x, y: msg.y });
+    case 'hyperlink':
+      return JSON.stringify({ type: 'hyperlink', gen: generation, window: msg.windowId, value: msg.linkValue });
+    case 'redraw':
+      return JSON.stringify({ type: 'redraw', gen: generation, window: msg.windowId });
+    case 'refresh':
+      // Request the full state be resent
+      return JSON.stringify({ type: 'refresh', gen: generation });
+    default:
+      return null;
+  }
+}
+
+/**
+ * Block until the main thread sends an input event or the timer fires
+ * ('atomics' stdin mode). The timer is the Atomics.wait timeout.
+ */
+function waitForInputSync(mailbox: Mailbox): string {
+  for (;;) {
+    const timeout = timerInterval !== null ? Math.max(0, nextTimerAt - performance.now()) : undefined;
+    const text = mailbox.receive(timeout);
+    if (text !== null) {
+      const event = inputEventFor(JSON.parse(text) as MainToWorkerMessage);
+      if (event) return event;
+    } else if (timerInterval !== null && performance.now() >= nextTimerAt) {
+      nextTimerAt = performance.now() + timerInterval;
+      return JSON.stringify({ type: 'timer', gen: generation });
+    }
+  }
+}
+
 async function runInterpreter(msg: MainToWorkerMessage & { type: 'init' }): Promise<void> {
   try {
-    // Initialize storage provider based on filesystem mode
+    stdinMode = msg.stdin ?? 'jspi';
+    const mailbox = stdinMode === 'atomics' ? new Mailbox(msg.mailbox!) : null;
+
+    // Initialize storage provider based on filesystem mode. Without JSPI
+    // the interpreter cannot wait for OPFS or file pickers, so files stay
+    // in memory.
     storageProvider = await createStorageProvider({
-      mode: msg.filesystem,
+      mode: mailbox ? 'memory' : msg.filesystem,
       storyId: msg.storyId,
+      legacyStoryId: msg.legacyStoryId,
     });
 
     // Set up dialog requester for dialog-capable providers
@@ -143,17 +167,27 @@ async function runInterpreter(msg: MainToWorkerMessage & { type: 'init' }): Prom
     // Initialize storage and get existing files
     const rootContents = await storageProvider.initialize();
 
+    // The first read is answered with the init event
+    const initEvent = (): string => {
+      generation = 1;
+      return JSON.stringify({
+        type: 'init',
+        gen: 0,
+        metrics: msg.metrics,
+        support: msg.support ?? ['timer', 'graphics', 'graphicswin', 'hyperlinks'],
+      } satisfies InputEvent);
+    };
+    const promptResponse = (filename: string | null): string => JSON.stringify({
+      type: 'specialresponse',
+      gen: generation,
+      response: 'fileref_prompt',
+      value: filename,
+    });
+
     // stdin: async for JSPI
     const stdin = new AsyncStdinFd(async () => {
-      if (generation === 0) {
-        generation = 1;
-        return JSON.stringify({
-          type: 'init',
-          gen: 0,
-          metrics: msg.metrics,
-          support: msg.support ?? ['timer', 'graphics', 'graphicswin', 'hyperlinks'],
-        } satisfies InputEvent);
-      }
+      if (resetRequested) throw new SessionReset();
+      if (generation === 0) return initEvent();
 
       // Check for pending file dialog
       if (pendingFileDialog) {
@@ -166,51 +200,39 @@ async function runInterpreter(msg: MainToWorkerMessage & { type: 'init' }): Prom
           filemode: dialogInfo.filemode,
         });
 
-        return JSON.stringify({
-          type: 'specialresponse',
-          gen: generation,
-          response: 'fileref_prompt',
-          value: result.filename,
-        });
+        return promptResponse(result.filename);
       }
 
-      return new Promise<string>(resolve => { inputResolve = resolve; });
+      const event = await new Promise<string>(resolve => { inputResolve = resolve; });
+      if (resetRequested) throw new SessionReset();
+      return event;
     });
 
-    // stdout: parse JSON updates, batching all output from one interpreter turn
-    let pendingBatch: RemGlkUpdate[] = [];
-    let batchScheduled = false;
+    // stdin: blocking for the 'atomics' mode. File prompts are answered
+    // with a generated name, as the memory provider does.
+    const nextEventSync = mailbox && ((): string => {
+      if (generation === 0) return initEvent();
+      if (pendingFileDialog) {
+        const { filetype } = pendingFileDialog;
+        pendingFileDialog = null;
+        return promptResponse(generateFilename(filetype));
+      }
+      return waitForInputSync(mailbox);
+    });
 
-    const stdout = ConsoleStdout.lineBuffered((line: string) => {
+    // stdout: JSON update lines, or binary frames when the client listed
+    // 'binary' in its support array. The interpreter coalesces each turn's
+    // output into a single update, so every update is posted as-is.
+    const updates = new UpdateStreamReader(handleUpdate, (line: string) => {
       if (!line.trim()) return;
       try {
-        const update = JSON.parse(line) as RemGlkUpdate;
-        // Track state immediately (before batched post)
-        if (update.gen !== undefined) generation = update.gen;
-        if (update.input && update.input.length > 0) {
-          currentInputRequest = { windowId: update.input[0].id, type: update.input[0].type };
-        }
-        if (update.timer !== undefined) handleTimerUpdate(update.timer);
-        if (update.specialinput) {
-          pendingFileDialog = { filemode: update.specialinput.filemode as FileMode, filetype: update.specialinput.filetype as FileType };
-        }
-        // Batch: the interpreter runs synchronously between glk_select calls,
-        // so all styled runs from one turn arrive in the same JS task.
-        // Merge them into one update on the next microtask.
-        pendingBatch.push(update);
-        if (!batchScheduled) {
-          batchScheduled = true;
-          queueMicrotask(() => {
-            batchScheduled = false;
-            const batch = pendingBatch;
-            pendingBatch = [];
-            post({ type: 'update', data: mergeRemGlkUpdates(batch) });
-          });
-        }
+        handleUpdate(JSON.parse(line) as RemGlkUpdate);
       } catch {
         console.log('[interpreter]', line);
       }
     });
+    // fd_write on stdout is intercepted (see wrapImports); this only backs the fd
+    const stdout = new ConsoleStdout(bytes => updates.push(bytes));
 
     // stderr - use console.debug for debug messages from the interpreter
     const stderr = ConsoleStdout.lineBuffered(line => console.debug('[interpreter]', line));
@@ -241,20 +263,26 @@ async function runInterpreter(msg: MainToWorkerMessage & { type: 'init' }): Prom
 
     // Create WASI and instantiate
     const wasiInstance = new WASI(msg.args, [], [stdin, stdout, stderr, root]);
-    const module = await WebAssembly.compile(msg.interpreter);
-    const imports = wrapWithJSPI(wasiInstance, stdin, storageProvider, root);
+    // The client sends a compiled module (see module-cache.ts)
+    const module = msg.interpreter instanceof WebAssembly.Module
+      ? msg.interpreter
+      : await WebAssembly.compile(msg.interpreter);
+    const imports = wrapImports(wasiInstance, stdin, nextEventSync, updates, storageProvider, root);
     const instance = await WebAssembly.instantiate(module, imports);
     wasiInstance.inst = instance as { exports: { memory: WebAssembly.Memory } };
 
-    // Run with JSPI
     const main = (instance.exports._start ?? instance.exports.main) as Function | undefined;
     if (!main) throw new Error('No _start or main export found');
 
-    // @ts-expect-error - JSPI API
-    const promisedMain = WebAssembly.promising(main);
-
     try {
-      await promisedMain();
+      if (nextEventSync) {
+        // Runs to completion on this thread; stdin reads block in Atomics.wait
+        main();
+      } else {
+        // Run with JSPI
+        // @ts-expect-error - JSPI API
+        await WebAssembly.promising(main)();
+      }
       post({ type: 'exit', code: 0 });
     } catch (err) {
       if (err instanceof WASIProcExit) {
@@ -267,48 +295,105 @@ async function runInterpreter(msg: MainToWorkerMessage & { type: 'init' }): Prom
       storageProvider?.close();
     }
   } catch (err) {
+    if (err instanceof SessionReset) return;
     post({ type: 'error', message: err instanceof Error ? err.message : String(err) });
   }
 }
 
-function wrapWithJSPI(
+/**
+ * End the current session and clear its state so the worker can run
+ * another (see WorkerPool). A session waiting for input is unwound at
+ * once; one that is mid-turn is unwound at its next read.
+ */
+async function resetSession(): Promise<void> {
+  resetRequested = true;
+  if (inputResolve) {
+    const resolve = inputResolve;
+    inputResolve = null;
+    resolve('');
+  }
+  if (fileDialogResolve) {
+    const resolve = fileDialogResolve;
+    fileDialogResolve = null;
+    resolve({ filename: null });
+  }
+  await session;
+
+  session = null;
+  generation = 0;
+  currentInputRequest = null;
+  handleTimerUpdate(null);
+  pendingFileDialog = null;
+  storageProvider = null;
+  stdinMode = 'jspi';
+  resetRequested = false;
+}
+
+/**
+ * WASI imports for the interpreter. With JSPI, stdin reads and persistent
+ * file operations suspend the interpreter; in the 'atomics' mode
+ * (`nextEventSync` set) every import is synchronous and stdin reads block
+ * until `nextEventSync` returns an event.
+ */
+function wrapImports(
   wasiInstance: WASI,
   stdin: AsyncStdinFd,
+  nextEventSync: (() => string) | null,
+  updates: UpdateStreamReader,
   provider: StorageProvider,
   root: PreopenDirectory,
 ): WebAssembly.Imports {
   const imports = wasiInstance.wasiImport;
   const ROOT_FD = 3; // Root preopen directory is fd 3
 
+  // Pending stdin input is encoded directly into the interpreter's read
+  // buffers in linear memory
+  const readStdin = (iovsPtr: number, iovsLen: number, nreadPtr: number): number => {
+    const memory = wasiInstance.inst.exports.memory;
+    const view = new DataView(memory.buffer);
+
+    let nread = 0;
+    for (let i = 0; i < iovsLen; i++) {
+      const buf = view.getUint32(iovsPtr + i * 8, true);
+      const len = view.getUint32(iovsPtr + i * 8 + 4, true);
+      const n = stdin.fd_read_into(new Uint8Array(memory.buffer, buf, len));
+      nread += n;
+      if (n < len) break;
+    }
+    view.setUint32(nreadPtr, nread, true);
+    return wasi.ERRNO_SUCCESS;
+  };
+
   // Async fd_read for stdin (other fds use sync path)
   const asyncFdRead = async (fd: number, iovsPtr: number, iovsLen: number, nreadPtr: number): Promise<number> => {
     // Stdin - async via JSPI
     if (fd === 0) {
-      const memory = wasiInstance.inst.exports.memory;
-      const view = new DataView(memory.buffer);
-      const bytes = new Uint8Array(memory.buffer);
-
-      let nread = 0;
-      for (let i = 0; i < iovsLen; i++) {
-        const buf = view.getUint32(iovsPtr + i * 8, true);
-        const len = view.getUint32(iovsPtr + i * 8 + 4, true);
-        const { ret, data } = await stdin.fd_read_async(len);
-        if (ret !== wasi.ERRNO_SUCCESS) {
-          view.setUint32(nreadPtr, nread, true);
-          return ret;
-        }
-        bytes.set(data, buf);
-        nread += data.length;
-        if (data.length < len) break;
-      }
-      view.setUint32(nreadPtr, nread, true);
-      return wasi.ERRNO_SUCCESS;
+      await stdin.fd_wait();
+      return readStdin(iovsPtr, iovsLen, nreadPtr);
     }
 
     // Other fds - sync (AsyncFSAFile.read() is sync via inherited WasiFile)
     return imports.fd_read(fd, iovsPtr, iovsLen, nreadPtr) as number;
   };
 
+  // Stdout is read in place: updates are decoded straight from the
+  // interpreter's output buffer in linear memory, with no copy per write
+  const fdWrite = (fd: number, iovsPtr: number, iovsLen: number, nwrittenPtr: number): number => {
+    if (fd !== 1) return imports.fd_write(fd, iovsPtr, iovsLen, nwrittenPtr) as number;
+    const memory = wasiInstance.inst.exports.memory;
+    const view = new DataView(memory.buffer);
+
+    let nwritten = 0;
+    for (let i = 0; i < iovsLen; i++) {
+      const buf = view.getUint32(iovsPtr + i * 8, true);
+      const len = view.getUint32(iovsPtr + i * 8 + 4, true);
+      updates.push(new Uint8Array(memory.buffer, buf, len));
+      nwritten += len;
+    }
+    view.setUint32(nwrittenPtr, nwritten, true);
+    return wasi.ERRNO_SUCCESS;
+  };
+
 
   // Async path_open for persistent file creation
   const asyncPathOpen = async (
@@ -399,9 +484,23 @@ function wrapWithJSPI(
     return result;
   };
 
+  if (nextEventSync) {
+    // Files stay in memory in this mode, so path_open and fd_close have
+    // nothing to wait for
+    const syncFdRead = (fd: number, iovsPtr: number, iovsLen: number, nreadPtr: number): number => {
+      if (fd !== 0) return imports.fd_read(fd, iovsPtr, iovsLen, nreadPtr) as number;
+      stdin.fd_wait_sync(nextEventSync);
+      return readStdin(iovsPtr, iovsLen, nreadPtr);
+    };
+    return {
+      wasi_snapshot_preview1: { ...imports, fd_write: fdWrite, fd_read: syncFdRead },
+    };
+  }
+
   return {
     wasi_snapshot_preview1: {
       ...imports,
+      fd_write: fdWrite,
       // @ts-expect-error - JSPI API
       fd_read: new WebAssembly.Suspending(asyncFdRead),
       // @ts-expect-error - JSPI API
@@ -412,6 +511,21 @@ function wrapWithJSPI(
   };
 }
 
+/**
+ * Track protocol state from an interpreter update and forward it.
+ */
+function handleUpdate(update: RemGlkUpdate): void {
+  if (update.gen !== undefined) generation = update.gen;
+  if (update.input && update.input.length > 0) {
+    currentInputRequest = { windowId: update.input[0].id, type: update.input[0].type };
+  }
+  if (update.timer !== undefined) handleTimerUpdate(update.timer);
+  if (update.specialinput) {
+    pendingFileDialog = { filemode: update.specialinput.filemode as FileMode, filetype: update.specialinput.filetype as FileType };
+  }
+  post({ type: 'update', data: update });
+}
+
 /**
  * Find a file in the directory tree by path.
  */
@@ -433,44 +547,10 @@ function findFileInTree(dir: Directory, path: string): Inode | null {
   return current;
 }
 
-/**
- * Merge multiple RemGlk updates from one interpreter turn into one.
- * Style changes cause the interpreter to flush per styled run, but
- * the renderer needs all content from one turn together.
- */
-function mergeRemGlkUpdates(updates: RemGlkUpdate[]): RemGlkUpdate {
-  if (updates.length === 1) return updates[0];
-  const merged: RemGlkUpdate = { type: 'update', gen: 0 };
-  for (const update of updates) {
-    if (update.gen !== undefined) merged.gen = update.gen;
-    if (update.type === 'error') merged.type = 'error';
-    if (update.message) merged.message = update.message;
-    if (update.windows) merged.windows = update.windows;
-    if (update.input) merged.input = update.input;
-    if (update.timer !== undefined) merged.timer = update.timer;
-    if (update.specialinput) merged.specialinput = update.specialinput;
-    if (update.disable !== undefined) merged.disable = update.disable;
-    if (update.exit !== undefined) merged.exit = update.exit;
-    if (update.debugoutput) merged.debugoutput = [...(merged.debugoutput ?? []), ...update.debugoutput];
-    if (update.content) {
-      if (!merged.content) merged.content = [];
-      for (const c of update.content) {
-        const existing = merged.content.find(e => e.id === c.id);
-        if (existing && c.text) {
-          if (!existing.text) existing.text = [];
-          existing.text.push(...c.text);
-        } else {
-          merged.content.push({ ...c, text: c.text ? [...c.text] : undefined });
-        }
-      }
-    }
-  }
-  return merged;
-}
-
 /**
  * Handle timer updates from the interpreter.
- * Sets up or cancels a JavaScript interval timer.
+ * Sets up or cancels a JavaScript interval timer. In the 'atomics' mode
+ * the timer is the Atomics.wait timeout instead (see waitForInputSync).
  */
 function handleTimerUpdate(interval: number | null): void {
   // Clear any existing timer
@@ -478,9 +558,11 @@ function handleTimerUpdate(interval: number | null): void {
     clearInterval(timerIntervalId);
     timerIntervalId = null;
   }
+  timerInterval = interval !== null && interval > 0 ? interval : null;
+  nextTimerAt = performance.now() + (timerInterval ?? 0);
 
   // Set up new timer if interval is specified
-  if (interval !== null && interval > 0) {
+  if (timerInterval !== null && stdinMode === 'jspi') {
     timerIntervalId = setInterval(() => {
       // Fire timer event if we're waiting for input
       if (inputResolve) {
@@ -491,6 +573,6 @@ function handleTimerUpdate(interval: number | null): void {
           gen: generation,
         }));
       }
-    }, interval);
+    }, timerInterval);
   }
 }
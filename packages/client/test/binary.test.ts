@@ -0,0 +1,145 @@
+import { describe, expect, test } from 'bun:test';
+import { decodeBinaryUpdate, FRAME_MARKER, UpdateStreamReader } from '../src/binary';
+import type { RemGlkUpdate } from '../src/protocol';
+
+/**
+ * Helper to build binary records the way protocol.zig writes them
+ */
+class FrameBuilder {
+  private bytes: number[] = [];
+
+  record(tag: number, body: (b: FrameBuilder) => void): this {
+    const inner = new FrameBuilder();
+    body(inner);
+    this.bytes.push(tag);
+    this.u32(inner.bytes.length);
+    this.bytes.push(...inner.bytes);
+    return this;
+  }
+
+  u8(value: number): this {
+    this.bytes.push(value);
+    return this;
+  }
+
+  u32(value: number): this {
+    const buf = new Uint8Array(4);
+    new DataView(buf.buffer).setUint32(0, value, true);
+    this.bytes.push(...buf);
+    return this;
+  }
+
+  i32(value: number): this {
+    return this.u32(value >>> 0);
+  }
+
+  f64(value: number): this {
+    const buf = new Uint8Array(8);
+    new DataView(buf.buffer).setFloat64(0, value, true);
+    this.bytes.push(...buf);
+    return this;
+  }
+
+  string(text: string): this {
+    const encoded = new TextEncoder().encode(text);
+    this.u32(encoded.length);
+    this.bytes.push(...encoded);
+    return this;
+  }
+
+  payload(): Uint8Array {
+    return new Uint8Array(this.bytes);
+  }
+
+  frame(): Uint8Array {
+    return new FrameBuilder().u8(FRAME_MARKER).u32(this.bytes.length).append(this.bytes).payload();
+  }
+
+  private append(bytes: number[]): this {
+    this.bytes.push(...bytes);
+    return this;
+  }
+}
+
+describe('decodeBinaryUpdate', () => {
+  test('decodes windows, buffer text and input requests', () => {
+    const payload = new FrameBuilder()
+      .record(1, b => b.u32(3).u8(4).u32(0)) // gen 3, windows follow
+      .record(2, b => b.u32(1).u8(1).u32(0).f64(0).f64(0).f64(800).f64(40).u32(80).u32(2))
+      .record(3, b => b.u32(2).u8(1)) // content for window 2, clear
+      .record(4, b => b.u8(1)) // append
+      .record(5, b => b.u8(0).u32(0).string('Hello '))
+      .record(5, b => b.u8(1).u32(9).string('café'))
+      .record(9, b => b.u32(2).u8(0).u32(3).u8(0).u32(0).u32(0).string('').u8(1).string('escape'))
+      .payload();
+
+    expect(decodeBinaryUpdate(payload)).toEqual({
+      type: 'update',
+      gen: 3,
+      windows: [{ id: 1, type: 'grid', rock: 0, left: 0, top: 0, width: 800, height: 40, gridwidth: 80, gridheight: 2 }],
+      content: [{
+        id: 2,
+        clear: true,
+        text: [{
+          append: true,
+          content: [
+            { style: 'normal', text: 'Hello ' },
+            { style: 'emphasized', text: 'café', hyperlink: 9 },
+          ],
+        }],
+      }],
+      input: [{ id: 2, type: 'line', gen: 3, terminators: ['escape'] }],
+    } satisfies RemGlkUpdate);
+  });
+
+  test('decodes grid lines, draw ops and flags', () => {
+    const payload = new FrameBuilder()
+      .record(1, b => b.u32(5).u8(1 | 2 | 8).u32(0)) // disable, exit, timer cancelled
+      .record(3, b => b.u32(4).u8(0))
+      .record(8, b => b.u32(1))
+      .record(5, b => b.u8(3).u32(0).string('Score'))
+      .record(3, b => b.u32(6).u8(0))
+      .record(7, b => b.u8(0).u32(0xff8000).u32(0).i32(-2).i32(3).u32(10).u32(20).u32(0))
+      .record(7, b => b.u8(4).u32(0).u32(0).i32(0).i32(0).u32(2).u32(1).u32(2).u32(2).u32(0xff000000))
+      .record(42, b => b.u32(0)) // Unknown records are skipped
+      .record(11, b => b.string('debug'))
+      .payload();
+
+    expect(decodeBinaryUpdate(payload)).toEqual({
+      type: 'update',
+      gen: 5,
+      timer: null,
+      disable: true,
+      exit: true,
+      content: [
+        { id: 4, lines: [{ line: 1, content: [{ style: 'header', text: 'Score' }] }] },
+        {
+          id: 6,
+          draw: [
+            { special: 'fill', color: '#FF8000', x: -2, y: 3, width: 10, height: 20 },
+            { special: 'raster', x: 0, y: 0, width: 2, height: 1, runs: [2, 0xff000000] },
+          ],
+        },
+      ],
+      debugoutput: ['debug'],
+    } satisfies RemGlkUpdate);
+  });
+});
+
+describe('UpdateStreamReader', () => {
+  test('splits JSON lines and binary frames across arbitrary chunks', () => {
+    const updates: RemGlkUpdate[] = [];
+    const lines: string[] = [];
+    const reader = new UpdateStreamReader(u => updates.push(u), l => lines.push(l));
+
+    const json = new TextEncoder().encode('{"type":"update","gen":1}\n');
+    const frame = new FrameBuilder().record(1, b => b.u32(2).u8(0).u32(0)).frame();
+    const stream = new Uint8Array([...json, ...frame, ...json]);
+
+    // Feed one byte at a time
+    for (let i = 0; i < stream.length; i++) reader.push(stream.subarray(i, i + 1));
+
+    expect(lines).toEqual(['{"type":"update","gen":1}', '{"type":"update","gen":1}']);
+    expect(updates).toEqual([{ type: 'update', gen: 2 }]);
+  });
+});
@@ -0,0 +1,34 @@
+import { describe, expect, test } from 'bun:test';
+import { Fingerprint, fingerprint, readFingerprinted } from '../src/fingerprint';
+
+const encode = (text: string) => new TextEncoder().encode(text);
+
+describe('fingerprint', () => {
+  test('low half is xxHash32 with seed 0', () => {
+    // Reference values from the xxHash test suite
+    expect(fingerprint(new Uint8Array(0)).slice(8)).toBe('02cc5d05');
+    expect(fingerprint(encode('abc')).slice(8)).toBe('32d153ff');
+    expect(fingerprint(encode('Nobody inspects the spammish repetition')).slice(8)).toBe('e2293b2f');
+  });
+
+  test('covers the whole file, not just the header', () => {
+    const a = new Uint8Array(4096);
+    const b = new Uint8Array(4096);
+    b[4000] = 1;
+    expect(fingerprint(a)).not.toBe(fingerprint(b));
+  });
+
+  test('gives the same result however the input is chunked', () => {
+    const data = new Uint8Array(1000).map((_, i) => (i * 31) & 0xff);
+    const chunked = new Fingerprint();
+    for (let i = 0; i < data.length; i += 7) chunked.update(data.subarray(i, i + 7));
+    expect(chunked.digest()).toBe(fingerprint(data));
+  });
+
+  test('readFingerprinted returns the body and its fingerprint', async () => {
+    const data = encode('story file contents '.repeat(100));
+    const result = await readFingerprinted(new Response(data));
+    expect(result.data).toEqual(data);
+    expect(result.fingerprint).toBe(fingerprint(data));
+  });
+});
@@ -0,0 +1,20 @@
+import { describe, expect, test } from 'bun:test';
+import { interpreterArgs, type FormatInfo } from '../src/format';
+
+const glulx: FormatInfo = { format: 'glulx', interpreter: 'glulxe', isBlorb: false };
+const zcode: FormatInfo = { format: 'zcode', interpreter: 'fizmo', isBlorb: false };
+
+describe('interpreterArgs', () => {
+  test('runs the story with no extra flags by default', () => {
+    expect(interpreterArgs(glulx, '/sys/story.ulx')).toEqual(['glulxe', '/sys/story.ulx']);
+  });
+
+  test('autosaves into /var/ and autorestores for Glulx', () => {
+    expect(interpreterArgs(glulx, '/sys/story.ulx', true))
+      .toEqual(['glulxe', '-autosave', '-autorestore', '-autodir', '/var', '/sys/story.ulx']);
+  });
+
+  test('ignores autosave for interpreters without it', () => {
+    expect(interpreterArgs(zcode, '/sys/story.ulx', true)).toEqual(['fizmo', '/sys/story.ulx']);
+  });
+});
@@ -0,0 +1,43 @@
+import { describe, expect, test } from 'bun:test';
+import { Mailbox } from '../src/worker/mailbox';
+
+describe('Mailbox', () => {
+  test('delivers messages in order across the end of the ring', () => {
+    const buffer = Mailbox.create(32);
+    const sender = new Mailbox(buffer);
+    const receiver = new Mailbox(buffer);
+
+    for (let i = 0; i < 10; i++) {
+      expect(sender.send(`msg ${i} é`)).toBe(true);
+      expect(receiver.receive(0)).toBe(`msg ${i} é`);
+    }
+  });
+
+  test('refuses messages that do not fit and times out when empty', () => {
+    const buffer = Mailbox.create(32);
+    const sender = new Mailbox(buffer);
+    const receiver = new Mailbox(buffer);
+
+    expect(sender.send('0123456789')).toBe(true);
+    expect(sender.send('0123456789abcdef')).toBe(false);
+    expect(receiver.receive(0)).toBe('0123456789');
+    expect(receiver.receive(0)).toBeNull();
+    expect(sender.send('0123456789abcdef')).toBe(true);
+  });
+
+  test('rejects messages larger than the mailbox can ever hold', () => {
+    const buffer = Mailbox.create(32);
+    const sender = new Mailbox(buffer);
+    const receiver = new Mailbox(buffer);
+
+    const largest = 'x'.repeat(27);
+    expect(sender.canHold(largest)).toBe(true);
+    expect(sender.canHold(largest + 'x')).toBe(false);
+    expect(() => sender.send(largest + 'x')).toThrow(RangeError);
+    // Counted in UTF-8 bytes, not characters
+    expect(sender.canHold('é'.repeat(14))).toBe(false);
+
+    expect(sender.send(largest)).toBe(true);
+    expect(receiver.receive(0)).toBe(largest);
+  });
+});
@@ -0,0 +1,14 @@
+import { describe, expect, test } from 'bun:test';
+import { compileInterpreterModule } from '../src/module-cache';
+
+// The smallest valid module: magic number and version
+const emptyModule = () => new Uint8Array([0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00]).buffer;
+
+describe('compileInterpreterModule', () => {
+  test('compiles each distinct content once', async () => {
+    const first = await compileInterpreterModule(emptyModule());
+    const second = await compileInterpreterModule(emptyModule());
+    expect(first).toBeInstanceOf(WebAssembly.Module);
+    expect(second).toBe(first);
+  });
+});
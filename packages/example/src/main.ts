@@ -105,6 +105,8 @@ function handleUpdate(update: RemGlkUpdate): void {
           outputEl.textContent = '';
         }
         for (const para of content.text ?? []) {
+          // Paragraphs without append start a new line
+          if (!para.append && outputEl.textContent) appendOutput('\n');
           for (const span of para.content ?? []) {
             appendOutput(spanText(span));
           }
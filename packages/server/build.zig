@@ -20,8 +20,20 @@ pub fn build(b: *std.Build) void {
 
     const optimize = b.standardOptimizeOption(.{});
 
+    // WebAssembly SIMD128 for the Glk layer (output escaping, UTF-8 encoding)
+    // Usage: zig build -Dsimd=true
+    const simd = b.option(bool, "simd", "Build WASI-Glk with WebAssembly SIMD128") orelse false;
+
     // Build WASI-Glk as a compiled object (shared by all interpreters)
-    const wasi_glk = buildWasiGlk(b, target, optimize);
+    const wasi_glk = buildWasiGlk(b, target, optimize, simd);
+
+    // Interpreters ready for Wizer pre-initialization (run.ts preinit snapshots
+    // them after C runtime init; see src/preinit.zig). WASI only.
+    // Usage: zig build -Dpreinit=true
+    const preinit = if (!is_native and (b.option(bool, "preinit", "Build interpreters for Wizer pre-initialization") orelse false))
+        buildPreinit(b, target, optimize)
+    else
+        null;
 
     // Build zlib (used by Scare)
     const zlib = buildZlib(b, target, optimize);
@@ -46,6 +58,7 @@ pub fn build(b: *std.Build) void {
 
     inline for (interpreters) |info| {
         const exe = info[2](b, target, optimize, wasi_glk);
+        if (preinit) |obj| addPreinit(exe, obj);
         const install = b.addInstallArtifact(exe, .{});
         b.step(info[0], info[1]).dependOn(&install.step);
         b.getInstallStep().dependOn(&install.step);
@@ -60,6 +73,7 @@ pub fn build(b: *std.Build) void {
 
     inline for (setjmp_interpreters) |info| {
         const exe = info[2](b, target, optimize, wasi_glk);
+        if (preinit) |obj| addPreinit(exe, obj);
         const install = b.addInstallArtifact(exe, .{});
         b.step(info[0], info[1]).dependOn(&install.step);
         b.getInstallStep().dependOn(&install.step);
@@ -67,6 +81,7 @@ pub fn build(b: *std.Build) void {
 
     // Scare (needs zlib + setjmp, works on both native and WASM)
     const scare = buildScare(b, target, optimize, wasi_glk, zlib);
+    if (preinit) |obj| addPreinit(scare, obj);
     const scare_install = b.addInstallArtifact(scare, .{});
     b.step("scare", "Build Scare interpreter (ADRIFT)").dependOn(&scare_install.step);
     b.getInstallStep().dependOn(&scare_install.step);
@@ -74,27 +89,32 @@ pub fn build(b: *std.Build) void {
     // TADS 2 (pure C, no TADS 3 code) and TADS 3 (C++, no TADS 2 code)
     // Both use setjmp/longjmp (not C++ exceptions)
     const tads2 = buildTads2(b, target, optimize, wasi_glk);
+    if (preinit) |obj| addPreinit(tads2, obj);
     const tads2_install = b.addInstallArtifact(tads2, .{});
     b.step("tads2", "Build TADS 2 interpreter").dependOn(&tads2_install.step);
     b.getInstallStep().dependOn(&tads2_install.step);
 
     const tads3 = buildTads3(b, target, optimize, wasi_glk);
+    if (preinit) |obj| addPreinit(tads3, obj);
     const tads3_install = b.addInstallArtifact(tads3, .{});
     b.step("tads3", "Build TADS 3 interpreter").dependOn(&tads3_install.step);
     b.getInstallStep().dependOn(&tads3_install.step);
 
     // Scott Adams family interpreters (need c64diskimage/unp64 libraries)
     const scott = buildScott(b, target, optimize, wasi_glk, c64diskimage, unp64);
+    if (preinit) |obj| addPreinit(scott, obj);
     const scott_install = b.addInstallArtifact(scott, .{});
     b.step("scott", "Build Scott interpreter (Scott Adams)").dependOn(&scott_install.step);
     b.getInstallStep().dependOn(&scott_install.step);
 
     const taylor = buildTaylor(b, target, optimize, wasi_glk, c64diskimage, unp64);
+    if (preinit) |obj| addPreinit(taylor, obj);
     const taylor_install = b.addInstallArtifact(taylor, .{});
     b.step("taylor", "Build Taylor interpreter (Adventure Int'l UK)").dependOn(&taylor_install.step);
     b.getInstallStep().dependOn(&taylor_install.step);
 
     const plus = buildPlus(b, target, optimize, wasi_glk, c64diskimage);
+    if (preinit) |obj| addPreinit(plus, obj);
     const plus_install = b.addInstallArtifact(plus, .{});
     b.step("plus", "Build Plus interpreter (Scott Adams Plus)").dependOn(&plus_install.step);
     b.getInstallStep().dependOn(&plus_install.step);
@@ -130,11 +150,33 @@ pub fn build(b: *std.Build) void {
 }
 
 // Build the WASI-Glk implementation from Zig source
-fn buildWasiGlk(b: *std.Build, target: std.Build.ResolvedTarget, optimize: std.builtin.OptimizeMode) *std.Build.Step.Compile {
+fn buildWasiGlk(b: *std.Build, target: std.Build.ResolvedTarget, optimize: std.builtin.OptimizeMode, simd: bool) *std.Build.Step.Compile {
+    const glk_target = if (simd and target.result.cpu.arch == .wasm32)
+        b.resolveTargetQuery(.{
+            .cpu_arch = .wasm32,
+            .os_tag = .wasi,
+            .cpu_features_add = std.Target.wasm.featureSet(&.{.simd128}),
+        })
+    else
+        target;
+
     return b.addObject(.{
         .name = "wasi_glk",
         .root_module = b.createModule(.{
             .root_source_file = b.path("src/root.zig"),
+            .target = glk_target,
+            .optimize = optimize,
+            .link_libc = true,
+        }),
+    });
+}
+
+// Build the Wizer entry points (linked in by addPreinit)
+fn buildPreinit(b: *std.Build, target: std.Build.ResolvedTarget, optimize: std.builtin.OptimizeMode) *std.Build.Step.Compile {
+    return b.addObject(.{
+        .name = "wasi_glk_preinit",
+        .root_module = b.createModule(.{
+            .root_source_file = b.path("src/preinit.zig"),
             .target = target,
             .optimize = optimize,
             .link_libc = true,
@@ -142,6 +184,14 @@ fn buildWasiGlk(b: *std.Build, target: std.Build.ResolvedTarget, optimize: std.b
     });
 }
 
+// Link an interpreter as a WASI reactor exporting the Wizer entry points.
+// The module has no _start until run.ts preinit has run Wizer over it.
+fn addPreinit(exe: *std.Build.Step.Compile, preinit: *std.Build.Step.Compile) void {
+    exe.addObject(preinit);
+    exe.wasi_exec_model = .reactor;
+    exe.export_symbol_names = &.{ "wizer.initialize", "wizer.resume" };
+}
+
 // Build zlib as a static library
 fn buildZlib(b: *std.Build, target: std.Build.ResolvedTarget, optimize: std.builtin.OptimizeMode) *std.Build.Step.Compile {
     const lib = b.addLibrary(.{
@@ -201,6 +251,8 @@ fn buildGlulxe(b: *std.Build, target: std.Build.ResolvedTarget, optimize: std.bu
         .flags = &.{
             "-DOS_UNIX", "-Wall", "-Wmissing-prototypes", "-Wno-unused",
             "-D_WASI_EMULATED_SIGNAL",
+            // -autosave / -autorestore, with the library state in autosave.zig
+            "-DGLKUNIX_AUTOSAVE_FEATURES",
         },
     });
 
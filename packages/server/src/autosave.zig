@@ -0,0 +1,810 @@
+// autosave.zig - Library state for session autosave (GLKUNIX_AUTOSAVE_FEATURES)
+//
+// Glulxe built with GLKUNIX_AUTOSAVE_FEATURES autosaves at each glk_select:
+// its VM state goes in one file and the Glk library state in another, written
+// by glkunix_save_library_state. Started with -autorestore, it reads both back
+// through the normal startup path (glkunix_load_library_state, then
+// glkunix_update_from_library_state) and carries on from that glk_select.
+//
+// The library state is JSON: the window tree, grid contents, streams,
+// filerefs and pending input requests, plus the interpreter's own state under
+// "extra" (written through the glkunix_serialize_* calls). Objects come back
+// under their saved ids, which double as the update tags the interpreter uses
+// to find them again. Line buffers and memory stream buffers are VM arrays,
+// saved as the keys the dispatch layer's autorestore registry hands out.
+//
+// Not kept: buffer window text (the client had it) and graphics window
+// contents (those windows come back blank until the game redraws them).
+// Resource streams are dropped, as are file streams whose file has gone.
+
+const std = @import("std");
+const types = @import("types.zig");
+const state = @import("state.zig");
+const stream = @import("stream.zig");
+const window = @import("window.zig");
+const dispatch = @import("dispatch.zig");
+const protocol = @import("protocol.zig");
+const output = @import("output.zig");
+
+const glui32 = types.glui32;
+const winid_t = types.winid_t;
+const strid_t = types.strid_t;
+const frefid_t = types.frefid_t;
+const DispatchRock = types.DispatchRock;
+const WindowData = state.WindowData;
+const StreamData = state.StreamData;
+const FileRefData = state.FileRefData;
+const JsonWriter = output.JsonWriter;
+const Value = std.json.Value;
+const allocator = state.allocator;
+
+// Bumped when the saved layout changes; older autosaves are then refused
+const format_version = 1;
+
+// Interpreter callbacks that write or read its own state under "extra".
+// Contexts are a *JsonWriter (serializing) or a *std.json.Value (unserializing).
+const SerializeFn = *const fn (?*anyopaque, ?*anyopaque) callconv(.c) void;
+const UnserializeFn = *const fn (?*anyopaque, ?*anyopaque) callconv(.c) c_int;
+
+// ============== Saved Records ==============
+
+const WindowRecord = struct {
+    id: glui32,
+    rock: glui32,
+    win_type: glui32,
+    parent: ?glui32 = null,
+    child1: ?glui32 = null,
+    child2: ?glui32 = null,
+    split_method: glui32 = 0,
+    split_size: glui32 = 0,
+    split_key: ?glui32 = null,
+    echo_stream: ?glui32 = null,
+    char_request: bool = false,
+    char_request_uni: bool = false,
+    line_request: bool = false,
+    line_request_uni: bool = false,
+    mouse_request: bool = false,
+    hyperlink_request: bool = false,
+    line_buffer: ?i64 = null, // Array key from the autorestore registry
+    line_buflen: glui32 = 0,
+    line_initlen: glui32 = 0,
+    line_terminators: []const glui32 = &.{},
+    cursor_x: glui32 = 0,
+    cursor_y: glui32 = 0,
+    grid_width: glui32 = 0,
+    grid_height: glui32 = 0,
+    grid_cells: ?[]const u32 = null, // GridCells as their u32 bits, row by row
+    gfx_background: glui32 = 0xFFFFFF,
+};
+
+const StreamRecord = struct {
+    id: glui32,
+    rock: glui32,
+    stream_type: state.StreamType,
+    readable: bool,
+    writable: bool,
+    readcount: glui32 = 0,
+    writecount: glui32 = 0,
+    // Window stream
+    win: ?glui32 = null,
+    // Memory stream
+    buf: ?i64 = null, // Array key from the autorestore registry
+    buflen: glui32 = 0,
+    bufptr: glui32 = 0,
+    is_unicode: bool = false,
+    // File stream
+    path: ?[]const u8 = null,
+    pos: u64 = 0,
+    textmode: bool = false,
+};
+
+const FileRefRecord = struct {
+    id: glui32,
+    rock: glui32,
+    filename: []const u8,
+    usage: glui32,
+    textmode: bool,
+};
+
+const SavedState = struct {
+    version: u32,
+    root: ?glui32 = null,
+    current_stream: ?glui32 = null,
+    current_style: glui32 = 0,
+    current_hyperlink: glui32 = 0,
+    timer_interval: ?glui32 = null,
+    windows: []const WindowRecord = &.{},
+    streams: []const StreamRecord = &.{},
+    filerefs: []const FileRefRecord = &.{},
+};
+
+// glkunix_library_state: a loaded autosave, valid until freed
+const LibraryState = struct {
+    arena: std.heap.ArenaAllocator,
+    saved: SavedState = .{ .version = 0 },
+};
+
+// ============== Saving ==============
+
+export fn glkunix_save_library_state(file: strid_t, omitstream: strid_t, extra_state_func: ?SerializeFn, extra_state_rock: ?*anyopaque) callconv(.c) glui32 {
+    const dest: *StreamData = @ptrCast(@alignCast(file orelse return 0));
+    const omitted: ?*StreamData = @ptrCast(@alignCast(omitstream));
+
+    var out: output.OutputArena = .{};
+    defer out.deinit();
+    var jw = JsonWriter{ .out = &out };
+
+    jw.beginObject();
+    jw.field("version");
+    jw.int(format_version);
+    if (state.root_window) |root| {
+        jw.field("root");
+        jw.int(root.id);
+    }
+    if (state.current_stream) |cur| {
+        if (cur != omitted) {
+            jw.field("current_stream");
+            jw.int(cur.id);
+        }
+    }
+    jw.field("current_style");
+    jw.int(state.current_style);
+    jw.field("current_hyperlink");
+    jw.int(state.current_hyperlink);
+    if (state.timer_interval) |interval| {
+        jw.field("timer_interval");
+        jw.int(interval);
+    }
+
+    jw.field("windows");
+    jw.beginArray();
+    var win = state.window_list;
+    while (win) |w| : (win = w.next) jw.write(windowRecord(w));
+    jw.endArray();
+
+    jw.field("streams");
+    jw.beginArray();
+    var str = state.stream_list;
+    while (str) |s| : (str = s.next) {
+        if (s == omitted) continue;
+        if (streamRecord(s)) |record| jw.write(record);
+    }
+    jw.endArray();
+
+    jw.field("filerefs");
+    jw.beginArray();
+    var fref = state.fileref_list;
+    while (fref) |f| : (fref = f.next) {
+        jw.write(FileRefRecord{ .id = f.id, .rock = f.rock, .filename = f.filename, .usage = f.usage, .textmode = f.textmode });
+    }
+    jw.endArray();
+
+    jw.field("extra");
+    jw.beginObject();
+    if (extra_state_func) |func| func(&jw, extra_state_rock);
+    jw.endObject();
+    jw.endObject();
+
+    if (out.failed) return 0;
+    // Written as bytes: a text-mode stream would re-encode the UTF-8
+    if (dest.file) |fb| return @intFromBool(fb.write(out.written()));
+    stream.glk_put_buffer_stream(file, out.written().ptr, @intCast(out.written().len));
+    return 1;
+}
+
+fn windowRecord(w: *WindowData) WindowRecord {
+    var record = WindowRecord{
+        .id = w.id,
+        .rock = w.rock,
+        .win_type = w.win_type,
+        .parent = if (w.parent) |p| p.id else null,
+        .child1 = if (w.child1) |c| c.id else null,
+        .child2 = if (w.child2) |c| c.id else null,
+        .split_method = w.split_method,
+        .split_size = w.split_size,
+        .split_key = if (w.split_key) |k| k.id else null,
+        .echo_stream = if (w.echo_stream) |s| s.id else null,
+        .char_request = w.char_request,
+        .char_request_uni = w.char_request_uni,
+        .mouse_request = w.mouse_request,
+        .hyperlink_request = w.hyperlink_request,
+        .cursor_x = w.cursor_x,
+        .cursor_y = w.cursor_y,
+        .grid_width = w.grid_width,
+        .grid_height = w.grid_height,
+        .gfx_background = w.gfx_background,
+    };
+    if (w.grid_cells) |cells| {
+        record.grid_cells = @as([*]const u32, @ptrCast(cells.ptr))[0..cells.len];
+    }
+
+    // A line request whose buffer cannot be found again is dropped
+    const line_key = if (w.line_request)
+        locateArray(w.line_buffer, w.line_buflen, false, w.line_buffer_rock)
+    else if (w.line_request_uni)
+        locateArray(w.line_buffer_uni, w.line_buflen, true, w.line_buffer_rock)
+    else
+        null;
+    if (line_key) |key| {
+        record.line_request = w.line_request;
+        record.line_request_uni = w.line_request_uni;
+        record.line_buffer = key;
+        record.line_buflen = w.line_buflen;
+        record.line_initlen = w.line_initlen;
+        record.line_terminators = w.line_terminators[0..w.line_terminators_count];
+    }
+    return record;
+}
+
+// Null for streams that cannot be reopened in a later session
+fn streamRecord(s: *StreamData) ?StreamRecord {
+    var record = StreamRecord{
+        .id = s.id,
+        .rock = s.rock,
+        .stream_type = s.stream_type,
+        .readable = s.readable,
+        .writable = s.writable,
+        .readcount = s.readcount,
+        .writecount = s.writecount,
+    };
+    switch (s.stream_type) {
+        .window => record.win = (s.win orelse return null).id,
+        .memory => {
+            record.buflen = s.buflen;
+            record.bufptr = s.bufptr;
+            record.is_unicode = s.is_unicode;
+            if (s.buflen > 0) {
+                record.buf = if (s.is_unicode)
+                    locateArray(s.buf_uni, s.buflen, true, s.buf_rock) orelse return null
+                else
+                    locateArray(s.buf, s.buflen, false, s.buf_rock) orelse return null;
+            }
+        },
+        .file => {
+            const fb = s.file orelse return null;
+            record.path = s.path orelse return null;
+            record.pos = fb.position();
+            record.textmode = s.textmode;
+            // The file must hold what was written for the restore to reopen it
+            _ = fb.flush();
+        },
+        .resource => return null,
+    }
+    return record;
+}
+
+// Typecodes for retained arrays, as registered by the line input and memory
+// stream functions
+fn arrayTypecode(unicode: bool) [6:0]u8 {
+    return if (unicode) "&+#!Iu".* else "&+#!Cn".*;
+}
+
+// The key for a retained array, or null if there is no autorestore registry
+// or the array is not in VM memory
+fn locateArray(ptr: anytype, len: glui32, unicode: bool, rock: DispatchRock) ?i64 {
+    const locate = dispatch.locate_array_fn orelse return null;
+    const array = ptr orelse return null;
+    var typecode = arrayTypecode(unicode);
+    var elemsize: c_int = 0;
+    const key = locate(@ptrCast(array), len, &typecode, rock, &elemsize);
+    if (elemsize == 0) return null;
+    return key;
+}
+
+// ============== Loading ==============
+
+export fn glkunix_load_library_state(file: strid_t, extra_state_func: ?UnserializeFn, extra_state_rock: ?*anyopaque) callconv(.c) ?*anyopaque {
+    const src: *StreamData = @ptrCast(@alignCast(file orelse return null));
+    const library_state = allocator.create(LibraryState) catch return null;
+    library_state.* = .{ .arena = .init(allocator) };
+    if (!loadState(library_state, src, extra_state_func, extra_state_rock)) {
+        glkunix_library_state_free(library_state);
+        return null;
+    }
+    return library_state;
+}
+
+fn loadState(library_state: *LibraryState, src: *StreamData, extra_state_func: ?UnserializeFn, extra_state_rock: ?*anyopaque) bool {
+    const arena = library_state.arena.allocator();
+
+    var bytes: std.ArrayListUnmanaged(u8) = .empty;
+    var chunk: [4096]u8 = undefined;
+    while (true) {
+        const n = if (src.file) |fb| fb.read(&chunk) else stream.glk_get_buffer_stream(@ptrCast(src), &chunk, chunk.len);
+        if (n == 0) break;
+        bytes.appendSlice(arena, chunk[0..n]) catch return false;
+    }
+
+    const root = std.json.parseFromSliceLeaky(Value, arena, bytes.items, .{}) catch return false;
+    if (root != .object) return false;
+    const saved = std.json.parseFromValueLeaky(SavedState, arena, root, .{ .ignore_unknown_fields = true }) catch return false;
+    if (saved.version != format_version) return false;
+    library_state.saved = saved;
+
+    if (extra_state_func) |func| {
+        const extra = root.object.getPtr("extra") orelse return false;
+        if (func(extra, extra_state_rock) == 0) return false;
+    }
+    return true;
+}
+
+export fn glkunix_library_state_free(library_state_opaque: ?*anyopaque) callconv(.c) void {
+    const library_state: *LibraryState = @ptrCast(@alignCast(library_state_opaque orelse return));
+    library_state.arena.deinit();
+    allocator.destroy(library_state);
+}
+
+// ============== Restoring ==============
+
+/// Recreate the saved windows, streams and filerefs under their saved ids.
+/// Objects the interpreter opened at startup stay open; a saved file stream
+/// whose id names the same file opened again (the story file) is kept and
+/// moved to its saved position. Returns 0 if a saved id is taken by anything
+/// else, before any object is created.
+export fn glkunix_update_from_library_state(library_state_opaque: ?*anyopaque) callconv(.c) glui32 {
+    const library_state: *LibraryState = @ptrCast(@alignCast(library_state_opaque orelse return 0));
+    const saved = &library_state.saved;
+
+    for (saved.windows) |r| if (state.windows.get(r.id) != null) return 0;
+    for (saved.streams) |r| if (state.streams.get(r.id)) |live| if (!isReopenedFile(live, r)) return 0;
+    for (saved.filerefs) |r| if (state.filerefs.get(r.id) != null) return 0;
+
+    // Recreated in reverse so the lists keep their saved order
+    var i = saved.filerefs.len;
+    while (i > 0) : (i -= 1) restoreFileRef(saved.filerefs[i - 1]);
+    i = saved.windows.len;
+    while (i > 0) : (i -= 1) restoreWindow(saved.windows[i - 1]);
+    i = saved.streams.len;
+    while (i > 0) : (i -= 1) restoreStream(saved, saved.streams[i - 1]);
+
+    for (saved.windows) |r| {
+        const w = state.windows.get(r.id) orelse continue;
+        w.parent = savedWindow(saved, r.parent);
+        w.child1 = savedWindow(saved, r.child1);
+        w.child2 = savedWindow(saved, r.child2);
+        w.split_key = savedWindow(saved, r.split_key);
+        w.echo_stream = savedStream(saved, r.echo_stream);
+    }
+
+    if (savedWindow(saved, saved.root)) |root| state.root_window = root;
+    state.current_stream = savedStream(saved, saved.current_stream);
+    state.current_style = saved.current_style;
+    state.current_hyperlink = saved.current_hyperlink;
+    state.timer_interval = saved.timer_interval;
+
+    // Lay out for the current client, then put the grids and requests back
+    window.recalculateLayout();
+    for (saved.windows) |r| {
+        const w = state.windows.get(r.id) orelse continue;
+        restoreGrid(w, r);
+        restoreRequests(w, r);
+    }
+    protocol.queueWindowsUpdate();
+    return 1;
+}
+
+fn isReopenedFile(live: *StreamData, r: StreamRecord) bool {
+    const live_path = live.path orelse return false;
+    const path = r.path orelse return false;
+    return live.stream_type == .file and r.stream_type == .file and std.mem.eql(u8, live_path, path);
+}
+
+// Look up a window or stream by saved id, among the restored objects only
+fn savedWindow(saved: *const SavedState, id: ?glui32) ?*WindowData {
+    const wanted = id orelse return null;
+    for (saved.windows) |r| if (r.id == wanted) return state.windows.get(wanted);
+    return null;
+}
+
+fn savedStream(saved: *const SavedState, id: ?glui32) ?*StreamData {
+    const wanted = id orelse return null;
+    for (saved.streams) |r| if (r.id == wanted) return state.streams.get(wanted);
+    return null;
+}
+
+fn restoreFileRef(r: FileRefRecord) void {
+    const fref = state.fileref_pool.create() catch return;
+    const filename = allocator.dupe(u8, r.filename) catch {
+        state.fileref_pool.destroy(fref);
+        return;
+    };
+    if (!state.filerefs.insertAt(r.id, fref)) {
+        allocator.free(filename);
+        state.fileref_pool.destroy(fref);
+        return;
+    }
+    fref.* = FileRefData{
+        .id = r.id,
+        .rock = r.rock,
+        .filename = filename,
+        .usage = r.usage,
+        .textmode = r.textmode,
+    };
+
+    fref.next = state.fileref_list;
+    if (state.fileref_list) |list| list.prev = fref;
+    state.fileref_list = fref;
+}
+
+fn restoreWindow(r: WindowRecord) void {
+    const win = state.window_pool.create() catch return;
+    if (!state.windows.insertAt(r.id, win)) {
+        state.window_pool.destroy(win);
+        return;
+    }
+    win.* = WindowData{
+        .id = r.id,
+        .rock = r.rock,
+        .win_type = r.win_type,
+        .split_method = r.split_method,
+        .split_size = r.split_size,
+        .gfx_background = r.gfx_background,
+    };
+
+    win.next = state.window_list;
+    if (state.window_list) |list| list.prev = win;
+    state.window_list = win;
+}
+
+fn restoreStream(saved: *const SavedState, r: StreamRecord) void {
+    // The story file, opened again at startup: only its position is restored
+    if (state.streams.get(r.id)) |live| {
+        if (live.file) |fb| _ = fb.seekTo(r.pos);
+        return;
+    }
+
+    var fb: ?*state.FileBuffer = null;
+    var path: ?[]const u8 = null;
+    var win: ?*WindowData = null;
+    switch (r.stream_type) {
+        .window => win = savedWindow(saved, r.win) orelse return,
+        .file => {
+            const file_path = r.path orelse return;
+            const mode: std.fs.File.OpenMode = if (r.readable and r.writable) .read_write else if (r.writable) .write_only else .read_only;
+            const file = std.fs.cwd().openFile(file_path, .{ .mode = mode }) catch return;
+            file.seekTo(r.pos) catch {};
+            fb = stream.openFileBuffer(file) orelse return;
+            path = allocator.dupe(u8, file_path) catch null;
+        },
+        .memory => {},
+        .resource => return,
+    }
+
+    const str = state.stream_pool.create() catch return closeRestoredFile(fb, path);
+    if (!state.streams.insertAt(r.id, str)) {
+        state.stream_pool.destroy(str);
+        return closeRestoredFile(fb, path);
+    }
+    str.* = StreamData{
+        .id = r.id,
+        .rock = r.rock,
+        .stream_type = r.stream_type,
+        .readable = r.readable,
+        .writable = r.writable,
+        .readcount = r.readcount,
+        .writecount = r.writecount,
+        .win = win,
+        .file = fb,
+        .path = path,
+        .textmode = r.textmode,
+    };
+    if (win) |w| w.stream = str;
+
+    if (r.stream_type == .memory) {
+        str.buflen = r.buflen;
+        str.bufptr = @min(r.bufptr, r.buflen);
+        str.is_unicode = r.is_unicode;
+        if (r.buf) |key| {
+            if (restoreArray(key, r.buflen, r.is_unicode, &str.buf_rock)) |array| {
+                if (r.is_unicode) str.buf_uni = @ptrCast(@alignCast(array)) else str.buf = @ptrCast(array);
+            } else {
+                str.buflen = 0;
+                str.bufptr = 0;
+            }
+        }
+    }
+
+    str.next = state.stream_list;
+    if (state.stream_list) |list| list.prev = str;
+    state.stream_list = str;
+}
+
+fn closeRestoredFile(fb: ?*state.FileBuffer, path: ?[]const u8) void {
+    if (fb) |f| {
+        f.file.close();
+        allocator.destroy(f);
+    }
+    if (path) |p| allocator.free(p);
+}
+
+// Find a retained array again from its saved key, setting its rock
+fn restoreArray(key: i64, len: glui32, unicode: bool, rock: *DispatchRock) ?*anyopaque {
+    const restore = dispatch.restore_array_fn orelse return null;
+    const bufkey = std.math.cast(c_long, key) orelse return null;
+    var typecode = arrayTypecode(unicode);
+    var array: ?*anyopaque = null;
+    rock.* = restore(bufkey, len, &typecode, &array);
+    return array;
+}
+
+// Copy the saved cells into the grid sized by the layout (every line is
+// already marked dirty, so the client gets the whole grid)
+fn restoreGrid(w: *WindowData, r: WindowRecord) void {
+    const saved_cells = r.grid_cells orelse return;
+    const cells = w.grid_cells orelse return;
+    if (saved_cells.len != @as(usize, r.grid_width) * r.grid_height) return;
+
+    const cols = @min(w.grid_width, r.grid_width);
+    for (0..@min(w.grid_height, r.grid_height)) |y| {
+        for (0..cols) |x| {
+            cells[y * w.grid_width + x] = @bitCast(saved_cells[y * r.grid_width + x]);
+        }
+    }
+    w.cursor_x = @min(r.cursor_x, w.grid_width -| 1);
+    w.cursor_y = @min(r.cursor_y, w.grid_height -| 1);
+}
+
+fn restoreRequests(w: *WindowData, r: WindowRecord) void {
+    if (r.line_buffer) |key| {
+        if (restoreArray(key, r.line_buflen, r.line_request_uni, &w.line_buffer_rock)) |array| {
+            if (r.line_request_uni) w.line_buffer_uni = @ptrCast(@alignCast(array)) else w.line_buffer = @ptrCast(array);
+            w.line_request = r.line_request;
+            w.line_request_uni = r.line_request_uni;
+            w.line_buflen = r.line_buflen;
+            w.line_initlen = @min(r.line_initlen, r.line_buflen);
+            const count = @min(r.line_terminators.len, w.line_terminators.len);
+            @memcpy(w.line_terminators[0..count], r.line_terminators[0..count]);
+            w.line_terminators_count = @intCast(count);
+        }
+    }
+    w.char_request = r.char_request;
+    w.char_request_uni = r.char_request_uni;
+    state.syncTextRequest(w);
+    state.setMouseRequest(w, r.mouse_request);
+    state.setHyperlinkRequest(w, r.hyperlink_request);
+}
+
+// ============== Update Tags and Dispatch Rocks ==============
+
+// Update tags are the object ids, which survive an autosave unchanged
+
+export fn glkunix_window_get_updatetag(win_opaque: winid_t) callconv(.c) glui32 {
+    const win: ?*WindowData = @ptrCast(@alignCast(win_opaque));
+    return if (win) |w| w.id else 0;
+}
+
+export fn glkunix_stream_get_updatetag(str_opaque: strid_t) callconv(.c) glui32 {
+    const str: ?*StreamData = @ptrCast(@alignCast(str_opaque));
+    return if (str) |s| s.id else 0;
+}
+
+export fn glkunix_fileref_get_updatetag(fref_opaque: frefid_t) callconv(.c) glui32 {
+    const fref: ?*FileRefData = @ptrCast(@alignCast(fref_opaque));
+    return if (fref) |f| f.id else 0;
+}
+
+export fn glkunix_window_find_by_updatetag(tag: glui32) callconv(.c) winid_t {
+    return @ptrCast(state.windows.get(tag));
+}
+
+export fn glkunix_stream_find_by_updatetag(tag: glui32) callconv(.c) strid_t {
+    return @ptrCast(state.streams.get(tag));
+}
+
+export fn glkunix_fileref_find_by_updatetag(tag: glui32) callconv(.c) frefid_t {
+    return @ptrCast(state.filerefs.get(tag));
+}
+
+// Restored objects are not registered with the dispatch layer; the
+// interpreter registers them under their saved dispatch ids and sets the rocks
+
+export fn glkunix_window_set_dispatch_rock(win_opaque: winid_t, rock: DispatchRock) callconv(.c) void {
+    const win: ?*WindowData = @ptrCast(@alignCast(win_opaque));
+    if (win) |w| w.dispatch_rock = rock;
+}
+
+export fn glkunix_stream_set_dispatch_rock(str_opaque: strid_t, rock: DispatchRock) callconv(.c) void {
+    const str: ?*StreamData = @ptrCast(@alignCast(str_opaque));
+    if (str) |s| s.dispatch_rock = rock;
+}
+
+export fn glkunix_fileref_set_dispatch_rock(fref_opaque: frefid_t, rock: DispatchRock) callconv(.c) void {
+    const fref: ?*FileRefData = @ptrCast(@alignCast(fref_opaque));
+    if (fref) |f| f.dispatch_rock = rock;
+}
+
+// ============== Serialization Contexts ==============
+
+fn contextWriter(ctx: ?*anyopaque) *JsonWriter {
+    return @ptrCast(@alignCast(ctx.?));
+}
+
+export fn glkunix_serialize_uint32(ctx: ?*anyopaque, key: [*:0]const u8, val: glui32) callconv(.c) void {
+    const jw = contextWriter(ctx);
+    jw.field(std.mem.span(key));
+    jw.int(val);
+}
+
+export fn glkunix_serialize_object(ctx: ?*anyopaque, key: [*:0]const u8, func: SerializeFn, rock: ?*anyopaque) callconv(.c) void {
+    const jw = contextWriter(ctx);
+    jw.field(std.mem.span(key));
+    jw.beginObject();
+    func(ctx, rock);
+    jw.endObject();
+}
+
+export fn glkunix_serialize_object_list(ctx: ?*anyopaque, key: [*:0]const u8, func: SerializeFn, count: c_int, size: usize, array: ?*anyopaque) callconv(.c) void {
+    const jw = contextWriter(ctx);
+    jw.field(std.mem.span(key));
+    jw.beginArray();
+    const base: [*]u8 = @ptrCast(array orelse return jw.endArray());
+    for (0..@as(usize, @intCast(@max(count, 0)))) |i| {
+        jw.beginObject();
+        func(ctx, @ptrCast(base + i * size));
+        jw.endObject();
+    }
+    jw.endArray();
+}
+
+fn contextValue(ctx: ?*anyopaque) ?*Value {
+    return @ptrCast(@alignCast(ctx));
+}
+
+fn contextField(ctx: ?*anyopaque, key: [*:0]const u8) ?*Value {
+    const value = contextValue(ctx) orelse return null;
+    if (value.* != .object) return null;
+    return value.object.getPtr(std.mem.span(key));
+}
+
+export fn glkunix_unserialize_uint32(ctx: ?*anyopaque, key: [*:0]const u8, res: *glui32) callconv(.c) c_int {
+    const value = contextField(ctx, key) orelse return 0;
+    if (value.* != .integer) return 0;
+    res.* = std.math.cast(glui32, value.integer) orelse return 0;
+    return 1;
+}
+
+export fn glkunix_unserialize_struct(ctx: ?*anyopaque, key: [*:0]const u8, subctx: *?*anyopaque) callconv(.c) c_int {
+    const value = contextField(ctx, key) orelse return 0;
+    if (value.* != .object) return 0;
+    subctx.* = value;
+    return 1;
+}
+
+export fn glkunix_unserialize_list(ctx: ?*anyopaque, key: [*:0]const u8, subctx: *?*anyopaque, count: *c_int) callconv(.c) c_int {
+    const value = contextField(ctx, key) orelse return 0;
+    if (value.* != .array) return 0;
+    subctx.* = value;
+    count.* = std.math.cast(c_int, value.array.items.len) orelse return 0;
+    return 1;
+}
+
+export fn glkunix_unserialize_list_entry(ctx: ?*anyopaque, index: c_int, subctx: *?*anyopaque) callconv(.c) c_int {
+    const value = contextValue(ctx) orelse return 0;
+    if (value.* != .array or index < 0 or @as(usize, @intCast(index)) >= value.array.items.len) return 0;
+    subctx.* = &value.array.items[@intCast(index)];
+    return 1;
+}
+
+export fn glkunix_unserialize_object_list_entries(ctx: ?*anyopaque, func: UnserializeFn, count: c_int, size: usize, array: ?*anyopaque) callconv(.c) c_int {
+    const value = contextValue(ctx) orelse return 0;
+    if (value.* != .array or count < 0 or @as(usize, @intCast(count)) > value.array.items.len) return 0;
+    const base: [*]u8 = @ptrCast(array orelse return @intFromBool(count == 0));
+    for (value.array.items[0..@intCast(count)], 0..) |*entry, i| {
+        if (entry.* != .object) return 0;
+        if (func(entry, @ptrCast(base + i * size)) == 0) return 0;
+    }
+    return 1;
+}
+
+// ============== Tests ==============
+
+const testing = std.testing;
+
+fn serializeTestState(ctx: ?*anyopaque, rock: ?*anyopaque) callconv(.c) void {
+    const values: *const [3]glui32 = @ptrCast(@alignCast(rock.?));
+    glkunix_serialize_uint32(ctx, "protect", values[0]);
+    glkunix_serialize_object_list(ctx, "params", serializeTestParam, 2, @sizeOf(glui32), @ptrCast(@constCast(&values[1])));
+}
+
+fn serializeTestParam(ctx: ?*anyopaque, rock: ?*anyopaque) callconv(.c) void {
+    const value: *const glui32 = @ptrCast(@alignCast(rock.?));
+    glkunix_serialize_uint32(ctx, "param", value.*);
+}
+
+fn unserializeTestState(ctx: ?*anyopaque, rock: ?*anyopaque) callconv(.c) c_int {
+    const values: *[3]glui32 = @ptrCast(@alignCast(rock.?));
+    if (glkunix_unserialize_uint32(ctx, "protect", &values[0]) == 0) return 0;
+    var list: ?*anyopaque = null;
+    var count: c_int = 0;
+    if (glkunix_unserialize_list(ctx, "params", &list, &count) == 0 or count != 2) return 0;
+    return glkunix_unserialize_object_list_entries(list, unserializeTestParam, count, @sizeOf(glui32), &values[1]);
+}
+
+fn unserializeTestParam(ctx: ?*anyopaque, rock: ?*anyopaque) callconv(.c) c_int {
+    const value: *glui32 = @ptrCast(@alignCast(rock.?));
+    return glkunix_unserialize_uint32(ctx, "param", value);
+}
+
+test "library state round-trips grids, requests and the interpreter's extra state" {
+    const prev_streams = state.stream_list;
+    const prev_current = state.current_stream;
+    defer {
+        state.window_list = null;
+        state.root_window = null;
+        state.text_request_list = null;
+        state.stream_list = prev_streams;
+        state.current_stream = prev_current;
+    }
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    // A grid window with a char request, as if the game had drawn a status line
+    var cells = [_]state.GridCell{.{}} ** 6;
+    cells[0] = .{ .ch = 'H', .style = 1 };
+    cells[4] = .{ .ch = 'i' };
+    var grid = WindowData{ .id = 7, .rock = 42, .win_type = types.wintype.TextGrid, .char_request = true };
+    grid.grid_cells = &cells;
+    grid.grid_width = 3;
+    grid.grid_height = 2;
+    grid.cursor_x = 1;
+    grid.cursor_y = 1;
+    state.window_list = &grid;
+    state.root_window = &grid;
+
+    const file = try tmp.dir.createFile("autosave.json", .{ .read = true });
+    var fb = state.FileBuffer.init(file);
+    var dest = StreamData{ .id = 1, .rock = 0, .stream_type = .file, .readable = true, .writable = true, .file = &fb };
+    state.stream_list = &dest;
+    state.current_stream = null;
+    var extra = [3]glui32{ 5, 10, 20 };
+    try testing.expectEqual(@as(glui32, 1), glkunix_save_library_state(@ptrCast(&dest), @ptrCast(&dest), serializeTestState, &extra));
+    try testing.expect(fb.flush());
+    try testing.expect(fb.seekTo(0));
+
+    var restored_extra = [3]glui32{ 0, 0, 0 };
+    const loaded = glkunix_load_library_state(@ptrCast(&dest), unserializeTestState, &restored_extra) orelse return error.LoadFailed;
+    defer glkunix_library_state_free(loaded);
+    file.close();
+    try testing.expectEqualSlices(glui32, &extra, &restored_extra);
+
+    const saved = &@as(*LibraryState, @ptrCast(@alignCast(loaded))).saved;
+    try testing.expectEqual(@as(?glui32, 7), saved.root);
+    try testing.expectEqual(@as(usize, 1), saved.windows.len);
+    // The file being written is left out
+    try testing.expectEqual(@as(usize, 0), saved.streams.len);
+
+    const r = saved.windows[0];
+    try testing.expectEqual(@as(glui32, 42), r.rock);
+    try testing.expect(r.char_request);
+    try testing.expectEqual(@as(glui32, 1), r.cursor_y);
+
+    // Restoring into a grid of a different size keeps the overlapping cells
+    var new_cells = [_]state.GridCell{.{}} ** 4;
+    var new_grid = WindowData{ .id = 7, .rock = 0, .win_type = types.wintype.TextGrid };
+    new_grid.grid_cells = &new_cells;
+    new_grid.grid_width = 2;
+    new_grid.grid_height = 2;
+    restoreGrid(&new_grid, r);
+    try testing.expectEqual(state.GridCell{ .ch = 'H', .style = 1 }, new_cells[0]);
+    try testing.expectEqual(state.GridCell{ .ch = 'i' }, new_cells[3]);
+    try testing.expectEqual(@as(glui32, 1), new_grid.cursor_x);
+
+    state.window_list = &new_grid;
+    restoreRequests(&new_grid, r);
+    try testing.expect(new_grid.char_request);
+    try testing.expectEqual(&new_grid, state.text_request_list.?);
+}
+
+test "update_from_library_state refuses saved ids that are in use" {
+    // An id well clear of any other test's windows
+    const id: glui32 = 1000;
+    var live = WindowData{ .id = id, .rock = 0, .win_type = types.wintype.TextBuffer };
+    try testing.expect(state.windows.insertAt(id, &live));
+    defer state.windows.remove(id);
+
+    var library_state = LibraryState{ .arena = .init(allocator) };
+    defer library_state.arena.deinit();
+    const windows = [_]WindowRecord{.{ .id = id, .rock = 0, .win_type = types.wintype.TextBuffer }};
+    library_state.saved = .{ .version = format_version, .windows = &windows };
+    try testing.expectEqual(@as(glui32, 0), glkunix_update_from_library_state(&library_state));
+}
@@ -1,6 +1,9 @@
 // blorb.zig - Blorb resource file support
 
+const std = @import("std");
+const builtin = @import("builtin");
 const types = @import("types.zig");
+const state = @import("state.zig");
 
 const glui32 = types.glui32;
 const strid_t = types.strid_t;
@@ -17,28 +20,165 @@ pub const giblorb_image_info_t = extern struct {
     alttext: ?[*:0]u8,
 };
 
+// Chunk load result (matches gi_blorb.h)
+pub const giblorb_result_t = extern struct {
+    chunknum: glui32,
+    data: extern union {
+        ptr: ?*anyopaque, // giblorb_method_Memory
+        startpos: glui32, // giblorb_method_FilePos
+    },
+    length: glui32,
+    chunktype: glui32,
+};
+
+// Chunk load methods
+pub const giblorb_method_DontLoad: glui32 = 0;
+pub const giblorb_method_Memory: glui32 = 1;
+pub const giblorb_method_FilePos: glui32 = 2;
+
 // Blorb chunk type constants
 pub const giblorb_ID_PNG: glui32 = 0x504e4720; // 'PNG '
 pub const giblorb_ID_JPEG: glui32 = 0x4a504547; // 'JPEG'
+pub const giblorb_ID_Data: glui32 = 0x44617461; // 'Data'
+pub const giblorb_ID_Pict: glui32 = 0x50696374; // 'Pict'
+pub const giblorb_ID_TEXT: glui32 = 0x54455854; // 'TEXT'
 
 pub var blorb_map: ?*giblorb_map_t = null;
+// The stream the map was built from (resource streams read through it)
+pub var blorb_file: strid_t = null;
 
 // These are provided by gi_blorb.c
 pub extern fn giblorb_create_map(file: strid_t, newmap: *?*giblorb_map_t) callconv(.c) giblorb_err_t;
 pub extern fn giblorb_destroy_map(map: ?*giblorb_map_t) callconv(.c) giblorb_err_t;
+pub extern fn giblorb_load_resource(map: ?*giblorb_map_t, method: glui32, res: *giblorb_result_t, usage: glui32, resnum: glui32) callconv(.c) giblorb_err_t;
+pub extern fn giblorb_count_resources(map: ?*giblorb_map_t, usage: glui32, num: *glui32, min: *glui32, max: *glui32) callconv(.c) giblorb_err_t;
 pub extern fn giblorb_load_image_info(map: ?*giblorb_map_t, resnum: glui32, res: *giblorb_image_info_t) callconv(.c) giblorb_err_t;
+pub extern fn giblorb_set_map_data(map: ?*giblorb_map_t, data: [*]const u8, datalen: glui32) callconv(.c) giblorb_err_t;
 
 export fn giblorb_set_resource_map(file: strid_t) callconv(.c) giblorb_err_t {
     if (blorb_map != null) {
         _ = giblorb_destroy_map(blorb_map);
         blorb_map = null;
+        blorb_file = null;
     }
+    freeImageTable();
+    releaseBlorbData();
 
     if (file == null) return 0; // giblorb_err_None
 
-    return giblorb_create_map(file, &blorb_map);
+    const err = giblorb_create_map(file, &blorb_map);
+    if (err == 0) {
+        blorb_file = file;
+        if (loadBlorbData(file)) |data| {
+            _ = giblorb_set_map_data(blorb_map, data.ptr, @intCast(data.len));
+        }
+        buildImageTable();
+    }
+    return err;
 }
 
 export fn giblorb_get_resource_map() callconv(.c) ?*giblorb_map_t {
     return blorb_map;
 }
+
+// ============== Blorb Data ==============
+//
+// When the Blorb file is already addressable as one read-only region, chunk
+// loads (giblorb_method_Memory) and resource streams point into it rather
+// than copying each chunk into its own allocation. A memory stream's buffer
+// is used as it is, and a file is mapped where the OS supports it. WASI has
+// no mmap, and reading the whole file in would keep a copy of every image
+// and sound resident, so there chunks are still read one at a time.
+
+pub var blorb_data: ?[]const u8 = null;
+var blorb_data_mapped = false;
+
+fn loadBlorbData(file: strid_t) ?[]const u8 {
+    const stream: *state.StreamData = @ptrCast(@alignCast(file orelse return null));
+    if (stream.stream_type == .memory and !stream.is_unicode) {
+        const buf = stream.buf orelse return null;
+        blorb_data = buf[0..stream.buflen];
+        return blorb_data;
+    }
+    const fb = stream.file orelse return null;
+    if (!fb.flush()) return null;
+    const size = fb.endPosition();
+    if (size == 0 or size > std.math.maxInt(glui32)) return null;
+    const len: usize = @intCast(size);
+
+    if (builtin.os.tag == .wasi) return null;
+    const mapped = std.posix.mmap(null, len, std.posix.PROT.READ, .{ .TYPE = .PRIVATE }, fb.file.handle, 0) catch return null;
+    blorb_data = mapped;
+    blorb_data_mapped = true;
+    return blorb_data;
+}
+
+fn releaseBlorbData() void {
+    if (blorb_data_mapped) {
+        if (builtin.os.tag != .wasi) std.posix.munmap(@alignCast(blorb_data.?));
+    }
+    blorb_data = null;
+    blorb_data_mapped = false;
+}
+
+// ============== Image Info ==============
+//
+// Image sizes are read once, when the map is set, into a table indexed by
+// image number, so glk_image_get_info and glk_image_draw do no lookups or
+// file I/O. Maps with very sparse image numbers fall back to gi_blorb.
+
+pub const ImageInfo = struct {
+    width: glui32,
+    height: glui32,
+    chunktype: glui32, // giblorb_ID_PNG or giblorb_ID_JPEG
+    startpos: glui32, // Chunk data offset in the Blorb file
+};
+
+const max_image_table = 65536;
+
+var image_table: []?ImageInfo = &.{};
+var image_base: glui32 = 0; // Image number of image_table[0]
+var image_table_complete = false; // Every Pict resource is in the table
+
+/// Size and location of a Blorb image, or null if there is no such image.
+pub fn imageInfo(image: glui32) ?ImageInfo {
+    if (image >= image_base and image - image_base < image_table.len) {
+        return image_table[image - image_base];
+    }
+    if (image_table_complete) return null;
+    return loadImageInfo(blorb_map orelse return null, image);
+}
+
+fn loadImageInfo(map: *giblorb_map_t, image: glui32) ?ImageInfo {
+    var info: giblorb_image_info_t = undefined;
+    if (giblorb_load_image_info(map, image, &info) != 0) return null;
+    var res: giblorb_result_t = undefined;
+    if (giblorb_load_resource(map, giblorb_method_FilePos, &res, giblorb_ID_Pict, image) != 0) return null;
+    return .{ .width = info.width, .height = info.height, .chunktype = info.chunktype, .startpos = res.data.startpos };
+}
+
+fn buildImageTable() void {
+    const map = blorb_map orelse return;
+    var count: glui32 = 0;
+    var min: glui32 = 0;
+    var max: glui32 = 0;
+    if (giblorb_count_resources(map, giblorb_ID_Pict, &count, &min, &max) != 0) return;
+    if (count == 0) {
+        image_table_complete = true;
+        return;
+    }
+    if (max - min >= max_image_table) return;
+
+    const table = state.allocator.alloc(?ImageInfo, max - min + 1) catch return;
+    for (table, min..) |*entry, image| entry.* = loadImageInfo(map, @intCast(image));
+    image_table = table;
+    image_base = min;
+    image_table_complete = true;
+}
+
+fn freeImageTable() void {
+    if (image_table.len > 0) state.allocator.free(image_table);
+    image_table = &.{};
+    image_base = 0;
+    image_table_complete = false;
+}
@@ -24,6 +24,10 @@ pub var object_register_fn: ?*const fn (?*anyopaque, glui32) callconv(.c) gidisp
 pub var object_unregister_fn: ?*const fn (?*anyopaque, glui32, gidispatch_rock_t) callconv(.c) void = null;
 pub var retained_register_fn: ?*const fn (?*anyopaque, glui32, [*:0]u8) callconv(.c) gidispatch_rock_t = null;
 pub var retained_unregister_fn: ?*const fn (?*anyopaque, glui32, [*:0]u8, gidispatch_rock_t) callconv(.c) void = null;
+// Autorestore callbacks: map retained arrays to VM addresses and back, so
+// line buffers and memory streams survive an autosave (see autosave.zig)
+pub var locate_array_fn: ?*const fn (?*anyopaque, glui32, [*:0]u8, gidispatch_rock_t, *c_int) callconv(.c) c_long = null;
+pub var restore_array_fn: ?*const fn (c_long, glui32, [*:0]u8, *?*anyopaque) callconv(.c) gidispatch_rock_t = null;
 
 export fn gidispatch_set_object_registry(
     regi: ?*const fn (?*anyopaque, glui32) callconv(.c) gidispatch_rock_t,
@@ -84,6 +88,6 @@ export fn gidispatch_set_autorestore_registry(
     locatearr: ?*const fn (?*anyopaque, glui32, [*:0]u8, gidispatch_rock_t, *c_int) callconv(.c) c_long,
     restorearr: ?*const fn (c_long, glui32, [*:0]u8, *?*anyopaque) callconv(.c) gidispatch_rock_t,
 ) callconv(.c) void {
-    _ = locatearr;
-    _ = restorearr;
+    locate_array_fn = locatearr;
+    restore_array_fn = restorearr;
 }
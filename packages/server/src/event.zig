@@ -5,6 +5,9 @@ const types = @import("types.zig");
 const state = @import("state.zig");
 const protocol = @import("protocol.zig");
 const dispatch = @import("dispatch.zig");
+const stream = @import("stream.zig");
+const graphics = @import("graphics.zig");
+const window = @import("window.zig");
 
 const glui32 = types.glui32;
 const winid_t = types.winid_t;
@@ -14,60 +17,69 @@ const keycode = types.keycode;
 const WindowData = state.WindowData;
 const allocator = state.allocator;
 
+// Named keys in char input values (per GlkOte spec)
+const named_keys = std.StaticStringMap(glui32).initComptime(.{
+    .{ "return", keycode.Return },
+    .{ "left", keycode.Left },
+    .{ "right", keycode.Right },
+    .{ "up", keycode.Up },
+    .{ "down", keycode.Down },
+    .{ "delete", keycode.Delete },
+    .{ "escape", keycode.Escape },
+    .{ "tab", keycode.Tab },
+    .{ "pageup", keycode.PageUp },
+    .{ "pagedown", keycode.PageDown },
+    .{ "home", keycode.Home },
+    .{ "end", keycode.End },
+    .{ "func1", keycode.Func1 },
+    .{ "func2", keycode.Func2 },
+    .{ "func3", keycode.Func3 },
+    .{ "func4", keycode.Func4 },
+    .{ "func5", keycode.Func5 },
+    .{ "func6", keycode.Func6 },
+    .{ "func7", keycode.Func7 },
+    .{ "func8", keycode.Func8 },
+    .{ "func9", keycode.Func9 },
+    .{ "func10", keycode.Func10 },
+    .{ "func11", keycode.Func11 },
+    .{ "func12", keycode.Func12 },
+});
+
 // Convert char input value to Glk keycode.
-// For single characters (len=1), returns the character value directly.
+// A single character (one UTF-8 sequence) is returned as its code point;
+// non-unicode requests only take Latin-1, so anything above 0xFF is Unknown.
 // For named keys ("return", "escape", etc.), returns the Glk keycode constant.
-fn charValueToKeycode(value: []const u8) glui32 {
+fn charValueToKeycode(value: []const u8, uni: bool) glui32 {
     if (value.len == 0) return keycode.Return;
     if (value.len == 1) return value[0];
-
-    if (std.mem.eql(u8, value, "return")) return keycode.Return;
-    if (std.mem.eql(u8, value, "left")) return keycode.Left;
-    if (std.mem.eql(u8, value, "right")) return keycode.Right;
-    if (std.mem.eql(u8, value, "up")) return keycode.Up;
-    if (std.mem.eql(u8, value, "down")) return keycode.Down;
-    if (std.mem.eql(u8, value, "delete")) return keycode.Delete;
-    if (std.mem.eql(u8, value, "escape")) return keycode.Escape;
-    if (std.mem.eql(u8, value, "tab")) return keycode.Tab;
-    if (std.mem.eql(u8, value, "pageup")) return keycode.PageUp;
-    if (std.mem.eql(u8, value, "pagedown")) return keycode.PageDown;
-    if (std.mem.eql(u8, value, "home")) return keycode.Home;
-    if (std.mem.eql(u8, value, "end")) return keycode.End;
-    if (std.mem.eql(u8, value, "func1")) return keycode.Func1;
-    if (std.mem.eql(u8, value, "func2")) return keycode.Func2;
-    if (std.mem.eql(u8, value, "func3")) return keycode.Func3;
-    if (std.mem.eql(u8, value, "func4")) return keycode.Func4;
-    if (std.mem.eql(u8, value, "func5")) return keycode.Func5;
-    if (std.mem.eql(u8, value, "func6")) return keycode.Func6;
-    if (std.mem.eql(u8, value, "func7")) return keycode.Func7;
-    if (std.mem.eql(u8, value, "func8")) return keycode.Func8;
-    if (std.mem.eql(u8, value, "func9")) return keycode.Func9;
-    if (std.mem.eql(u8, value, "func10")) return keycode.Func10;
-    if (std.mem.eql(u8, value, "func11")) return keycode.Func11;
-    if (std.mem.eql(u8, value, "func12")) return keycode.Func12;
-
-    return keycode.Unknown;
+    if (std.unicode.utf8ByteSequenceLength(value[0])) |n| {
+        if (n == value.len) {
+            if (std.unicode.utf8Decode(value)) |cp| {
+                return if (uni or cp <= 0xFF) cp else keycode.Unknown;
+            } else |_| {}
+        }
+    } else |_| {}
+    return named_keys.get(value) orelse keycode.Unknown;
 }
 
-// Convert terminator string to keycode (per GlkOte spec)
-fn terminatorToKeycode(terminator: ?[]const u8) glui32 {
+// Convert a line input terminator to its keycode (0 for none)
+fn terminatorKeycode(terminator: ?protocol.Terminator) glui32 {
     const term = terminator orelse return 0;
-
-    if (std.mem.eql(u8, term, "escape")) return keycode.Escape;
-    if (std.mem.eql(u8, term, "func1")) return keycode.Func1;
-    if (std.mem.eql(u8, term, "func2")) return keycode.Func2;
-    if (std.mem.eql(u8, term, "func3")) return keycode.Func3;
-    if (std.mem.eql(u8, term, "func4")) return keycode.Func4;
-    if (std.mem.eql(u8, term, "func5")) return keycode.Func5;
-    if (std.mem.eql(u8, term, "func6")) return keycode.Func6;
-    if (std.mem.eql(u8, term, "func7")) return keycode.Func7;
-    if (std.mem.eql(u8, term, "func8")) return keycode.Func8;
-    if (std.mem.eql(u8, term, "func9")) return keycode.Func9;
-    if (std.mem.eql(u8, term, "func10")) return keycode.Func10;
-    if (std.mem.eql(u8, term, "func11")) return keycode.Func11;
-    if (std.mem.eql(u8, term, "func12")) return keycode.Func12;
-
-    return 0;
+    return switch (term) {
+        .escape => keycode.Escape,
+        .func1 => keycode.Func1,
+        .func2 => keycode.Func2,
+        .func3 => keycode.Func3,
+        .func4 => keycode.Func4,
+        .func5 => keycode.Func5,
+        .func6 => keycode.Func6,
+        .func7 => keycode.Func7,
+        .func8 => keycode.Func8,
+        .func9 => keycode.Func9,
+        .func10 => keycode.Func10,
+        .func11 => keycode.Func11,
+        .func12 => keycode.Func12,
+    };
 }
 
 // Helper to extract initial text from line buffer
@@ -88,35 +100,30 @@ fn getInitialText(w: *WindowData) ?[]const u8 {
 export fn glk_select(event: ?*event_t) callconv(.c) void {
     if (event == null) return;
 
-    // Flush text buffer and grid windows before waiting for input
-    protocol.flushTextBuffer();
+    // Flush grid and graphics windows and file streams before waiting for input
     protocol.flushGridWindows();
+    graphics.flushGraphicsWindows();
+    stream.flushFileStreams();
 
     event.?.type = evtype.None;
     event.?.win = null;
     event.?.val1 = 0;
     event.?.val2 = 0;
 
-    // Find window with text input request
-    var win = state.window_list;
-    while (win) |w| : (win = w.next) {
-        if (w.char_request or w.line_request or w.char_request_uni or w.line_request_uni) {
-            break;
-        }
-    }
+    // Window with a text input request (the most recent one)
+    const win = state.text_request_list;
 
     // Check if any window has a mouse or hyperlink request
-    var has_mouse_request = false;
-    var has_hyperlink_request = false;
-    var aux_win = state.window_list;
-    while (aux_win) |aw| : (aux_win = aw.next) {
-        if (aw.mouse_request) has_mouse_request = true;
-        if (aw.hyperlink_request) has_hyperlink_request = true;
-    }
+    const has_mouse_request = state.mouse_request_count > 0;
+    const has_hyperlink_request = state.hyperlink_request_count > 0;
 
     // Check if we have any input source (window input, mouse input, hyperlink input, or timer)
     const has_timer = state.timer_interval != null;
-    if (win == null and !has_timer and !has_mouse_request and !has_hyperlink_request) return;
+    if (win == null and !has_timer and !has_mouse_request and !has_hyperlink_request) {
+        // Nothing to wait for, but don't hold back this turn's output
+        protocol.sendUpdate();
+        return;
+    }
 
     // Queue input request if we have a window with input request
     if (win) |w| {
@@ -143,23 +150,17 @@ export fn glk_select(event: ?*event_t) callconv(.c) void {
     protocol.sendUpdate();
 
     // Read JSON input from stdin
-    var json_buf: [4096]u8 = undefined;
-    const json_line = protocol.readLineFromStdin(&json_buf) orelse {
+    const json_line = protocol.readLineFromStdin() orelse {
         glk_exit();
     };
 
-    // Parse the input event
+    // Parse the input event (its strings are slices of json_line)
     const input_event = protocol.parseInputEvent(json_line) orelse {
         return;
     };
-    defer {
-        allocator.free(input_event.type);
-        if (input_event.value) |v| allocator.free(v);
-        if (input_event.terminator) |t| allocator.free(t);
-    }
 
     // Handle timer events
-    if (std.mem.eql(u8, input_event.type, "timer")) {
+    if (input_event.type == .timer) {
         event.?.type = evtype.Timer;
         event.?.win = null;
         event.?.val1 = 0;
@@ -168,12 +169,12 @@ export fn glk_select(event: ?*event_t) callconv(.c) void {
     }
 
     // Handle arrange events (window resize)
-    if (std.mem.eql(u8, input_event.type, "arrange")) {
+    if (input_event.type == .arrange) {
         // Update stored metrics from the event
-        if (input_event.metrics) |m| {
-            if (m.width) |w| state.client_metrics.width = w;
-            if (m.height) |h| state.client_metrics.height = h;
-        }
+        if (input_event.metrics) |m| protocol.storeMetrics(m);
+        // Re-layout (resizing grid storage) and tell the client the new sizes
+        window.recalculateLayout();
+        protocol.queueWindowsUpdate();
         event.?.type = evtype.Arrange;
         event.?.win = @ptrCast(state.root_window);
         event.?.val1 = 0;
@@ -182,54 +183,43 @@ export fn glk_select(event: ?*event_t) callconv(.c) void {
     }
 
     // Handle mouse events
-    if (std.mem.eql(u8, input_event.type, "mouse")) {
+    if (input_event.type == .mouse) {
         // Find the window with matching ID that has a mouse request
         const target_win_id = input_event.window orelse return;
-        var target_win = state.window_list;
-        while (target_win) |tw| : (target_win = tw.next) {
-            if (tw.id == target_win_id and tw.mouse_request) {
-                event.?.type = evtype.MouseInput;
-                event.?.win = @ptrCast(tw);
-                event.?.val1 = @bitCast(input_event.x orelse 0);
-                event.?.val2 = @bitCast(input_event.y orelse 0);
-                tw.mouse_request = false; // Mouse request is one-shot
-                return;
-            }
-        }
+        const tw = state.windows.get(target_win_id) orelse return;
+        if (!tw.mouse_request) return;
+        event.?.type = evtype.MouseInput;
+        event.?.win = @ptrCast(tw);
+        event.?.val1 = @bitCast(input_event.x orelse 0);
+        event.?.val2 = @bitCast(input_event.y orelse 0);
+        state.setMouseRequest(tw, false); // Mouse request is one-shot
         return;
     }
 
     // Handle hyperlink events
-    if (std.mem.eql(u8, input_event.type, "hyperlink")) {
+    if (input_event.type == .hyperlink) {
         // Find the window with matching ID that has a hyperlink request
         const target_win_id = input_event.window orelse return;
-        var target_win = state.window_list;
-        while (target_win) |tw| : (target_win = tw.next) {
-            if (tw.id == target_win_id and tw.hyperlink_request) {
-                event.?.type = evtype.Hyperlink;
-                event.?.win = @ptrCast(tw);
-                event.?.val1 = input_event.linkval orelse 0;
-                event.?.val2 = 0;
-                tw.hyperlink_request = false; // Hyperlink request is one-shot
-                return;
-            }
-        }
+        const tw = state.windows.get(target_win_id) orelse return;
+        if (!tw.hyperlink_request) return;
+        event.?.type = evtype.Hyperlink;
+        event.?.win = @ptrCast(tw);
+        event.?.val1 = input_event.linkval orelse 0;
+        event.?.val2 = 0;
+        state.setHyperlinkRequest(tw, false); // Hyperlink request is one-shot
         return;
     }
 
     // Handle redraw events (graphics window needs redrawing)
-    if (std.mem.eql(u8, input_event.type, "redraw")) {
+    if (input_event.type == .redraw) {
         event.?.type = evtype.Redraw;
         // If window ID provided, find and return that window; otherwise use root
         if (input_event.window) |win_id| {
-            var target_win = state.window_list;
-            while (target_win) |tw| : (target_win = tw.next) {
-                if (tw.id == win_id) {
-                    event.?.win = @ptrCast(tw);
-                    event.?.val1 = 0;
-                    event.?.val2 = 0;
-                    return;
-                }
+            if (state.windows.get(win_id)) |tw| {
+                event.?.win = @ptrCast(tw);
+                event.?.val1 = 0;
+                event.?.val2 = 0;
+                return;
             }
         }
         event.?.win = @ptrCast(state.root_window);
@@ -241,7 +231,7 @@ export fn glk_select(event: ?*event_t) callconv(.c) void {
     // Handle refresh events (full state refresh request)
     // Per GlkOte spec, this should resend all window and content state
     // For now, we treat it like an arrange event to trigger state refresh
-    if (std.mem.eql(u8, input_event.type, "refresh")) {
+    if (input_event.type == .refresh) {
         event.?.type = evtype.Arrange;
         event.?.win = @ptrCast(state.root_window);
         event.?.val1 = 0;
@@ -252,7 +242,7 @@ export fn glk_select(event: ?*event_t) callconv(.c) void {
     // Handle debug input events (display sends debug commands)
     // Per GlkOte spec, these are for debugging purposes
     // Currently we acknowledge but don't process them
-    if (std.mem.eql(u8, input_event.type, "debuginput")) {
+    if (input_event.type == .debuginput) {
         event.?.type = evtype.None;
         event.?.win = null;
         event.?.val1 = 0;
@@ -263,7 +253,7 @@ export fn glk_select(event: ?*event_t) callconv(.c) void {
     // Handle external events (custom extension events)
     // Per GlkOte spec, these are for custom implementations
     // Currently we acknowledge but don't process them
-    if (std.mem.eql(u8, input_event.type, "external")) {
+    if (input_event.type == .external) {
         event.?.type = evtype.None;
         event.?.win = null;
         event.?.val1 = 0;
@@ -293,7 +283,7 @@ export fn glk_select(event: ?*event_t) callconv(.c) void {
             event.?.type = evtype.LineInput;
             event.?.win = @ptrCast(w);
             event.?.val1 = copy_len;
-            event.?.val2 = terminatorToKeycode(input_event.terminator);
+            event.?.val2 = terminatorKeycode(input_event.terminator);
 
             // Unregister the buffer so Glulxe copies data back to VM memory
             if (dispatch.retained_unregister_fn) |unregister_fn| {
@@ -320,7 +310,7 @@ export fn glk_select(event: ?*event_t) callconv(.c) void {
             event.?.type = evtype.LineInput;
             event.?.win = @ptrCast(w);
             event.?.val1 = copy_len;
-            event.?.val2 = terminatorToKeycode(input_event.terminator);
+            event.?.val2 = terminatorKeycode(input_event.terminator);
 
             if (dispatch.retained_unregister_fn) |unregister_fn| {
                 // Typecode for glui32 array with passout: "&+#!Iu"
@@ -334,14 +324,15 @@ export fn glk_select(event: ?*event_t) callconv(.c) void {
     } else if (w.char_request) {
         event.?.type = evtype.CharInput;
         event.?.win = @ptrCast(w);
-        event.?.val1 = charValueToKeycode(input_value);
+        event.?.val1 = charValueToKeycode(input_value, false);
         w.char_request = false;
     } else if (w.char_request_uni) {
         event.?.type = evtype.CharInput;
         event.?.win = @ptrCast(w);
-        event.?.val1 = charValueToKeycode(input_value);
+        event.?.val1 = charValueToKeycode(input_value, true);
         w.char_request_uni = false;
     }
+    state.syncTextRequest(w);
 }
 
 export fn glk_select_poll(event: ?*event_t) callconv(.c) void {
@@ -366,6 +357,7 @@ export fn glk_request_line_event(win_opaque: winid_t, buf: ?[*]u8, maxlen: glui3
     if (win == null) return;
 
     win.?.line_request = true;
+    state.syncTextRequest(win.?);
     win.?.line_buffer = buf;
     win.?.line_buflen = maxlen;
     win.?.line_initlen = initlen;
@@ -383,6 +375,7 @@ export fn glk_request_char_event(win_opaque: winid_t) callconv(.c) void {
     const win: ?*WindowData = @ptrCast(@alignCast(win_opaque));
     if (win == null) return;
     win.?.char_request = true;
+    state.syncTextRequest(win.?);
 }
 
 export fn glk_request_mouse_event(win_opaque: winid_t) callconv(.c) void {
@@ -390,7 +383,7 @@ export fn glk_request_mouse_event(win_opaque: winid_t) callconv(.c) void {
     if (win == null) return;
     // Mouse events are only meaningful for grid and graphics windows
     if (win.?.win_type == types.wintype.TextGrid or win.?.win_type == types.wintype.Graphics) {
-        win.?.mouse_request = true;
+        state.setMouseRequest(win.?, true);
     }
 }
 
@@ -429,6 +422,7 @@ export fn glk_cancel_line_event(win_opaque: winid_t, event: ?*event_t) callconv(
 
     w.line_request = false;
     w.line_request_uni = false;
+    state.syncTextRequest(w);
     w.line_buffer = null;
     w.line_buffer_uni = null;
     w.line_partial_len = 0;
@@ -439,24 +433,27 @@ export fn glk_cancel_char_event(win_opaque: winid_t) callconv(.c) void {
     const win: ?*WindowData = @ptrCast(@alignCast(win_opaque));
     if (win == null) return;
     win.?.char_request = false;
+    state.syncTextRequest(win.?);
 }
 
 export fn glk_cancel_mouse_event(win_opaque: winid_t) callconv(.c) void {
     const win: ?*WindowData = @ptrCast(@alignCast(win_opaque));
     if (win == null) return;
-    win.?.mouse_request = false;
+    state.setMouseRequest(win.?, false);
 }
 
 export fn glk_request_char_event_uni(win_opaque: winid_t) callconv(.c) void {
     const win: ?*WindowData = @ptrCast(@alignCast(win_opaque));
     if (win == null) return;
     win.?.char_request_uni = true;
+    state.syncTextRequest(win.?);
 }
 
 export fn glk_request_line_event_uni(win_opaque: winid_t, buf: ?[*]glui32, maxlen: glui32, initlen: glui32) callconv(.c) void {
     const win: ?*WindowData = @ptrCast(@alignCast(win_opaque));
     if (win == null) return;
     win.?.line_request_uni = true;
+    state.syncTextRequest(win.?);
     win.?.line_buffer_uni = buf;
     win.?.line_buflen = maxlen;
     win.?.line_initlen = initlen;
@@ -474,79 +471,81 @@ export fn glk_request_line_event_uni(win_opaque: winid_t, buf: ?[*]glui32, maxle
 
 const testing = std.testing;
 
-test "terminatorToKeycode maps all 13 terminator strings" {
-    try testing.expectEqual(keycode.Escape, terminatorToKeycode("escape"));
-    try testing.expectEqual(keycode.Func1, terminatorToKeycode("func1"));
-    try testing.expectEqual(keycode.Func2, terminatorToKeycode("func2"));
-    try testing.expectEqual(keycode.Func3, terminatorToKeycode("func3"));
-    try testing.expectEqual(keycode.Func4, terminatorToKeycode("func4"));
-    try testing.expectEqual(keycode.Func5, terminatorToKeycode("func5"));
-    try testing.expectEqual(keycode.Func6, terminatorToKeycode("func6"));
-    try testing.expectEqual(keycode.Func7, terminatorToKeycode("func7"));
-    try testing.expectEqual(keycode.Func8, terminatorToKeycode("func8"));
-    try testing.expectEqual(keycode.Func9, terminatorToKeycode("func9"));
-    try testing.expectEqual(keycode.Func10, terminatorToKeycode("func10"));
-    try testing.expectEqual(keycode.Func11, terminatorToKeycode("func11"));
-    try testing.expectEqual(keycode.Func12, terminatorToKeycode("func12"));
+test "terminatorKeycode maps all 13 terminators" {
+    try testing.expectEqual(keycode.Escape, terminatorKeycode(.escape));
+    try testing.expectEqual(keycode.Func1, terminatorKeycode(.func1));
+    try testing.expectEqual(keycode.Func2, terminatorKeycode(.func2));
+    try testing.expectEqual(keycode.Func3, terminatorKeycode(.func3));
+    try testing.expectEqual(keycode.Func4, terminatorKeycode(.func4));
+    try testing.expectEqual(keycode.Func5, terminatorKeycode(.func5));
+    try testing.expectEqual(keycode.Func6, terminatorKeycode(.func6));
+    try testing.expectEqual(keycode.Func7, terminatorKeycode(.func7));
+    try testing.expectEqual(keycode.Func8, terminatorKeycode(.func8));
+    try testing.expectEqual(keycode.Func9, terminatorKeycode(.func9));
+    try testing.expectEqual(keycode.Func10, terminatorKeycode(.func10));
+    try testing.expectEqual(keycode.Func11, terminatorKeycode(.func11));
+    try testing.expectEqual(keycode.Func12, terminatorKeycode(.func12));
 }
 
-test "terminatorToKeycode returns 0 for null and unknown" {
-    try testing.expectEqual(@as(glui32, 0), terminatorToKeycode(null));
-    try testing.expectEqual(@as(glui32, 0), terminatorToKeycode("unknown"));
-    try testing.expectEqual(@as(glui32, 0), terminatorToKeycode(""));
+test "terminatorKeycode returns 0 for no terminator" {
+    try testing.expectEqual(@as(glui32, 0), terminatorKeycode(null));
 }
 
-test "keycodeToTerminator and terminatorToKeycode roundtrip" {
-    const keycodes = [_]glui32{
-        keycode.Escape, keycode.Func1,  keycode.Func2,  keycode.Func3,
-        keycode.Func4,  keycode.Func5,  keycode.Func6,  keycode.Func7,
-        keycode.Func8,  keycode.Func9,  keycode.Func10, keycode.Func11,
-        keycode.Func12,
-    };
-    for (keycodes) |kc| {
-        const term_str = protocol.keycodeToTerminator(kc).?;
-        try testing.expectEqual(kc, terminatorToKeycode(term_str));
+test "keycodeToTerminator and terminatorKeycode roundtrip" {
+    for (std.enums.values(protocol.Terminator)) |term| {
+        try testing.expectEqualStrings(@tagName(term), protocol.keycodeToTerminator(terminatorKeycode(term)).?);
     }
 }
 
 test "charValueToKeycode converts single characters" {
-    try testing.expectEqual(@as(glui32, 'a'), charValueToKeycode("a"));
-    try testing.expectEqual(@as(glui32, 'Z'), charValueToKeycode("Z"));
-    try testing.expectEqual(@as(glui32, ' '), charValueToKeycode(" "));
-    try testing.expectEqual(@as(glui32, '0'), charValueToKeycode("0"));
+    try testing.expectEqual(@as(glui32, 'a'), charValueToKeycode("a", true));
+    try testing.expectEqual(@as(glui32, 'Z'), charValueToKeycode("Z", true));
+    try testing.expectEqual(@as(glui32, ' '), charValueToKeycode(" ", true));
+    try testing.expectEqual(@as(glui32, '0'), charValueToKeycode("0", true));
+    try testing.expectEqual(@as(glui32, 0xE9), charValueToKeycode("\u{e9}", true));
+    try testing.expectEqual(@as(glui32, 0x1F600), charValueToKeycode("\u{1F600}", true));
+}
+
+test "charValueToKeycode limits non-unicode requests to Latin-1" {
+    try testing.expectEqual(@as(glui32, 0xE9), charValueToKeycode("\u{e9}", false));
+    try testing.expectEqual(keycode.Unknown, charValueToKeycode("\u{1F600}", false));
+    try testing.expectEqual(keycode.Unknown, charValueToKeycode("\u{20AC}", false));
+    try testing.expectEqual(keycode.Left, charValueToKeycode("left", false));
 }
 
 test "charValueToKeycode converts named special keys" {
-    try testing.expectEqual(keycode.Return, charValueToKeycode("return"));
-    try testing.expectEqual(keycode.Escape, charValueToKeycode("escape"));
-    try testing.expectEqual(keycode.Left, charValueToKeycode("left"));
-    try testing.expectEqual(keycode.Right, charValueToKeycode("right"));
-    try testing.expectEqual(keycode.Up, charValueToKeycode("up"));
-    try testing.expectEqual(keycode.Down, charValueToKeycode("down"));
-    try testing.expectEqual(keycode.Delete, charValueToKeycode("delete"));
-    try testing.expectEqual(keycode.Tab, charValueToKeycode("tab"));
-    try testing.expectEqual(keycode.PageUp, charValueToKeycode("pageup"));
-    try testing.expectEqual(keycode.PageDown, charValueToKeycode("pagedown"));
-    try testing.expectEqual(keycode.Home, charValueToKeycode("home"));
-    try testing.expectEqual(keycode.End, charValueToKeycode("end"));
+    try testing.expectEqual(keycode.Return, charValueToKeycode("return", true));
+    try testing.expectEqual(keycode.Escape, charValueToKeycode("escape", true));
+    try testing.expectEqual(keycode.Left, charValueToKeycode("left", true));
+    try testing.expectEqual(keycode.Right, charValueToKeycode("right", true));
+    try testing.expectEqual(keycode.Up, charValueToKeycode("up", true));
+    try testing.expectEqual(keycode.Down, charValueToKeycode("down", true));
+    try testing.expectEqual(keycode.Delete, charValueToKeycode("delete", true));
+    try testing.expectEqual(keycode.Tab, charValueToKeycode("tab", true));
+    try testing.expectEqual(keycode.PageUp, charValueToKeycode("pageup", true));
+    try testing.expectEqual(keycode.PageDown, charValueToKeycode("pagedown", true));
+    try testing.expectEqual(keycode.Home, charValueToKeycode("home", true));
+    try testing.expectEqual(keycode.End, charValueToKeycode("end", true));
 }
 
 test "charValueToKeycode converts function keys" {
-    try testing.expectEqual(keycode.Func1, charValueToKeycode("func1"));
-    try testing.expectEqual(keycode.Func12, charValueToKeycode("func12"));
+    try testing.expectEqual(keycode.Func1, charValueToKeycode("func1", true));
+    try testing.expectEqual(keycode.Func12, charValueToKeycode("func12", true));
 }
 
 test "charValueToKeycode handles edge cases" {
-    try testing.expectEqual(keycode.Return, charValueToKeycode(""));
-    try testing.expectEqual(keycode.Unknown, charValueToKeycode("unknown"));
+    try testing.expectEqual(keycode.Return, charValueToKeycode("", true));
+    try testing.expectEqual(keycode.Unknown, charValueToKeycode("unknown", true));
 }
 
 // glk_exit is used by event handling
 pub fn glk_exit() callconv(.c) noreturn {
-    protocol.flushTextBuffer();
     protocol.flushGridWindows();
+    graphics.flushGraphicsWindows();
+    stream.flushFileStreams();
     // Always send a final update with exit: true
     protocol.queueExit();
     protocol.sendUpdate();
+    protocol.reportStats();
     std.process.exit(0);
 }
@@ -0,0 +1,202 @@
+// filebuf.zig - Buffered I/O for file streams
+//
+// Glk reads and writes file streams a character at a time, and each
+// std.fs.File call is a syscall (a host call through the WASI shim). A
+// FileBuffer caches one window of the file so character I/O only touches
+// memory; the file is accessed when the window is refilled or written back.
+//
+// The buffer holds file bytes [base, base + len) and the stream position is
+// base + pos. Bytes in [dirty_start, dirty_end) have been written but not yet
+// flushed. Seeking flushes pending writes, and keeps the buffer if the new
+// position falls inside it.
+
+const std = @import("std");
+
+pub const buffer_size = 8192;
+
+pub const FileBuffer = struct {
+    file: std.fs.File,
+    base: u64 = 0,
+    pos: usize = 0,
+    len: usize = 0,
+    dirty_start: usize = 0,
+    dirty_end: usize = 0,
+    bytes: [buffer_size]u8 = undefined,
+
+    /// Start buffering at the file's current position.
+    pub fn init(file: std.fs.File) FileBuffer {
+        return .{ .file = file, .base = file.getPos() catch 0 };
+    }
+
+    pub fn position(self: *const FileBuffer) u64 {
+        return self.base + self.pos;
+    }
+
+    /// Write back any pending bytes. Returns false on a write error.
+    pub fn flush(self: *FileBuffer) bool {
+        if (self.dirty_end == self.dirty_start) return true;
+        defer {
+            self.dirty_start = 0;
+            self.dirty_end = 0;
+        }
+        self.file.seekTo(self.base + self.dirty_start) catch return false;
+        self.file.writeAll(self.bytes[self.dirty_start..self.dirty_end]) catch return false;
+        return true;
+    }
+
+    /// Read the next byte, or null at end of file.
+    pub fn readByte(self: *FileBuffer) ?u8 {
+        if (self.pos >= self.len and !self.refill()) return null;
+        const byte = self.bytes[self.pos];
+        self.pos += 1;
+        return byte;
+    }
+
+    /// Read up to dest.len bytes; returns the number read (short at end of file).
+    pub fn read(self: *FileBuffer, dest: []u8) usize {
+        var count: usize = 0;
+        while (count < dest.len) {
+            if (self.pos >= self.len) {
+                // Large reads bypass the buffer once it is drained
+                if (dest.len - count >= buffer_size) {
+                    if (!self.moveTo(self.position())) return count;
+                    self.file.seekTo(self.base) catch return count;
+                    const n = self.file.readAll(dest[count..]) catch return count;
+                    self.base += n;
+                    return count + n;
+                }
+                if (!self.refill()) return count;
+            }
+            const n = @min(dest.len - count, self.len - self.pos);
+            @memcpy(dest[count..][0..n], self.bytes[self.pos..][0..n]);
+            self.pos += n;
+            count += n;
+        }
+        return count;
+    }
+
+    pub fn writeByte(self: *FileBuffer, byte: u8) bool {
+        if (self.pos >= buffer_size and !self.moveTo(self.position())) return false;
+        self.bytes[self.pos] = byte;
+        self.markDirty(self.pos, self.pos + 1);
+        self.pos += 1;
+        if (self.pos > self.len) self.len = self.pos;
+        return true;
+    }
+
+    pub fn write(self: *FileBuffer, src: []const u8) bool {
+        var rest = src;
+        while (rest.len > 0) {
+            if (self.pos >= buffer_size and !self.moveTo(self.position())) return false;
+            const n = @min(rest.len, buffer_size - self.pos);
+            @memcpy(self.bytes[self.pos..][0..n], rest[0..n]);
+            self.markDirty(self.pos, self.pos + n);
+            self.pos += n;
+            if (self.pos > self.len) self.len = self.pos;
+            rest = rest[n..];
+        }
+        return true;
+    }
+
+    /// Set the stream position. Pending writes are flushed first; the buffered
+    /// window is kept if the new position lies inside it.
+    pub fn seekTo(self: *FileBuffer, offset: u64) bool {
+        if (!self.flush()) return false;
+        if (offset >= self.base and offset <= self.base + self.len) {
+            self.pos = @intCast(offset - self.base);
+            return true;
+        }
+        return self.moveTo(offset);
+    }
+
+    /// Size of the file including bytes not yet flushed.
+    pub fn endPosition(self: *FileBuffer) u64 {
+        const on_disk = self.file.getEndPos() catch 0;
+        return @max(on_disk, self.base + self.len);
+    }
+
+    // Flush and drop the buffered window, restarting it at `offset`
+    fn moveTo(self: *FileBuffer, offset: u64) bool {
+        if (!self.flush()) return false;
+        self.base = offset;
+        self.pos = 0;
+        self.len = 0;
+        return true;
+    }
+
+    // Load the window starting at the current position
+    fn refill(self: *FileBuffer) bool {
+        if (!self.moveTo(self.position())) return false;
+        self.file.seekTo(self.base) catch return false;
+        self.len = self.file.readAll(&self.bytes) catch 0;
+        return self.len > 0;
+    }
+
+    fn markDirty(self: *FileBuffer, start: usize, end: usize) void {
+        if (self.dirty_end == self.dirty_start) {
+            self.dirty_start = start;
+            self.dirty_end = end;
+        } else {
+            self.dirty_start = @min(self.dirty_start, start);
+            self.dirty_end = @max(self.dirty_end, end);
+        }
+    }
+};
+
+// ============== Tests ==============
+
+const testing = std.testing;
+
+test "FileBuffer round-trips writes and reads across buffer boundaries" {
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const file = try tmp.dir.createFile("data", .{ .read = true });
+    defer file.close();
+
+    var fb = FileBuffer.init(file);
+    for (0..buffer_size * 3) |i| try testing.expect(fb.writeByte(@truncate(i)));
+    try testing.expectEqual(@as(u64, buffer_size * 3), fb.position());
+
+    try testing.expect(fb.seekTo(0));
+    for (0..buffer_size * 3) |i| try testing.expectEqual(@as(u8, @truncate(i)), fb.readByte().?);
+    try testing.expect(fb.readByte() == null);
+}
+
+test "FileBuffer flushes pending writes before seeking" {
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const file = try tmp.dir.createFile("data", .{ .read = true });
+    defer file.close();
+
+    var fb = FileBuffer.init(file);
+    try testing.expect(fb.write("hello world"));
+    try testing.expectEqual(@as(u64, 11), fb.endPosition());
+
+    // Overwrite in place, then read back from a fresh buffer
+    try testing.expect(fb.seekTo(6));
+    try testing.expect(fb.write("there"));
+    try testing.expect(fb.seekTo(buffer_size * 2));
+    try testing.expectEqual(@as(u64, 11), try file.getEndPos());
+
+    var reader = FileBuffer.init(file);
+    try testing.expect(reader.seekTo(0));
+    var buf: [32]u8 = undefined;
+    try testing.expectEqualStrings("hello there", buf[0..reader.read(&buf)]);
+}
+
+test "FileBuffer reads large blocks directly" {
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const file = try tmp.dir.createFile("data", .{ .read = true });
+    defer file.close();
+
+    const data = [_]u8{0xAB} ** (buffer_size * 2 + 100);
+    try file.writeAll(&data);
+
+    var fb = FileBuffer.init(file);
+    try testing.expect(fb.seekTo(0));
+    try testing.expectEqual(@as(?u8, 0xAB), fb.readByte());
+    var dest: [data.len]u8 = undefined;
+    try testing.expectEqual(data.len - 1, fb.read(&dest));
+    try testing.expectEqual(@as(u64, data.len), fb.position());
+}
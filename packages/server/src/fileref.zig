@@ -12,23 +12,29 @@ const FileRefData = state.FileRefData;
 const allocator = state.allocator;
 
 export fn glk_fileref_create_temp(usage: glui32, rock: glui32) callconv(.c) frefid_t {
-    var buf: [64]u8 = undefined;
-    const filename = std.fmt.bufPrint(&buf, "glktmp_{d}", .{state.fileref_id_counter}) catch return null;
+    const fref = state.fileref_pool.create() catch return null;
+    const id = state.filerefs.insert(fref);
+    if (id == 0) {
+        state.fileref_pool.destroy(fref);
+        return null;
+    }
 
-    const fref = allocator.create(FileRefData) catch return null;
+    // Handle ids are unique among live filerefs, so they name the temp file
+    var buf: [64]u8 = undefined;
+    const filename = std.fmt.bufPrint(&buf, "glktmp_{d}", .{id}) catch unreachable;
     const filename_copy = allocator.dupe(u8, filename) catch {
-        allocator.destroy(fref);
+        state.filerefs.remove(id);
+        state.fileref_pool.destroy(fref);
         return null;
     };
 
     fref.* = FileRefData{
-        .id = state.fileref_id_counter,
+        .id = id,
         .rock = rock,
         .filename = filename_copy,
         .usage = usage,
         .textmode = (usage & fileusage.TextMode) != 0,
     };
-    state.fileref_id_counter += 1;
 
     fref.next = state.fileref_list;
     if (state.fileref_list) |list| list.prev = fref;
@@ -47,19 +53,24 @@ pub export fn glk_fileref_create_by_name(usage: glui32, name: ?[*:0]const u8, ro
     const name_span = std.mem.span(name_ptr);
     const filename_copy = allocator.dupe(u8, name_span) catch return null;
 
-    const fref = allocator.create(FileRefData) catch {
+    const fref = state.fileref_pool.create() catch {
         allocator.free(filename_copy);
         return null;
     };
 
+    const id = state.filerefs.insert(fref);
+    if (id == 0) {
+        state.fileref_pool.destroy(fref);
+        allocator.free(filename_copy);
+        return null;
+    }
     fref.* = FileRefData{
-        .id = state.fileref_id_counter,
+        .id = id,
         .rock = rock,
         .filename = filename_copy,
         .usage = usage,
         .textmode = (usage & fileusage.TextMode) != 0,
     };
-    state.fileref_id_counter += 1;
 
     fref.next = state.fileref_list;
     if (state.fileref_list) |list| list.prev = fref;
@@ -83,20 +94,25 @@ export fn glk_fileref_create_by_prompt(usage: glui32, fmode: glui32, rock: glui3
     defer allocator.free(filename);
 
     // Create the fileref with the returned filename
-    const fref = allocator.create(FileRefData) catch return null;
+    const fref = state.fileref_pool.create() catch return null;
     const filename_copy = allocator.dupe(u8, filename) catch {
-        allocator.destroy(fref);
+        state.fileref_pool.destroy(fref);
         return null;
     };
 
+    const id = state.filerefs.insert(fref);
+    if (id == 0) {
+        state.fileref_pool.destroy(fref);
+        allocator.free(filename_copy);
+        return null;
+    }
     fref.* = FileRefData{
-        .id = state.fileref_id_counter,
+        .id = id,
         .rock = rock,
         .filename = filename_copy,
         .usage = usage,
         .textmode = (usage & fileusage.TextMode) != 0,
     };
-    state.fileref_id_counter += 1;
 
     fref.next = state.fileref_list;
     if (state.fileref_list) |list| list.prev = fref;
@@ -129,6 +145,7 @@ pub export fn glk_fileref_destroy(fref_opaque: frefid_t) callconv(.c) void {
     // Remove from list
     if (f.prev) |p| p.next = f.next else state.fileref_list = f.next;
     if (f.next) |n| n.prev = f.prev;
+    state.filerefs.remove(f.id);
 
     // Free the C string copy if it was allocated
     if (f.filename_cstr) |cstr| {
@@ -136,7 +153,7 @@ pub export fn glk_fileref_destroy(fref_opaque: frefid_t) callconv(.c) void {
         allocator.free(slice);
     }
     allocator.free(f.filename);
-    allocator.destroy(f);
+    state.fileref_pool.destroy(f);
 }
 
 export fn glk_fileref_iterate(fref_opaque: frefid_t, rockptr: ?*glui32) callconv(.c) frefid_t {
@@ -4,6 +4,8 @@ const std = @import("std");
 const types = @import("types.zig");
 const blorb = @import("blorb.zig");
 const protocol = @import("protocol.zig");
+const stream = @import("stream.zig");
+const graphics = @import("graphics.zig");
 
 const glui32 = types.glui32;
 const gestalt = types.gestalt;
@@ -144,11 +146,13 @@ test "gestalt unknown selector returns 0" {
 }
 
 pub export fn glk_exit() callconv(.c) noreturn {
-    protocol.flushTextBuffer();
     protocol.flushGridWindows();
+    graphics.flushGraphicsWindows();
+    stream.flushFileStreams();
     // Always send a final update with exit: true
     protocol.queueExit();
     protocol.sendUpdate();
+    protocol.reportStats();
     std.process.exit(0);
 }
 
@@ -78,6 +78,12 @@ struct giblorb_map_struct {
         in map->resources -- sorted by usage and resource number. */
 
     giblorb_auxpict_t *auxpict;
+
+    /* The whole file as one read-only region, if the library has it in
+        memory (see giblorb_set_map_data). Memory loads then point into it
+        instead of copying each chunk. */
+    const unsigned char *data;
+    glui32 datalen;
 };
 
 #define giblorb_Inited_Magic (0xB7012BED) 
@@ -214,6 +220,8 @@ giblorb_err_t giblorb_create_map(strid_t file, giblorb_map_t **newmap)
     map->palette = NULL;
     map->auxsound = NULL;*/
     map->auxpict = NULL;
+    map->data = NULL;
+    map->datalen = 0;
     
     /* Now we do everything else involved in loading the Blorb file,
         such as building resource lists. */
@@ -443,6 +451,12 @@ giblorb_err_t giblorb_load_chunk_by_number(giblorb_map_t *map,
             break;
             
         case giblorb_method_Memory:
+            if (map->data && chu->len <= map->datalen
+                && chu->datpos <= map->datalen - chu->len) {
+                /* Point into the in-memory file; nothing to load or free. */
+                res->data.ptr = (void *)(map->data + chu->datpos);
+                break;
+            }
             if (!chu->ptr) {
                 glui32 readlen;
                 void *dat = giblorb_malloc(chu->len);
@@ -488,6 +502,17 @@ giblorb_err_t giblorb_load_resource(giblorb_map_t *map, glui32 method,
     return giblorb_load_chunk_by_number(map, method, res, found->chunknum);
 }
 
+giblorb_err_t giblorb_set_map_data(giblorb_map_t *map, const void *data,
+    glui32 datalen)
+{
+    if (!map || map->inited != giblorb_Inited_Magic)
+        return giblorb_err_NotAMap;
+
+    map->data = (const unsigned char *)data;
+    map->datalen = datalen;
+    return giblorb_err_None;
+}
+
 giblorb_err_t giblorb_unload_chunk(giblorb_map_t *map, glui32 chunknum)
 {
     giblorb_chunkdesc_t *chu;
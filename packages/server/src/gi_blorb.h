@@ -88,6 +88,11 @@ extern giblorb_err_t giblorb_count_resources(giblorb_map_t *map,
 extern giblorb_err_t giblorb_load_image_info(giblorb_map_t *map,
     glui32 resnum, giblorb_image_info_t *res);
 
+/* Give the map the whole Blorb file as a read-only region (which must
+    outlive the map); giblorb_method_Memory then returns pointers into it. */
+extern giblorb_err_t giblorb_set_map_data(giblorb_map_t *map,
+    const void *data, glui32 datalen);
+
 /* The following functions are part of the Glk library itself, not 
     the Blorb layer (whose code is in gi_blorb.c). These functions 
     are necessarily implemented in platform-dependent code. 
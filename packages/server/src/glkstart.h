@@ -62,6 +62,63 @@ extern strid_t glkunix_stream_open_pathname(char *pathname, glui32 textmode,
     glui32 rock);
 extern const char *glkunix_fileref_get_filename(frefid_t fref);
 
+#ifdef GLKUNIX_AUTOSAVE_FEATURES
+
+/* Library state for autosave/autorestore (RemGlk-compatible; see
+    autosave.zig). Only interpreters built with GLKUNIX_AUTOSAVE_FEATURES
+    use these. */
+
+#include <stddef.h>
+#include "gi_dispa.h"
+
+typedef struct glkunix_library_state_struct *glkunix_library_state;
+typedef struct glkunix_serialize_context_struct *glkunix_serialize_context_t;
+typedef struct glkunix_unserialize_context_struct *glkunix_unserialize_context_t;
+
+extern glui32 glkunix_save_library_state(strid_t file, strid_t omitstream,
+    void (*extra_state_func)(glkunix_serialize_context_t, void *),
+    void *extra_state_rock);
+extern glkunix_library_state glkunix_load_library_state(strid_t file,
+    int (*extra_state_func)(glkunix_unserialize_context_t, void *),
+    void *extra_state_rock);
+extern glui32 glkunix_update_from_library_state(glkunix_library_state state);
+extern void glkunix_library_state_free(glkunix_library_state state);
+
+extern void glkunix_serialize_uint32(glkunix_serialize_context_t, char *key,
+    glui32 val);
+extern void glkunix_serialize_object(glkunix_serialize_context_t, char *key,
+    void (*func)(glkunix_serialize_context_t, void *), void *rock);
+extern void glkunix_serialize_object_list(glkunix_serialize_context_t,
+    char *key, void (*func)(glkunix_serialize_context_t, void *),
+    int count, size_t size, void *array);
+extern int glkunix_unserialize_uint32(glkunix_unserialize_context_t,
+    char *key, glui32 *res);
+extern int glkunix_unserialize_struct(glkunix_unserialize_context_t,
+    char *key, glkunix_unserialize_context_t *);
+extern int glkunix_unserialize_list(glkunix_unserialize_context_t, char *key,
+    glkunix_unserialize_context_t *, int *count);
+extern int glkunix_unserialize_list_entry(glkunix_unserialize_context_t,
+    int index, glkunix_unserialize_context_t *);
+extern int glkunix_unserialize_object_list_entries(
+    glkunix_unserialize_context_t,
+    int (*func)(glkunix_unserialize_context_t, void *),
+    int count, size_t size, void *array);
+
+extern glui32 glkunix_window_get_updatetag(winid_t win);
+extern glui32 glkunix_stream_get_updatetag(strid_t str);
+extern glui32 glkunix_fileref_get_updatetag(frefid_t fref);
+extern winid_t glkunix_window_find_by_updatetag(glui32 tag);
+extern strid_t glkunix_stream_find_by_updatetag(glui32 tag);
+extern frefid_t glkunix_fileref_find_by_updatetag(glui32 tag);
+extern void glkunix_window_set_dispatch_rock(winid_t win,
+    gidispatch_rock_t rock);
+extern void glkunix_stream_set_dispatch_rock(strid_t str,
+    gidispatch_rock_t rock);
+extern void glkunix_fileref_set_dispatch_rock(frefid_t fref,
+    gidispatch_rock_t rock);
+
+#endif /* GLKUNIX_AUTOSAVE_FEATURES */
+
 #ifdef __cplusplus
 }
 #endif
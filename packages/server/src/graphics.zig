@@ -11,22 +11,15 @@ const glsi32 = types.glsi32;
 const winid_t = types.winid_t;
 const wintype = types.wintype;
 const WindowData = state.WindowData;
+const allocator = state.allocator;
 
 export fn glk_image_get_info(image: glui32, width: ?*glui32, height: ?*glui32) callconv(.c) glui32 {
-    const map = blorb.blorb_map orelse {
+    const info = blorb.imageInfo(image) orelse {
         if (width) |w| w.* = 0;
         if (height) |h| h.* = 0;
         return 0;
     };
 
-    var info: blorb.giblorb_image_info_t = undefined;
-    const err = blorb.giblorb_load_image_info(map, image, &info);
-    if (err != 0) {
-        if (width) |w| w.* = 0;
-        if (height) |h| h.* = 0;
-        return 0;
-    }
-
     if (width) |w| w.* = info.width;
     if (height) |h| h.* = info.height;
     return 1;
@@ -36,23 +29,17 @@ export fn glk_image_draw(win: winid_t, image: glui32, val1: glsi32, val2: glsi32
     const w: ?*WindowData = @ptrCast(@alignCast(win));
     if (w == null) return 0;
 
-    const map = blorb.blorb_map orelse return 0;
-
     // Get image info from Blorb
-    var info: blorb.giblorb_image_info_t = undefined;
-    const err = blorb.giblorb_load_image_info(map, image, &info);
-    if (err != 0) return 0;
-
-    // Flush any pending text
-    protocol.flushTextBuffer();
+    const info = blorb.imageInfo(image) orelse return 0;
 
     // For text buffer windows, val1 is alignment, val2 is unused
     // For graphics windows, val1 is x, val2 is y
     if (w.?.win_type == wintype.TextBuffer) {
-        protocol.sendImageUpdate(w.?.id, image, val1, info.width, info.height);
+        protocol.queueImageUpdate(w.?.id, image, val1, info.width, info.height);
     } else if (w.?.win_type == wintype.Graphics) {
         // Graphics window: val1=x, val2=y
-        protocol.sendGraphicsImageUpdate(w.?.id, image, val1, val2, info.width, info.height);
+        drawImageOverFramebuffer(w.?, val1, val2, info.width, info.height);
+        protocol.queueGraphicsImageUpdate(w.?.id, image, val1, val2, info.width, info.height);
     }
 
     return 1;
@@ -62,21 +49,15 @@ export fn glk_image_draw_scaled(win: winid_t, image: glui32, val1: glsi32, val2:
     const w: ?*WindowData = @ptrCast(@alignCast(win));
     if (w == null) return 0;
 
-    const map = blorb.blorb_map orelse return 0;
-
     // Verify image exists
-    var info: blorb.giblorb_image_info_t = undefined;
-    const err = blorb.giblorb_load_image_info(map, image, &info);
-    if (err != 0) return 0;
-
-    // Flush any pending text
-    protocol.flushTextBuffer();
+    if (blorb.imageInfo(image) == null) return 0;
 
     // Use provided dimensions instead of actual image size
     if (w.?.win_type == wintype.TextBuffer) {
-        protocol.sendImageUpdate(w.?.id, image, val1, width, height);
+        protocol.queueImageUpdate(w.?.id, image, val1, width, height);
     } else if (w.?.win_type == wintype.Graphics) {
-        protocol.sendGraphicsImageUpdate(w.?.id, image, val1, val2, width, height);
+        drawImageOverFramebuffer(w.?, val1, val2, width, height);
+        protocol.queueGraphicsImageUpdate(w.?.id, image, val1, val2, width, height);
     }
 
     return 1;
@@ -87,8 +68,7 @@ export fn glk_window_flow_break(win: winid_t) callconv(.c) void {
     if (w == null) return;
     if (w.?.win_type != wintype.TextBuffer) return;
 
-    protocol.flushTextBuffer();
-    protocol.sendFlowBreakUpdate(w.?.id);
+    protocol.queueFlowBreakUpdate(w.?.id);
 }
 
 export fn glk_window_erase_rect(win: winid_t, left: glsi32, top: glsi32, width: glui32, height: glui32) callconv(.c) void {
@@ -96,8 +76,11 @@ export fn glk_window_erase_rect(win: winid_t, left: glsi32, top: glsi32, width:
     if (w == null) return;
     if (w.?.win_type != wintype.Graphics) return;
 
-    protocol.flushTextBuffer();
-    protocol.sendGraphicsEraseUpdate(w.?.id, left, top, width, height);
+    if (w.?.gfx_pixels != null) {
+        fillFramebuffer(w.?, opaque_alpha | w.?.gfx_background, left, top, width, height);
+        return;
+    }
+    protocol.queueGraphicsEraseUpdate(w.?.id, left, top, width, height);
 }
 
 export fn glk_window_fill_rect(win: winid_t, color: glui32, left: glsi32, top: glsi32, width: glui32, height: glui32) callconv(.c) void {
@@ -105,8 +88,11 @@ export fn glk_window_fill_rect(win: winid_t, color: glui32, left: glsi32, top: g
     if (w == null) return;
     if (w.?.win_type != wintype.Graphics) return;
 
-    protocol.flushTextBuffer();
-    protocol.sendGraphicsFillUpdate(w.?.id, color, left, top, width, height);
+    if (w.?.gfx_pixels != null) {
+        fillFramebuffer(w.?, opaque_alpha | (color & 0xFFFFFF), left, top, width, height);
+        return;
+    }
+    protocol.queueGraphicsFillUpdate(w.?.id, color, left, top, width, height);
 }
 
 export fn glk_window_set_background_color(win: winid_t, color: glui32) callconv(.c) void {
@@ -114,6 +100,88 @@ export fn glk_window_set_background_color(win: winid_t, color: glui32) callconv(
     if (w == null) return;
     if (w.?.win_type != wintype.Graphics) return;
 
-    protocol.flushTextBuffer();
-    protocol.sendGraphicsSetColorUpdate(w.?.id, color);
+    // With a framebuffer the background only matters for later erases and
+    // clears, which are drawn here
+    w.?.gfx_background = color & 0xFFFFFF;
+    if (w.?.gfx_pixels != null) return;
+    protocol.queueGraphicsSetColorUpdate(w.?.id, color);
+}
+
+// ============== Framebuffer ==============
+//
+// Interpreters that draw pictures as runs of tiny fills (Magnetic Scrolls,
+// Level 9, Scott Adams) would otherwise send a draw op per rectangle. When the
+// client supports "raster", each graphics window keeps a framebuffer that
+// absorbs fills and erases; at glk_select the damaged region goes out as one
+// run-length encoded raster op. Images are still drawn by the client, so
+// their pixels are marked transparent here and later rasters leave them be.
+
+const opaque_alpha: glui32 = 0xFF000000;
+
+/// Size a graphics window's framebuffer to its layout. The contents are
+/// reset to the background, as the game redraws after an arrange event.
+pub fn resizeFramebuffer(win: *WindowData, width: glui32, height: glui32) void {
+    if (!state.client_support.raster) return;
+    if (win.gfx_pixels != null and width == win.gfx_width and height == win.gfx_height) return;
+
+    const pixels = allocator.alloc(glui32, @as(usize, width) * height) catch return;
+    if (win.gfx_pixels) |old| allocator.free(old);
+    win.gfx_pixels = pixels;
+    win.gfx_width = width;
+    win.gfx_height = height;
+    clearFramebuffer(win);
+}
+
+/// Fill the framebuffer with the background colour (glk_window_clear).
+pub fn clearFramebuffer(win: *WindowData) void {
+    const pixels = win.gfx_pixels orelse return;
+    @memset(pixels, opaque_alpha | win.gfx_background);
+    win.gfx_damage = .{ .x1 = win.gfx_width, .y1 = win.gfx_height };
+}
+
+// Queue the damaged region of every graphics window framebuffer
+pub fn flushGraphicsWindows() void {
+    var win = state.window_list;
+    while (win) |w| : (win = w.next) {
+        if (w.win_type == wintype.Graphics) flushFramebuffer(w);
+    }
+}
+
+fn flushFramebuffer(win: *WindowData) void {
+    const pixels = win.gfx_pixels orelse return;
+    if (win.gfx_damage.isEmpty()) return;
+    protocol.queueGraphicsRaster(win.id, pixels, win.gfx_width, win.gfx_damage);
+    win.gfx_damage = .{};
+}
+
+// Clip a rectangle to the framebuffer
+fn clipRect(win: *const WindowData, left: glsi32, top: glsi32, width: glui32, height: glui32) state.PixelRect {
+    const x0: i64 = left;
+    const y0: i64 = top;
+    return .{
+        .x0 = @intCast(std.math.clamp(x0, 0, win.gfx_width)),
+        .y0 = @intCast(std.math.clamp(y0, 0, win.gfx_height)),
+        .x1 = @intCast(std.math.clamp(x0 + width, 0, win.gfx_width)),
+        .y1 = @intCast(std.math.clamp(y0 + height, 0, win.gfx_height)),
+    };
+}
+
+fn fillFramebuffer(win: *WindowData, pixel: glui32, left: glsi32, top: glsi32, width: glui32, height: glui32) void {
+    const pixels = win.gfx_pixels orelse return;
+    const rect = clipRect(win, left, top, width, height);
+    if (rect.isEmpty()) return;
+    var y = rect.y0;
+    while (y < rect.y1) : (y += 1) {
+        @memset(pixels[y * win.gfx_width + rect.x0 .. y * win.gfx_width + rect.x1], pixel);
+    }
+    win.gfx_damage.add(rect);
+}
+
+// An image is about to be drawn by the client: send what is pending underneath
+// it first, then mark its pixels transparent so later rasters keep it
+fn drawImageOverFramebuffer(win: *WindowData, left: glsi32, top: glsi32, width: glui32, height: glui32) void {
+    if (win.gfx_pixels == null) return;
+    flushFramebuffer(win);
+    fillFramebuffer(win, 0, left, top, width, height);
+    win.gfx_damage = .{};
 }
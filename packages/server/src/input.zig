@@ -0,0 +1,513 @@
+// input.zig - Buffered line reader and parser for client events
+//
+// Client events arrive as newline-terminated JSON on stdin. Reading them a
+// byte at a time costs one syscall per byte (one host call per byte under
+// WASI), so bytes are read in large chunks and any leftover after a newline
+// is kept for the next call. The buffer grows to fit the longest line seen;
+// there is no fixed cap on line length.
+
+const std = @import("std");
+const state = @import("state.zig");
+const Metrics = @import("protocol.zig").Metrics;
+
+const allocator = state.allocator;
+
+// Bytes requested from read() at a time
+const read_chunk = 4096;
+
+pub const LineReader = struct {
+    fd: std.posix.fd_t,
+    bytes: std.ArrayListUnmanaged(u8) = .empty,
+    // Start of the unconsumed data in bytes
+    start: usize = 0,
+    // Unconsumed bytes before this offset are known not to contain '\n'
+    scanned: usize = 0,
+    // Statistics (reported by protocol.reportStats)
+    read_count: u64 = 0,
+    line_count: u64 = 0,
+
+    /// Return the next line without its '\n', or null at EOF or on a read error.
+    /// The slice is valid until the next call, and may be modified in place
+    /// (parseEvent unescapes strings into it).
+    pub fn readLine(self: *LineReader) ?[]u8 {
+        while (true) {
+            const pending = self.bytes.items[self.start..];
+            if (std.mem.indexOfScalarPos(u8, pending, self.scanned, '\n')) |nl| {
+                const line = pending[0..nl];
+                self.start += nl + 1;
+                self.scanned = 0;
+                self.line_count += 1;
+                return line;
+            }
+            self.scanned = pending.len;
+            if (!self.fill()) return null;
+        }
+    }
+
+    // Read more input, moving unconsumed bytes to the front first.
+    // Returns false at EOF or on error.
+    fn fill(self: *LineReader) bool {
+        if (self.start > 0) {
+            const pending_len = self.bytes.items.len - self.start;
+            std.mem.copyForwards(u8, self.bytes.items[0..pending_len], self.bytes.items[self.start..]);
+            self.bytes.items.len = pending_len;
+            self.start = 0;
+        }
+        self.bytes.ensureUnusedCapacity(allocator, read_chunk) catch return false;
+        const unused = self.bytes.allocatedSlice()[self.bytes.items.len..];
+        const n = std.posix.read(self.fd, unused) catch return false;
+        self.read_count += 1;
+        if (n == 0) return false; // EOF
+        self.bytes.items.len += n;
+        return true;
+    }
+
+    pub fn deinit(self: *LineReader) void {
+        self.bytes.deinit(allocator);
+        self.* = .{ .fd = self.fd };
+    }
+};
+
+// ============== Event Parser ==============
+//
+// Events are parsed in a single pass over the line returned by readLine.
+// Strings are unescaped in place and returned as slices of the line, and
+// `type` and `terminator` are mapped to enums, so parsing an event does no
+// heap allocation. Only the fields of the RemGlk input schema are decoded;
+// anything else is skipped.
+
+pub const EventType = enum {
+    init,
+    line,
+    char,
+    timer,
+    arrange,
+    mouse,
+    hyperlink,
+    redraw,
+    refresh,
+    debuginput,
+    external,
+    specialresponse,
+    unknown,
+};
+
+// Line input terminators (per GlkOte spec)
+pub const Terminator = enum {
+    escape,
+    func1,
+    func2,
+    func3,
+    func4,
+    func5,
+    func6,
+    func7,
+    func8,
+    func9,
+    func10,
+    func11,
+    func12,
+};
+
+// Partial line input for one window ({"<window id>": "<text>"})
+pub const Partial = struct {
+    window: u32,
+    text: []const u8,
+};
+
+const max_partials = 8;
+
+pub const InputEvent = struct {
+    type: EventType,
+    gen: u32 = 0,
+    window: ?u32 = null,
+    value: ?[]const u8 = null, // String value for line/char input and specialresponse
+    linkval: ?u32 = null, // Numeric value for hyperlink events
+    metrics: ?Metrics = null,
+    support: ?state.ClientSupport = null, // Features the display supports (init)
+    partial: [max_partials]Partial = undefined,
+    partial_len: usize = 0,
+    // Mouse event coordinates
+    x: ?i32 = null,
+    y: ?i32 = null,
+    terminator: ?Terminator = null,
+    // Special response type (e.g., "fileref_prompt")
+    response: ?[]const u8 = null,
+
+    pub fn partials(self: *const InputEvent) []const Partial {
+        return self.partial[0..self.partial_len];
+    }
+};
+
+/// Parse one event line. Slices in the result point into `line`, which is
+/// modified in place. Returns null for malformed JSON or a missing type.
+pub fn parseEvent(line: []u8) ?InputEvent {
+    var p = Parser{ .buf = line };
+    return p.event() catch null;
+}
+
+const Parser = struct {
+    buf: []u8,
+    pos: usize = 0,
+
+    const Error = error{Syntax};
+
+    const Field = enum { type, gen, window, value, metrics, support, partial, x, y, terminator, response };
+
+    fn event(p: *Parser) Error!InputEvent {
+        var ev = InputEvent{ .type = .unknown };
+        var has_type = false;
+        try p.expect('{');
+        var first = true;
+        while (try p.nextKey(&first)) |key| {
+            const field = std.meta.stringToEnum(Field, key) orelse {
+                try p.skipValue();
+                continue;
+            };
+            if (p.eatLiteral("null")) continue;
+            switch (field) {
+                .type => {
+                    ev.type = std.meta.stringToEnum(EventType, try p.string()) orelse .unknown;
+                    has_type = true;
+                },
+                .gen => ev.gen = try p.int(u32),
+                .window => ev.window = try p.int(u32),
+                .value => switch (p.peek()) {
+                    '"' => ev.value = try p.string(),
+                    '-', '0'...'9' => ev.linkval = p.int(u32) catch null,
+                    else => try p.skipValue(),
+                },
+                .metrics => ev.metrics = try p.metrics(),
+                .support => ev.support = try p.support(),
+                .partial => try p.partial(&ev),
+                .x => ev.x = try p.int(i32),
+                .y => ev.y = try p.int(i32),
+                .terminator => ev.terminator = std.meta.stringToEnum(Terminator, try p.string()),
+                .response => ev.response = try p.string(),
+            }
+        }
+        if (!has_type) return error.Syntax;
+        return ev;
+    }
+
+    fn metrics(p: *Parser) Error!Metrics {
+        var m = Metrics{};
+        try p.expect('{');
+        var first = true;
+        while (try p.nextKey(&first)) |key| {
+            var known = false;
+            inline for (std.meta.fields(Metrics)) |f| {
+                if (!known and std.mem.eql(u8, key, f.name)) {
+                    known = true;
+                    const T = @typeInfo(f.type).optional.child;
+                    @field(m, f.name) = if (p.eatLiteral("null")) null else if (T == f64) try p.float() else try p.int(T);
+                }
+            }
+            if (!known) try p.skipValue();
+        }
+        return m;
+    }
+
+    fn support(p: *Parser) Error!state.ClientSupport {
+        var s = state.ClientSupport{};
+        try p.expect('[');
+        var first = true;
+        while (try p.nextItem(&first)) {
+            const feature = try p.string();
+            inline for (std.meta.fields(state.ClientSupport)) |f| {
+                if (std.mem.eql(u8, feature, f.name)) @field(s, f.name) = true;
+            }
+        }
+        return s;
+    }
+
+    fn partial(p: *Parser, ev: *InputEvent) Error!void {
+        try p.expect('{');
+        var first = true;
+        while (try p.nextKey(&first)) |key| {
+            const win_id = std.fmt.parseInt(u32, key, 10) catch null;
+            if (win_id == null or p.peek() != '"') {
+                try p.skipValue();
+                continue;
+            }
+            const text = try p.string();
+            if (ev.partial_len < max_partials) {
+                ev.partial[ev.partial_len] = .{ .window = win_id.?, .text = text };
+                ev.partial_len += 1;
+            }
+        }
+    }
+
+    // ---- Tokens ----
+
+    fn skipSpace(p: *Parser) void {
+        while (p.pos < p.buf.len) : (p.pos += 1) {
+            switch (p.buf[p.pos]) {
+                ' ', '\t', '\r', '\n' => {},
+                else => return,
+            }
+        }
+    }
+
+    // Next non-space byte without consuming it (0 at end of input)
+    fn peek(p: *Parser) u8 {
+        p.skipSpace();
+        return if (p.pos < p.buf.len) p.buf[p.pos] else 0;
+    }
+
+    fn eat(p: *Parser, c: u8) bool {
+        if (p.peek() != c) return false;
+        p.pos += 1;
+        return true;
+    }
+
+    fn expect(p: *Parser, c: u8) Error!void {
+        if (!p.eat(c)) return error.Syntax;
+    }
+
+    fn eatLiteral(p: *Parser, comptime lit: []const u8) bool {
+        p.skipSpace();
+        if (!std.mem.startsWith(u8, p.buf[p.pos..], lit)) return false;
+        p.pos += lit.len;
+        return true;
+    }
+
+    // Next key of an object whose '{' has been consumed, or null at its '}'
+    fn nextKey(p: *Parser, first: *bool) Error!?[]const u8 {
+        if (p.eat('}')) return null;
+        if (!first.*) try p.expect(',');
+        first.* = false;
+        const key = try p.string();
+        try p.expect(':');
+        return key;
+    }
+
+    // Whether another item of an array whose '[' has been consumed follows
+    fn nextItem(p: *Parser, first: *bool) Error!bool {
+        if (p.eat(']')) return false;
+        if (!first.*) try p.expect(',');
+        first.* = false;
+        return true;
+    }
+
+    // A string, unescaped in place (the result is never longer than its
+    // escaped form, so it always fits where it came from)
+    fn string(p: *Parser) Error![]const u8 {
+        try p.expect('"');
+        const start = p.pos;
+        var out = p.pos;
+        while (p.pos < p.buf.len) {
+            const c = p.buf[p.pos];
+            p.pos += 1;
+            switch (c) {
+                '"' => return p.buf[start..out],
+                '\\' => out += try p.escape(out),
+                else => {
+                    p.buf[out] = c;
+                    out += 1;
+                },
+            }
+        }
+        return error.Syntax;
+    }
+
+    // Decode the escape after a backslash into buf[out..]; returns its length
+    fn escape(p: *Parser, out: usize) Error!usize {
+        if (p.pos >= p.buf.len) return error.Syntax;
+        const c = p.buf[p.pos];
+        p.pos += 1;
+        p.buf[out] = switch (c) {
+            '"', '\\', '/' => c,
+            'b' => 0x08,
+            'f' => 0x0C,
+            'n' => '\n',
+            'r' => '\r',
+            't' => '\t',
+            'u' => {
+                var cp = try p.hex4();
+                if (cp >= 0xD800 and cp <= 0xDBFF) {
+                    if (!std.mem.startsWith(u8, p.buf[p.pos..], "\\u")) return error.Syntax;
+                    p.pos += 2;
+                    const low = try p.hex4();
+                    if (low < 0xDC00 or low > 0xDFFF) return error.Syntax;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                const n = std.unicode.utf8Encode(cp, p.buf[out..]) catch return error.Syntax;
+                return n;
+            },
+            else => return error.Syntax,
+        };
+        return 1;
+    }
+
+    fn hex4(p: *Parser) Error!u21 {
+        if (p.buf.len - p.pos < 4) return error.Syntax;
+        const v = std.fmt.parseInt(u16, p.buf[p.pos..][0..4], 16) catch return error.Syntax;
+        p.pos += 4;
+        return v;
+    }
+
+    fn number(p: *Parser) Error![]const u8 {
+        p.skipSpace();
+        const start = p.pos;
+        while (p.pos < p.buf.len) : (p.pos += 1) {
+            switch (p.buf[p.pos]) {
+                '0'...'9', '-', '+', '.', 'e', 'E' => {},
+                else => break,
+            }
+        }
+        if (p.pos == start) return error.Syntax;
+        return p.buf[start..p.pos];
+    }
+
+    fn float(p: *Parser) Error!f64 {
+        return std.fmt.parseFloat(f64, try p.number()) catch return error.Syntax;
+    }
+
+    // An integer; a number with a fraction or exponent is truncated
+    fn int(p: *Parser, comptime T: type) Error!T {
+        const tok = try p.number();
+        return std.fmt.parseInt(T, tok, 10) catch {
+            const f = std.fmt.parseFloat(f64, tok) catch return error.Syntax;
+            if (!(f >= std.math.minInt(T) and f <= std.math.maxInt(T))) return error.Syntax;
+            return @intFromFloat(f);
+        };
+    }
+
+    fn skipValue(p: *Parser) Error!void {
+        var first = true;
+        switch (p.peek()) {
+            '"' => _ = try p.string(),
+            '{' => {
+                p.pos += 1;
+                while (try p.nextKey(&first)) |_| try p.skipValue();
+            },
+            '[' => {
+                p.pos += 1;
+                while (try p.nextItem(&first)) try p.skipValue();
+            },
+            't' => if (!p.eatLiteral("true")) return error.Syntax,
+            'f' => if (!p.eatLiteral("false")) return error.Syntax,
+            'n' => if (!p.eatLiteral("null")) return error.Syntax,
+            else => _ = try p.number(),
+        }
+    }
+};
+
+// ============== Tests ==============
+
+const testing = std.testing;
+
+test "LineReader splits chunks into lines and keeps leftovers" {
+    const fds = try std.posix.pipe();
+    defer std.posix.close(fds[0]);
+
+    var reader = LineReader{ .fd = fds[0] };
+    defer reader.deinit();
+
+    _ = try std.posix.write(fds[1], "{\"type\":\"init\"}\n{\"type\":\"line\"}\n{\"ty");
+    try testing.expectEqualStrings("{\"type\":\"init\"}", reader.readLine().?);
+    try testing.expectEqualStrings("{\"type\":\"line\"}", reader.readLine().?);
+    // Both lines came from a single read
+    try testing.expectEqual(@as(u64, 1), reader.read_count);
+
+    _ = try std.posix.write(fds[1], "pe\":\"char\"}\n");
+    try testing.expectEqualStrings("{\"type\":\"char\"}", reader.readLine().?);
+
+    std.posix.close(fds[1]);
+    try testing.expect(reader.readLine() == null);
+}
+
+test "LineReader has no fixed line length cap" {
+    const fds = try std.posix.pipe();
+    defer std.posix.close(fds[0]);
+
+    var reader = LineReader{ .fd = fds[0] };
+    defer reader.deinit();
+
+    // Longer than several read chunks (small enough to fit in a pipe buffer)
+    const long_line = "x" ** 12000;
+    _ = try std.posix.write(fds[1], long_line ++ "\n");
+    std.posix.close(fds[1]);
+
+    const line = reader.readLine().?;
+    try testing.expectEqual(@as(usize, 12000), line.len);
+    try testing.expect(reader.readLine() == null);
+}
+
+test "parseEvent reads a line event without allocating" {
+    var line = "{\"type\":\"line\",\"gen\":3,\"window\":2,\"value\":\"open door\",\"terminator\":\"func2\"}".*;
+    const ev = parseEvent(&line).?;
+    try testing.expectEqual(EventType.line, ev.type);
+    try testing.expectEqual(@as(u32, 3), ev.gen);
+    try testing.expectEqual(@as(?u32, 2), ev.window);
+    try testing.expectEqualStrings("open door", ev.value.?);
+    try testing.expectEqual(@as(?Terminator, .func2), ev.terminator);
+    // The value is a slice of the line itself
+    try testing.expect(@intFromPtr(ev.value.?.ptr) > @intFromPtr(&line) and
+        @intFromPtr(ev.value.?.ptr) < @intFromPtr(&line) + line.len);
+}
+
+test "parseEvent unescapes strings in place" {
+    var line = "{\"type\":\"line\",\"value\":\"say \\\"hi\\\" \\u00e9\\ud83d\\ude00\\n\"}".*;
+    const ev = parseEvent(&line).?;
+    try testing.expectEqualStrings("say \"hi\" \u{e9}\u{1F600}\n", ev.value.?);
+}
+
+test "parseEvent reads hyperlink, mouse and unknown events" {
+    var link = "{\"type\":\"hyperlink\",\"gen\":1,\"window\":4,\"value\":17}".*;
+    const ev = parseEvent(&link).?;
+    try testing.expectEqual(EventType.hyperlink, ev.type);
+    try testing.expectEqual(@as(?u32, 17), ev.linkval);
+    try testing.expect(ev.value == null);
+
+    var mouse = "{ \"type\" : \"mouse\", \"window\": 5, \"x\": -3, \"y\": 12 }".*;
+    const mev = parseEvent(&mouse).?;
+    try testing.expectEqual(EventType.mouse, mev.type);
+    try testing.expectEqual(@as(?i32, -3), mev.x);
+    try testing.expectEqual(@as(?i32, 12), mev.y);
+
+    var other = "{\"type\":\"sparkle\",\"extra\":{\"a\":[1,true,null,\"x\"]}}".*;
+    try testing.expectEqual(EventType.unknown, parseEvent(&other).?.type);
+}
+
+test "parseEvent reads init metrics and support" {
+    var line = "{\"type\":\"init\",\"gen\":0,\"metrics\":{\"width\":800,\"height\":600.0,\"charwidth\":7.5,\"foo\":1},\"support\":[\"timer\",\"hyperlinks\",\"bogus\"]}".*;
+    const ev = parseEvent(&line).?;
+    try testing.expectEqual(EventType.init, ev.type);
+    const m = ev.metrics.?;
+    try testing.expectEqual(@as(?u32, 800), m.width);
+    try testing.expectEqual(@as(?u32, 600), m.height);
+    try testing.expectEqual(@as(?f64, 7.5), m.charwidth);
+    const s = ev.support.?;
+    try testing.expect(s.timer and s.hyperlinks);
+    try testing.expect(!s.graphics and !s.graphicswin);
+}
+
+test "parseEvent collects partial input" {
+    var line = "{\"type\":\"timer\",\"partial\":{\"1\":\"hel\",\"x\":\"skip\",\"3\":\"lo\"}}".*;
+    const ev = parseEvent(&line).?;
+    const partials = ev.partials();
+    try testing.expectEqual(@as(usize, 2), partials.len);
+    try testing.expectEqual(@as(u32, 1), partials[0].window);
+    try testing.expectEqualStrings("hel", partials[0].text);
+    try testing.expectEqual(@as(u32, 3), partials[1].window);
+    try testing.expectEqualStrings("lo", partials[1].text);
+}
+
+test "parseEvent rejects malformed events" {
+    const bad = [_][]const u8{
+        "",
+        "{",
+        "{\"gen\":1}", // No type
+        "{\"type\":\"line\",}",
+        "{\"type\":\"line\",\"value\":\"unterminated}",
+        "{\"type\":\"line\",\"value\":\"\\q\"}",
+        "{\"type\":\"line\",\"value\":\"\\ud83d\"}", // Unpaired surrogate
+    };
+    for (bad) |text| {
+        var buf: [64]u8 = undefined;
+        @memcpy(buf[0..text.len], text);
+        try testing.expect(parseEvent(buf[0..text.len]) == null);
+    }
+}
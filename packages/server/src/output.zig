@@ -0,0 +1,463 @@
+// output.zig - Reusable output arena and streaming JSON writer
+//
+// Every update is serialized straight into a single growable byte arena.
+// The arena is reset (not freed) after each line is written to stdout, so
+// once it has grown to fit the largest update seen it serves every later
+// turn without touching the allocator. Nothing is ever truncated: the arena
+// grows as needed, and only an allocation failure drops an update.
+
+const std = @import("std");
+const builtin = @import("builtin");
+const state = @import("state.zig");
+
+const allocator = state.allocator;
+
+// ============== Output Arena ==============
+
+pub const OutputArena = struct {
+    bytes: std.ArrayListUnmanaged(u8) = .empty,
+    // Set when growing the arena failed; the current line is dropped
+    failed: bool = false,
+    // Statistics (reported by protocol.reportStats)
+    grow_count: u64 = 0,
+    line_count: u64 = 0,
+    bytes_total: u64 = 0,
+
+    /// Discard the contents but keep the capacity for the next line.
+    pub fn reset(self: *OutputArena) void {
+        self.bytes.clearRetainingCapacity();
+        self.failed = false;
+    }
+
+    /// Make room for `n` more bytes. Returns false if the arena could not grow.
+    pub fn ensureUnused(self: *OutputArena, n: usize) bool {
+        if (self.failed) return false;
+        if (self.bytes.capacity - self.bytes.items.len >= n) return true;
+        const old_capacity = self.bytes.capacity;
+        self.bytes.ensureUnusedCapacity(allocator, n) catch {
+            self.failed = true;
+            return false;
+        };
+        if (self.bytes.capacity != old_capacity) self.grow_count += 1;
+        return true;
+    }
+
+    pub fn append(self: *OutputArena, data: []const u8) void {
+        if (!self.ensureUnused(data.len)) return;
+        self.bytes.appendSliceAssumeCapacity(data);
+    }
+
+    pub fn appendByte(self: *OutputArena, byte: u8) void {
+        if (!self.ensureUnused(1)) return;
+        self.bytes.appendAssumeCapacity(byte);
+    }
+
+    pub fn written(self: *const OutputArena) []const u8 {
+        return self.bytes.items;
+    }
+
+    pub fn capacity(self: *const OutputArena) usize {
+        return self.bytes.capacity;
+    }
+
+    /// Record a completed line in the statistics.
+    pub fn recordLine(self: *OutputArena) void {
+        self.line_count += 1;
+        self.bytes_total += self.bytes.items.len;
+    }
+
+    pub fn deinit(self: *OutputArena) void {
+        self.bytes.deinit(allocator);
+        self.* = .{};
+    }
+};
+
+// ============== Streaming JSON Writer ==============
+
+/// Minimal streaming JSON writer over an OutputArena.
+///
+/// Null optional struct fields are omitted (matching the old
+/// `emit_null_optional_fields = false` behaviour). Types can customise
+/// their serialization by declaring `pub fn writeJson(self, jw: *JsonWriter) void`.
+pub const JsonWriter = struct {
+    out: *OutputArena,
+    // Whether a comma is needed before the next value or field
+    needs_comma: bool = false,
+
+    pub fn beginObject(self: *JsonWriter) void {
+        self.valueStart();
+        self.out.appendByte('{');
+        self.needs_comma = false;
+    }
+
+    pub fn endObject(self: *JsonWriter) void {
+        self.out.appendByte('}');
+        self.needs_comma = true;
+    }
+
+    pub fn beginArray(self: *JsonWriter) void {
+        self.valueStart();
+        self.out.appendByte('[');
+        self.needs_comma = false;
+    }
+
+    pub fn endArray(self: *JsonWriter) void {
+        self.out.appendByte(']');
+        self.needs_comma = true;
+    }
+
+    /// Write an object key. Names are Zig identifiers, so they need no escaping.
+    pub fn field(self: *JsonWriter, name: []const u8) void {
+        if (self.needs_comma) self.out.appendByte(',');
+        self.out.appendByte('"');
+        self.out.append(name);
+        self.out.append("\":");
+        self.needs_comma = false;
+    }
+
+    pub fn string(self: *JsonWriter, s: []const u8) void {
+        self.valueStart();
+        self.out.appendByte('"');
+        writeEscaped(self.out, s);
+        self.out.appendByte('"');
+    }
+
+    pub fn int(self: *JsonWriter, value: anytype) void {
+        self.valueStart();
+        var buf: [24]u8 = undefined;
+        const s = std.fmt.bufPrint(&buf, "{d}", .{value}) catch unreachable;
+        self.out.append(s);
+    }
+
+    pub fn float(self: *JsonWriter, value: f64) void {
+        if (!std.math.isFinite(value)) return self.nullValue();
+        // Whole numbers (window coordinates, mostly) are written without a fraction
+        if (@floor(value) == value and @abs(value) < 9007199254740992.0) {
+            return self.int(@as(i64, @intFromFloat(value)));
+        }
+        self.valueStart();
+        var buf: [512]u8 = undefined;
+        const s = std.fmt.bufPrint(&buf, "{d}", .{value}) catch
+            std.fmt.bufPrint(&buf, "{e}", .{value}) catch "0";
+        self.out.append(s);
+    }
+
+    pub fn boolean(self: *JsonWriter, value: bool) void {
+        self.valueStart();
+        self.out.append(if (value) "true" else "false");
+    }
+
+    pub fn nullValue(self: *JsonWriter) void {
+        self.valueStart();
+        self.out.append("null");
+    }
+
+    /// Serialize any supported value (structs, slices, optionals, enums, numbers).
+    pub fn write(self: *JsonWriter, value: anytype) void {
+        const T = @TypeOf(value);
+        switch (@typeInfo(T)) {
+            .bool => self.boolean(value),
+            .int, .comptime_int => self.int(value),
+            .float, .comptime_float => self.float(value),
+            .null => self.nullValue(),
+            .optional => if (value) |v| self.write(v) else self.nullValue(),
+            .@"enum" => self.string(@tagName(value)),
+            .@"struct" => |info| {
+                if (@hasDecl(T, "writeJson")) return value.writeJson(self);
+                self.beginObject();
+                inline for (info.fields) |f| {
+                    const field_value = @field(value, f.name);
+                    if (@typeInfo(f.type) == .optional) {
+                        if (field_value) |v| {
+                            self.field(f.name);
+                            self.write(v);
+                        }
+                    } else {
+                        self.field(f.name);
+                        self.write(field_value);
+                    }
+                }
+                self.endObject();
+            },
+            .@"union" => {
+                if (@hasDecl(T, "writeJson")) return value.writeJson(self);
+                @compileError("union " ++ @typeName(T) ++ " needs a writeJson method");
+            },
+            .pointer => |ptr| switch (ptr.size) {
+                .slice => {
+                    if (ptr.child == u8) return self.string(value);
+                    self.beginArray();
+                    for (value) |item| self.write(item);
+                    self.endArray();
+                },
+                .one => self.write(value.*),
+                else => @compileError("cannot serialize " ++ @typeName(T)),
+            },
+            .array => |arr| {
+                if (arr.child == u8) return self.string(&value);
+                self.beginArray();
+                for (value) |item| self.write(item);
+                self.endArray();
+            },
+            else => @compileError("cannot serialize " ++ @typeName(T)),
+        }
+    }
+
+    fn valueStart(self: *JsonWriter) void {
+        if (self.needs_comma) self.out.appendByte(',');
+        self.needs_comma = true;
+    }
+};
+
+// ============== Binary Writer ==============
+
+/// Writer for the binary update encoding (see protocol.zig). A frame is a
+/// marker byte and a u32 payload length; the payload is a sequence of
+/// records, each a tag byte and a u32 body length. Integers are
+/// little-endian and strings are a u32 byte length followed by UTF-8.
+pub const BinaryWriter = struct {
+    out: *OutputArena,
+    // Offsets of the length fields being filled in
+    frame_len_at: usize = 0,
+    record_len_at: usize = 0,
+
+    // First byte of a binary frame; never the first byte of a JSON line
+    pub const frame_marker: u8 = 0xFF;
+
+    pub fn beginFrame(self: *BinaryWriter) void {
+        self.out.appendByte(frame_marker);
+        self.frame_len_at = self.out.bytes.items.len;
+        self.int(u32, 0);
+    }
+
+    pub fn endFrame(self: *BinaryWriter) void {
+        self.patchLength(self.frame_len_at);
+    }
+
+    pub fn beginRecord(self: *BinaryWriter, tag: u8) void {
+        self.out.appendByte(tag);
+        self.record_len_at = self.out.bytes.items.len;
+        self.int(u32, 0);
+    }
+
+    pub fn endRecord(self: *BinaryWriter) void {
+        self.patchLength(self.record_len_at);
+    }
+
+    pub fn int(self: *BinaryWriter, comptime T: type, value: T) void {
+        var buf: [@sizeOf(T)]u8 = undefined;
+        std.mem.writeInt(T, &buf, value, .little);
+        self.out.append(&buf);
+    }
+
+    pub fn float(self: *BinaryWriter, value: f64) void {
+        self.int(u64, @bitCast(value));
+    }
+
+    pub fn string(self: *BinaryWriter, s: []const u8) void {
+        self.int(u32, @intCast(s.len));
+        self.out.append(s);
+    }
+
+    // Store the number of bytes written after the u32 length field at `at`
+    fn patchLength(self: *BinaryWriter, at: usize) void {
+        if (self.out.failed) return;
+        const len: u32 = @intCast(self.out.bytes.items.len - at - 4);
+        std.mem.writeInt(u32, self.out.bytes.items[at..][0..4], len, .little);
+    }
+};
+
+// ============== String Escaping ==============
+//
+// Text is scanned for the bytes JSON needs escaped ('"', '\\' and control
+// characters) a block at a time, and the clean runs between them are copied
+// whole. With 128-bit vectors (native targets, or wasm built with -Dsimd=true)
+// a block is 16 bytes compared in parallel. Plain wasm32 has no vectors, so
+// @Vector would be split into scalar operations; there 8 bytes are tested
+// at once as a u64 instead.
+
+const use_vectors = builtin.cpu.arch != .wasm32 or
+    std.Target.wasm.featureSetHas(builtin.cpu.features, .simd128);
+
+/// Append `s` to the arena with JSON string escaping applied.
+pub fn writeEscaped(out: *OutputArena, s: []const u8) void {
+    // Most text needs no escaping, so reserve for that case up front
+    if (!out.ensureUnused(s.len)) return;
+    var start: usize = 0;
+    while (true) {
+        const i = findEscape(s, start);
+        out.append(s[start..i]);
+        if (i == s.len) return;
+        appendEscape(out, s[i]);
+        start = i + 1;
+    }
+}
+
+fn needsEscape(c: u8) bool {
+    return c < 0x20 or c == '"' or c == '\\';
+}
+
+fn appendEscape(out: *OutputArena, c: u8) void {
+    out.append(switch (c) {
+        '"' => "\\\"",
+        '\\' => "\\\\",
+        '\n' => "\\n",
+        '\r' => "\\r",
+        '\t' => "\\t",
+        0x08 => "\\b",
+        0x0C => "\\f",
+        else => {
+            var buf: [6]u8 = undefined;
+            out.append(std.fmt.bufPrint(&buf, "\\u{x:0>4}", .{c}) catch unreachable);
+            return;
+        },
+    });
+}
+
+// Index of the first byte at or after `from` that needs escaping, or s.len
+fn findEscape(s: []const u8, from: usize) usize {
+    return if (use_vectors) findEscapeVector(s, from) else findEscapeWord(s, from);
+}
+
+fn findEscapeVector(s: []const u8, from: usize) usize {
+    const lanes = 16;
+    const V = @Vector(lanes, u8);
+    var i = from;
+    while (i + lanes <= s.len) : (i += lanes) {
+        const v: V = s[i..][0..lanes].*;
+        if (@reduce(.Or, v < @as(V, @splat(0x20))) or
+            @reduce(.Or, v == @as(V, @splat('"'))) or
+            @reduce(.Or, v == @as(V, @splat('\\')))) break;
+    }
+    return findEscapeScalar(s, i);
+}
+
+fn findEscapeWord(s: []const u8, from: usize) usize {
+    const ones: u64 = 0x0101010101010101;
+    const highs: u64 = 0x8080808080808080;
+    var i = from;
+    while (i + 8 <= s.len) : (i += 8) {
+        const x = std.mem.readInt(u64, s[i..][0..8], .little);
+        const quote = x ^ (ones * '"');
+        const backslash = x ^ (ones * '\\');
+        // High bit set in each byte below 0x20 / equal to zero
+        const control = (x -% ones * 0x20) & ~x;
+        const zero = ((quote -% ones) & ~quote) | ((backslash -% ones) & ~backslash);
+        if ((control | zero) & highs != 0) break;
+    }
+    return findEscapeScalar(s, i);
+}
+
+fn findEscapeScalar(s: []const u8, from: usize) usize {
+    for (s[from..], from..) |c, i| {
+        if (needsEscape(c)) return i;
+    }
+    return s.len;
+}
+
+// ============== Tests ==============
+
+const testing = std.testing;
+
+fn expectJson(expected: []const u8, value: anytype) !void {
+    var arena = OutputArena{};
+    defer arena.deinit();
+    var jw = JsonWriter{ .out = &arena };
+    jw.write(value);
+    try testing.expectEqualStrings(expected, arena.written());
+}
+
+test "JsonWriter omits null optional fields" {
+    const S = struct { id: u32, clear: ?bool = null, name: ?[]const u8 = null };
+    try expectJson("{\"id\":1}", S{ .id = 1 });
+    try expectJson("{\"id\":2,\"clear\":true,\"name\":\"x\"}", S{ .id = 2, .clear = true, .name = "x" });
+}
+
+test "JsonWriter writes nested arrays and enums" {
+    const Kind = enum { line, char };
+    const Inner = struct { kind: Kind, values: []const u32 };
+    const items = [_]Inner{ .{ .kind = .line, .values = &.{ 1, 2 } }, .{ .kind = .char, .values = &.{} } };
+    const Outer = struct { items: []const Inner };
+    try expectJson("{\"items\":[{\"kind\":\"line\",\"values\":[1,2]},{\"kind\":\"char\",\"values\":[]}]}", Outer{ .items = &items });
+}
+
+test "JsonWriter writes whole floats as integers" {
+    try expectJson("80", @as(f64, 80.0));
+    try expectJson("-3", @as(f64, -3.0));
+    try expectJson("12.5", @as(f64, 12.5));
+    try expectJson("null", std.math.nan(f64));
+}
+
+test "JsonWriter escapes strings" {
+    try expectJson("\"a\\\"b\\\\c\\nd\\u0001\"", @as([]const u8, "a\"b\\c\nd\x01"));
+    try expectJson("\"caf\xc3\xa9\"", @as([]const u8, "caf\xc3\xa9"));
+}
+
+test "escape scans find the first special byte at every offset" {
+    const specials = "\"\\\x00\x1f\n";
+    var buf: [40]u8 = undefined;
+    for (specials) |special| {
+        for (0..buf.len) |pos| {
+            @memset(&buf, 'a');
+            buf[pos] = special;
+            // Bytes that must not be mistaken for special ones
+            if (pos > 0) buf[pos - 1] = 0x7F;
+            if (pos + 1 < buf.len) buf[pos + 1] = 0xA2;
+            try testing.expectEqual(pos, findEscapeVector(&buf, 0));
+            try testing.expectEqual(pos, findEscapeWord(&buf, 0));
+            try testing.expectEqual(buf.len, findEscapeVector(&buf, pos + 1));
+            try testing.expectEqual(buf.len, findEscapeWord(&buf, pos + 1));
+        }
+    }
+}
+
+test "writeEscaped matches per-byte escaping on long text" {
+    var text: [300]u8 = undefined;
+    for (&text, 0..) |*c, i| c.* = @intCast((i * 37) % 128);
+
+    var arena = OutputArena{};
+    defer arena.deinit();
+    writeEscaped(&arena, &text);
+
+    var expected = OutputArena{};
+    defer expected.deinit();
+    for (text) |c| {
+        if (needsEscape(c)) appendEscape(&expected, c) else expected.appendByte(c);
+    }
+    try testing.expectEqualStrings(expected.written(), arena.written());
+}
+
+test "BinaryWriter fills in frame and record lengths" {
+    var arena = OutputArena{};
+    defer arena.deinit();
+    var bw = BinaryWriter{ .out = &arena };
+    bw.beginFrame();
+    bw.beginRecord(7);
+    bw.int(u16, 0x0102);
+    bw.string("hi");
+    bw.endRecord();
+    bw.endFrame();
+    try testing.expectEqualSlices(u8, &.{
+        0xFF, 13, 0, 0, 0, // Frame: marker, payload length
+        7, 8, 0, 0, 0, // Record: tag, body length
+        0x02, 0x01, // u16
+        2, 0, 0, 0, 'h', 'i', // string
+    }, arena.written());
+}
+
+test "OutputArena reuses capacity after warm-up" {
+    var arena = OutputArena{};
+    defer arena.deinit();
+    const line = "x" ** 1000;
+    arena.append(line);
+    arena.recordLine();
+    const grows = arena.grow_count;
+    for (0..100) |_| {
+        arena.reset();
+        arena.append(line);
+        arena.recordLine();
+    }
+    try testing.expectEqual(grows, arena.grow_count);
+    try testing.expectEqual(@as(u64, 101), arena.line_count);
+    try testing.expectEqual(@as(u64, 101000), arena.bytes_total);
+}
@@ -0,0 +1,29 @@
+// preinit.zig - Wizer entry points for pre-initialized interpreters
+//
+// Built only with -Dpreinit=true, which links interpreters as WASI reactors.
+// Wizer calls wizer.initialize once at build time (run.ts preinit). That runs
+// the C runtime and static constructors, which are the C++ interpreters'
+// biggest startup cost, and the memory it leaves behind is snapshotted into
+// the module. Wizer also renames wizer.resume to _start, so each session
+// starts at main with the constructors already run. Nothing session-specific
+// (arguments, the client's init message, the story file) is touched here.
+
+const std = @import("std");
+
+// Provided by wasi-libc: the reactor's constructor call and the argv-fetching
+// wrapper around main
+extern fn _initialize() callconv(.c) void;
+extern fn __main_void() callconv(.c) c_int;
+
+fn initialize() callconv(.c) void {
+    _initialize();
+}
+
+fn resumeMain() callconv(.c) noreturn {
+    std.c.exit(__main_void());
+}
+
+comptime {
+    @export(&initialize, .{ .name = "wizer.initialize" });
+    @export(&resumeMain, .{ .name = "wizer.resume" });
+}
@@ -3,6 +3,9 @@
 const std = @import("std");
 const types = @import("types.zig");
 const state = @import("state.zig");
+const output = @import("output.zig");
+const input = @import("input.zig");
+const graphics = @import("graphics.zig");
 
 const glui32 = types.glui32;
 const glsi32 = types.glsi32;
@@ -13,58 +16,29 @@ const allocator = state.allocator;
 // ============== I/O Helpers ==============
 
 pub fn writeStdout(data: []const u8) void {
-    _ = std.posix.write(std.posix.STDOUT_FILENO, data) catch {};
-}
-
-pub fn readLineFromStdin(buf: []u8) ?[]u8 {
-    var i: usize = 0;
-    while (i < buf.len) {
-        var byte: [1]u8 = undefined;
-        const n = std.posix.read(std.posix.STDIN_FILENO, &byte) catch return null;
-        if (n == 0) return null; // EOF
-        if (byte[0] == '\n') return buf[0..i];
-        buf[i] = byte[0];
-        i += 1;
+    // write() may accept fewer bytes than requested (pipes, WASI shims)
+    var remaining = data;
+    while (remaining.len > 0) {
+        const n = std.posix.write(std.posix.STDOUT_FILENO, remaining) catch return;
+        if (n == 0) return;
+        remaining = remaining[n..];
     }
-    return buf[0..i];
 }
 
-// ============== RemGlk Protocol Types ==============
+// Client events are read through a buffer that persists between calls
+pub var stdin_reader: input.LineReader = .{ .fd = std.posix.STDIN_FILENO };
 
-// Input event types (client -> interpreter)
-// Note: The 'value' field can be a string (for line/char input) or a number (for hyperlink events)
-// We use std.json.Value to handle both cases, then extract appropriately in parseInputEvent
-pub const InputEventRaw = struct {
-    type: []const u8,
-    gen: u32 = 0,
-    window: ?u32 = null,
-    value: ?std.json.Value = null, // Can be string (line/char/specialresponse) or integer (hyperlink)
-    metrics: ?Metrics = null,
-    support: ?[]const []const u8 = null, // Features the display supports
-    partial: ?std.json.Value = null,
-    // Mouse event coordinates
-    x: ?i32 = null,
-    y: ?i32 = null,
-    // Line input terminator (e.g., "escape", "func1")
-    terminator: ?[]const u8 = null,
-    // Special response type (e.g., "fileref_prompt")
-    response: ?[]const u8 = null,
-};
+// Read the next event line; the slice is valid until the next read
+pub fn readLineFromStdin() ?[]u8 {
+    return stdin_reader.readLine();
+}
 
-// Processed input event with typed value fields
-pub const InputEvent = struct {
-    type: []const u8,
-    gen: u32 = 0,
-    window: ?u32 = null,
-    value: ?[]const u8 = null, // String value for line/char input
-    linkval: ?u32 = null, // Numeric value for hyperlink events
-    metrics: ?Metrics = null,
-    // Mouse event coordinates
-    x: ?i32 = null,
-    y: ?i32 = null,
-    // Line input terminator
-    terminator: ?[]const u8 = null,
-};
+// ============== RemGlk Protocol Types ==============
+
+// Input events (client -> interpreter) are parsed by input.parseEvent
+pub const InputEvent = input.InputEvent;
+pub const EventType = input.EventType;
+pub const Terminator = input.Terminator;
 
 pub const Metrics = struct {
     // Overall dimensions
@@ -93,6 +67,22 @@ pub const Metrics = struct {
     graphicsmarginy: ?f64 = null,
 };
 
+/// Keep the metrics that layout uses from an init or arrange event
+pub fn storeMetrics(m: Metrics) void {
+    const metrics = &state.client_metrics;
+    if (m.width) |w| metrics.width = w;
+    if (m.height) |h| metrics.height = h;
+    // Cell sizes must be positive; the deprecated charwidth/charheight stand in
+    if (m.gridcharwidth orelse m.charwidth) |w| {
+        if (w > 0) metrics.gridcharwidth = w;
+    }
+    if (m.gridcharheight orelse m.charheight) |h| {
+        if (h > 0) metrics.gridcharheight = h;
+    }
+    if (m.gridmarginx) |x| metrics.gridmarginx = @max(0, x);
+    if (m.gridmarginy) |y| metrics.gridmarginy = @max(0, y);
+}
+
 // ============== Output Types (interpreter -> client) ==============
 // These structs match the GlkOte/RemGLK JSON schema for proper serialization
 
@@ -141,36 +131,9 @@ pub const ImageSpan = struct {
     height: ?u32 = null,
 };
 
-// Content span can be text or special (image)
-// Using tagged union for proper JSON serialization
-pub const ContentSpan = union(enum) {
-    text: TextSpan,
-    image: ImageSpan,
-
-    pub fn jsonStringify(self: @This(), jw: anytype) !void {
-        switch (self) {
-            .text => |t| try jw.write(t),
-            .image => |i| try jw.write(i),
-        }
-    }
-};
-
-// Text paragraph in buffer window content (GlkOte spec)
-pub const TextParagraph = struct {
-    append: ?bool = null,
-    flowbreak: ?bool = null,
-    content: ?[]const ContentSpan = null,
-};
-
-// Grid line in grid window content (GlkOte spec)
-pub const GridLine = struct {
-    line: u32,
-    content: ?[]const ContentSpan = null,
-};
-
 // Draw operation for graphics windows (GlkOte spec)
 pub const DrawOp = struct {
-    special: []const u8, // "fill", "image", "setcolor"
+    special: []const u8, // "fill", "image", "setcolor", "raster"
     color: ?[]const u8 = null, // CSS hex color like "#RRGGBB"
     image: ?u32 = null,
     alignment: ?[]const u8 = null,
@@ -178,22 +141,8 @@ pub const DrawOp = struct {
     y: ?i32 = null,
     width: ?u32 = null,
     height: ?u32 = null,
-};
-
-// Content update - can have text (buffer), lines (grid), or draw (graphics)
-pub const ContentUpdateJson = struct {
-    id: u32,
-    clear: ?bool = null,
-    text: ?[]const TextParagraph = null, // Buffer windows
-    lines: ?[]const GridLine = null, // Grid windows
-    draw: ?[]const DrawOp = null, // Graphics windows
-};
-
-// Legacy content update (kept for compatibility during refactor)
-pub const ContentUpdate = struct {
-    id: u32,
-    clear: ?bool = null,
-    text: ?[]const u8 = null,
+    // Raster pixels row by row as (count, 0xAARRGGBB) pairs; alpha 0 = unchanged
+    runs: ?[]const u32 = null,
 };
 
 // Maximum terminators we track per input request
@@ -243,20 +192,6 @@ pub const InputRequest = struct {
     }
 };
 
-// Timer value wrapper - allows distinguishing between "not set" and "set to null"
-pub const TimerValue = union(enum) {
-    interval: u32, // Timer active with this interval
-    cancelled: void, // Timer cancelled (serialize as null)
-
-    // Custom JSON formatting
-    pub fn jsonStringify(self: @This(), jw: anytype) !void {
-        switch (self) {
-            .interval => |val| try jw.write(val),
-            .cancelled => try jw.write(null),
-        }
-    }
-};
-
 // Special input request for file dialogs (GlkOte spec)
 pub const SpecialInput = struct {
     type: []const u8 = "fileref_prompt",
@@ -265,20 +200,6 @@ pub const SpecialInput = struct {
     gameid: ?[]const u8 = null, // Optional game ID for filtering saves
 };
 
-// Full state update message (GlkOte spec)
-pub const StateUpdateJson = struct {
-    type: []const u8 = "update",
-    gen: u32,
-    windows: ?[]const WindowUpdate = null,
-    content: ?[]const ContentUpdateJson = null,
-    input: ?[]const InputRequestJson = null,
-    specialinput: ?SpecialInput = null, // File dialog request (GlkOte spec)
-    timer: ?TimerValue = null, // Timer interval or null to cancel (omit if not changed)
-    disable: ?bool = null, // true when no input expected
-    exit: ?bool = null, // true when game exits
-    debugoutput: ?[]const []const u8 = null, // Debug messages
-};
-
 const ErrorResponse = struct {
     type: []const u8 = "error",
     message: []const u8,
@@ -287,171 +208,227 @@ const ErrorResponse = struct {
 // ============== Protocol State ==============
 
 pub var generation: u32 = 0;
-pub var pending_windows: [16]WindowUpdate = undefined;
-pub var pending_windows_len: usize = 0;
-pub var pending_content: [64]ContentUpdate = undefined;
-pub var pending_content_len: usize = 0;
+pub var windows_changed: bool = false; // Resend the window list in the next update
 pub var pending_input: [8]InputRequest = undefined;
 pub var pending_input_len: usize = 0;
 pub var pending_timer: ?glui32 = null; // Timer interval to include in next update
 pub var pending_timer_set: bool = false; // Whether timer field should be included
 pub var pending_exit: bool = false; // Whether to include exit: true
+pub var pending_special: ?SpecialInput = null; // File dialog request for the next update
 // Debug output messages (per GlkOte spec: debugoutput array in updates)
 pub var pending_debug: [16][256]u8 = undefined;
 pub var pending_debug_lens: [16]usize = .{0} ** 16;
 pub var pending_debug_count: usize = 0;
 
-// ============== JSON Protocol Functions ==============
+// ============== Turn Content ==============
+// Everything a window receives during one turn is collected here and sent as
+// a single "content" entry by the next sendUpdate (at glk_select/glk_exit).
+// Lists are cleared but keep their capacity, so steady-state turns do not
+// allocate.
+
+const PendingSpan = struct {
+    kind: enum { text, image },
+    // Text spans: byte range in turn_text
+    text_start: u32 = 0,
+    text_len: u32 = 0,
+    style: glui32 = 0,
+    hyperlink: glui32 = 0,
+    // Image spans
+    image: glui32 = 0,
+    alignment: glsi32 = 0,
+    width: glui32 = 0,
+    height: glui32 = 0,
+};
 
-fn writeJson(value: anytype) void {
-    var buf: [16384]u8 = undefined;
-    const slice = std.fmt.bufPrint(&buf, "{f}", .{std.json.fmt(value, .{})}) catch return;
-    writeStdout(slice);
-    writeStdout("\n");
-}
-
-pub fn parseInputEvent(json_str: []const u8) ?InputEvent {
-    const parsed = std.json.parseFromSlice(InputEventRaw, allocator, json_str, .{
-        .ignore_unknown_fields = true,
-    }) catch return null;
-    defer parsed.deinit();
-
-    // Extract value based on its type:
-    // - String: line/char input value
-    // - Integer: hyperlink link value
-    var string_value: ?[]const u8 = null;
-    var link_value: ?u32 = null;
-
-    if (parsed.value.value) |v| {
-        switch (v) {
-            .string => |s| {
-                string_value = allocator.dupe(u8, s) catch null;
-            },
-            .integer => |i| {
-                if (i >= 0 and i <= std.math.maxInt(u32)) {
-                    link_value = @intCast(i);
-                }
-            },
-            else => {},
-        }
-    }
+const PendingParagraph = struct {
+    append: bool = false,
+    flowbreak: bool = false,
+    // Span range in the window's span list
+    span_start: u32,
+    span_end: u32,
+};
 
-    // Process partial field - copy partial input text to windows' line buffers
-    // Partial is an object like {"1": "hello", "2": "world"} where keys are window IDs
-    if (parsed.value.partial) |partial_val| {
-        if (partial_val == .object) {
-            var iter = partial_val.object.iterator();
-            while (iter.next()) |entry| {
-                // Parse window ID from key
-                const win_id = std.fmt.parseInt(u32, entry.key_ptr.*, 10) catch continue;
-                // Get partial text value
-                const partial_text = if (entry.value_ptr.* == .string)
-                    entry.value_ptr.string
-                else
-                    continue;
-
-                // Find window and copy partial text to its line buffer
-                var win = state.window_list;
-                while (win) |w| : (win = w.next) {
-                    if (w.id == win_id and w.line_request and w.line_buffer != null) {
-                        // Copy partial text to line buffer
-                        const max_copy = if (w.line_buflen > 0) w.line_buflen - 1 else 0;
-                        const copy_len: glui32 = @intCast(@min(partial_text.len, max_copy));
-                        if (copy_len > 0) {
-                            @memcpy(w.line_buffer.?[0..copy_len], partial_text[0..copy_len]);
-                        }
-                        // Store partial length for glk_cancel_line_event
-                        w.line_partial_len = copy_len;
-                        break;
-                    }
-                }
-            }
-        }
+const PendingDrawOp = struct {
+    kind: enum { fill, erase, setcolor, image, raster },
+    color: glui32 = 0,
+    image: glui32 = 0,
+    x: glsi32 = 0,
+    y: glsi32 = 0,
+    width: glui32 = 0,
+    height: glui32 = 0,
+    // Raster ops: range in turn_runs
+    runs_start: u32 = 0,
+    runs_len: u32 = 0,
+};
+
+const PendingContent = struct {
+    id: u32 = 0,
+    clear: bool = false,
+    paragraphs: std.ArrayListUnmanaged(PendingParagraph) = .empty,
+    spans: std.ArrayListUnmanaged(PendingSpan) = .empty,
+    draw: std.ArrayListUnmanaged(PendingDrawOp) = .empty,
+
+    fn reset(self: *PendingContent, id: u32) void {
+        self.id = id;
+        self.clear = false;
+        self.paragraphs.clearRetainingCapacity();
+        self.spans.clearRetainingCapacity();
+        self.draw.clearRetainingCapacity();
     }
+};
 
-    // Copy to avoid lifetime issues
-    return InputEvent{
-        .type = allocator.dupe(u8, parsed.value.type) catch return null,
-        .gen = parsed.value.gen,
-        .window = parsed.value.window,
-        .value = string_value,
-        .linkval = link_value,
-        .metrics = parsed.value.metrics,
-        .x = parsed.value.x,
-        .y = parsed.value.y,
-        .terminator = if (parsed.value.terminator) |t| allocator.dupe(u8, t) catch null else null,
-    };
+// Entries [0, pending_content_len) are live; later entries are kept for reuse
+var pending_content: std.ArrayListUnmanaged(PendingContent) = .empty;
+var pending_content_len: usize = 0;
+// Index of the entry contentFor returned last
+var last_content: usize = 0;
+// Text bytes referenced by PendingSpan.text_start/text_len
+var turn_text: std.ArrayListUnmanaged(u8) = .empty;
+// Raster runs referenced by PendingDrawOp.runs_start/runs_len
+var turn_runs: std.ArrayListUnmanaged(u32) = .empty;
+
+// Output arena shared by every message; grows to the largest update and is reused
+pub var output_arena: output.OutputArena = .{};
+
+// ============== JSON Protocol Functions ==============
+
+// Serialize a message into the output arena and write it to stdout as one line.
+// Null optional fields are omitted.
+fn writeJson(value: anytype) void {
+    output_arena.reset();
+    var jw = output.JsonWriter{ .out = &output_arena };
+    jw.write(value);
+    writeLine();
 }
 
-pub fn sendUpdate() void {
-    // Build arrays for JSON serialization
-    // Input requests - convert to JSON-serializable format
-    var input_json: [8]InputRequestJson = undefined;
-    for (pending_input[0..pending_input_len], 0..) |req, i| {
-        input_json[i] = req.toJson();
-    }
+// Terminate the message in the output arena and write it to stdout
+fn writeLine() void {
+    output_arena.appendByte('\n');
+    if (output_arena.failed) return;
+    output_arena.recordLine();
+    writeStdout(output_arena.written());
+}
 
-    // Content updates - convert legacy content to JSON format
-    var content_json: [64]ContentUpdateJson = undefined;
-    for (pending_content[0..pending_content_len], 0..) |c, i| {
-        // For clear-only updates (no text), use the JSON struct directly
-        // For text content, we'd need to build a paragraph structure - but that's
-        // only used by flushTextBuffer for non-buffer windows, which is legacy
-        content_json[i] = .{
-            .id = c.id,
-            .clear = c.clear,
-            // Legacy text field not supported in struct serialization
-            // All text content now goes through sendContentUpdate directly
-        };
-    }
+// Report output and allocation counters on stderr when WASIGLK_STATS is set.
+// Used by tests/bench.ts; the RemGlk stdout stream is never touched.
+pub fn reportStats() void {
+    if (std.c.getenv("WASIGLK_STATS") == null) return;
+    const pool_hits = state.window_pool.hits + state.stream_pool.hits + state.fileref_pool.hits;
+    const pool_misses = state.window_pool.misses + state.stream_pool.misses + state.fileref_pool.misses;
+    var buf: [512]u8 = undefined;
+    const line = std.fmt.bufPrint(&buf, "wasiglk-stats: updates={d} bytes={d} events={d} reads={d} allocs={d} frees={d} arena_grows={d} arena_capacity={d} pool_hits={d} pool_misses={d}\n", .{
+        output_arena.line_count,
+        output_arena.bytes_total,
+        stdin_reader.line_count,
+        stdin_reader.read_count,
+        state.alloc_stats.allocs,
+        state.alloc_stats.frees,
+        output_arena.grow_count,
+        output_arena.capacity(),
+        pool_hits,
+        pool_misses,
+    }) catch return;
+    _ = std.posix.write(std.posix.STDERR_FILENO, line) catch {};
+}
 
-    // Debug output - collect slices
-    var debug_slices: [16][]const u8 = undefined;
-    for (0..pending_debug_count) |i| {
-        debug_slices[i] = pending_debug[i][0..pending_debug_lens[i]];
+// Parse an event line (modified in place; see input.parseEvent) and apply
+// any partial line input it carries
+pub fn parseInputEvent(line: []u8) ?InputEvent {
+    const event = input.parseEvent(line) orelse return null;
+
+    // Copy partial input text to windows' line buffers
+    for (event.partials()) |partial| {
+        const w = state.windows.get(partial.window) orelse continue;
+        if (w.line_request and w.line_buffer != null) {
+            const max_copy = if (w.line_buflen > 0) w.line_buflen - 1 else 0;
+            const copy_len: glui32 = @intCast(@min(partial.text.len, max_copy));
+            if (copy_len > 0) {
+                @memcpy(w.line_buffer.?[0..copy_len], partial.text[0..copy_len]);
+            }
+            // Store partial length for glk_cancel_line_event
+            w.line_partial_len = copy_len;
+        }
     }
 
-    // Build timer value if set
-    const timer_val: ?TimerValue = if (pending_timer_set)
-        (if (pending_timer) |interval| TimerValue{ .interval = interval } else TimerValue{ .cancelled = {} })
-    else
-        null;
-
-    // Build the full update struct
-    const update = StateUpdateJson{
-        .gen = generation,
-        .windows = if (pending_windows_len > 0) pending_windows[0..pending_windows_len] else null,
-        .content = if (pending_content_len > 0) content_json[0..pending_content_len] else null,
-        .input = if (pending_input_len > 0) input_json[0..pending_input_len] else null,
-        .timer = timer_val,
-        .disable = if (pending_input_len == 0) true else null,
-        .exit = if (pending_exit) true else null,
-        .debugoutput = if (pending_debug_count > 0) debug_slices[0..pending_debug_count] else null,
-    };
+    return event;
+}
 
-    // Serialize with emit_null_optional_fields = false to omit null fields
-    var buf: [32768]u8 = undefined;
-    const json = std.fmt.bufPrint(&buf, "{f}", .{std.json.fmt(update, .{ .emit_null_optional_fields = false })}) catch return;
-    writeStdout(json);
-    writeStdout("\n");
+pub fn sendUpdate() void {
+    output_arena.reset();
+    if (state.client_support.binary) writeBinaryUpdate() else writeJsonUpdate();
 
     // Reset pending state
-    pending_windows_len = 0;
+    windows_changed = false;
     pending_content_len = 0;
+    turn_text.clearRetainingCapacity();
+    turn_runs.clearRetainingCapacity();
     pending_input_len = 0;
     pending_timer = null;
     pending_timer_set = false;
     pending_exit = false;
+    pending_special = null;
     pending_debug_count = 0;
     generation += 1;
 }
 
+fn writeJsonUpdate() void {
+    var jw = output.JsonWriter{ .out = &output_arena };
+    jw.beginObject();
+    jw.field("type");
+    jw.string("update");
+    jw.field("gen");
+    jw.int(generation);
+    if (windows_changed) {
+        jw.field("windows");
+        writeWindows(&jw);
+    }
+    if (pending_content_len > 0) {
+        jw.field("content");
+        writeContent(&jw);
+    }
+    if (pending_input_len > 0) {
+        jw.field("input");
+        jw.beginArray();
+        for (pending_input[0..pending_input_len]) |*req| jw.write(req.toJson());
+        jw.endArray();
+    }
+    if (pending_special) |special| {
+        jw.field("specialinput");
+        jw.write(special);
+    }
+    // Timer interval, or null to cancel (omitted if not changed)
+    if (pending_timer_set) {
+        jw.field("timer");
+        if (pending_timer) |interval| jw.int(interval) else jw.nullValue();
+    }
+    if (pending_input_len == 0) {
+        jw.field("disable");
+        jw.boolean(true);
+    }
+    if (pending_exit) {
+        jw.field("exit");
+        jw.boolean(true);
+    }
+    if (pending_debug_count > 0) {
+        jw.field("debugoutput");
+        jw.beginArray();
+        for (0..pending_debug_count) |i| jw.string(pending_debug[i][0..pending_debug_lens[i]]);
+        jw.endArray();
+    }
+    jw.endObject();
+    writeLine();
+}
+
 pub fn sendError(message: []const u8) void {
     writeJson(ErrorResponse{ .message = message });
 }
 
-pub fn queueWindowUpdate(win: *WindowData) void {
-    if (pending_windows_len >= pending_windows.len) return;
+// Send the full window list in the next update
+pub fn queueWindowsUpdate() void {
+    windows_changed = true;
+}
+
+fn windowUpdateFor(win: *const WindowData) WindowUpdate {
     const wtype: WindowType = switch (win.win_type) {
         wintype.TextBuffer => .buffer,
         wintype.TextGrid => .grid,
@@ -463,14 +440,7 @@ pub fn queueWindowUpdate(win: *WindowData) void {
     const width = win.layout_width;
     const height = win.layout_height;
 
-    // For grid windows, calculate character cell dimensions
-    // Using gridcharwidth/gridcharheight if available, fallback to 1 char = 1 pixel
-    const grid_char_w: u32 = 1; // TODO: use actual metrics
-    const grid_char_h: u32 = 1;
-    const grid_width: u32 = if (width > 0) @intFromFloat(width / @as(f64, @floatFromInt(grid_char_w))) else 80;
-    const grid_height: u32 = if (height > 0) @intFromFloat(height / @as(f64, @floatFromInt(grid_char_h))) else 24;
-
-    pending_windows[pending_windows_len] = .{
+    return .{
         .id = win.id,
         .type = wtype,
         .rock = win.rock,
@@ -478,24 +448,561 @@ pub fn queueWindowUpdate(win: *WindowData) void {
         .top = win.layout_top,
         .width = width,
         .height = height,
-        // Grid windows: dimensions in character cells
-        .gridwidth = if (wtype == .grid) grid_width else null,
-        .gridheight = if (wtype == .grid) grid_height else null,
+        // Grid windows: dimensions in character cells (the size of the cell storage)
+        .gridwidth = if (wtype == .grid) win.grid_width else null,
+        .gridheight = if (wtype == .grid) win.grid_height else null,
         // Graphics windows: canvas dimensions in pixels
         .graphwidth = if (wtype == .graphics) @as(u32, @intFromFloat(width)) else null,
         .graphheight = if (wtype == .graphics) @as(u32, @intFromFloat(height)) else null,
     };
-    pending_windows_len += 1;
 }
 
-pub fn queueContentUpdate(win_id: u32, text: ?[]const u8, clear: bool) void {
-    if (pending_content_len >= pending_content.len) return;
-    pending_content[pending_content_len] = .{
-        .id = win_id,
-        .clear = if (clear) true else null,
-        .text = text,
-    };
+// All non-pair windows, in window list order
+fn writeWindows(jw: *output.JsonWriter) void {
+    jw.beginArray();
+    var win = state.window_list;
+    while (win) |w| : (win = w.next) {
+        if (w.win_type != wintype.Pair) jw.write(windowUpdateFor(w));
+    }
+    jw.endArray();
+}
+
+fn writeContent(jw: *output.JsonWriter) void {
+    jw.beginArray();
+    for (pending_content.items[0..pending_content_len]) |*c| {
+        jw.beginObject();
+        jw.field("id");
+        jw.int(c.id);
+        if (c.clear) {
+            jw.field("clear");
+            jw.boolean(true);
+        }
+        if (c.paragraphs.items.len > 0) {
+            jw.field("text");
+            writeParagraphs(jw, c);
+        }
+        if (c.draw.items.len > 0) {
+            compactDrawOps(&c.draw, if (state.windows.get(c.id)) |w| graphicsBounds(w) else null);
+            jw.field("draw");
+            writeDrawOps(jw, c.draw.items);
+        }
+        if (state.windows.get(c.id)) |w| {
+            if (w.win_type == wintype.TextGrid and gridHasDirtyLines(w)) {
+                jw.field("lines");
+                writeGridLines(jw, w);
+            }
+        }
+        jw.endObject();
+    }
+    jw.endArray();
+}
+
+fn writeParagraphs(jw: *output.JsonWriter, c: *const PendingContent) void {
+    jw.beginArray();
+    for (c.paragraphs.items) |para| {
+        jw.beginObject();
+        if (para.append) {
+            jw.field("append");
+            jw.boolean(true);
+        }
+        if (para.flowbreak) {
+            jw.field("flowbreak");
+            jw.boolean(true);
+        }
+        if (para.span_end > para.span_start) {
+            jw.field("content");
+            jw.beginArray();
+            for (c.spans.items[para.span_start..para.span_end]) |span| writeSpan(jw, span);
+            jw.endArray();
+        }
+        jw.endObject();
+    }
+    jw.endArray();
+}
+
+fn writeSpan(jw: *output.JsonWriter, span: PendingSpan) void {
+    switch (span.kind) {
+        .text => jw.write(TextSpan{
+            .style = styleToString(span.style),
+            .text = turn_text.items[span.text_start..][0..span.text_len],
+            .hyperlink = if (span.hyperlink != 0) span.hyperlink else null,
+        }),
+        .image => jw.write(ImageSpan{
+            .image = span.image,
+            .alignment = alignmentToString(span.alignment),
+            .width = span.width,
+            .height = span.height,
+        }),
+    }
+}
+
+// Uses "draw" array with "special" as string value per GlkOte spec
+fn writeDrawOps(jw: *output.JsonWriter, ops: []const PendingDrawOp) void {
+    jw.beginArray();
+    for (ops) |op| {
+        var color_buf: [8]u8 = undefined;
+        jw.write(switch (op.kind) {
+            .fill => DrawOp{ .special = "fill", .color = formatColorHex(&color_buf, op.color), .x = op.x, .y = op.y, .width = op.width, .height = op.height },
+            // Fill without a color uses the window background
+            .erase => DrawOp{ .special = "fill", .x = op.x, .y = op.y, .width = op.width, .height = op.height },
+            .setcolor => DrawOp{ .special = "setcolor", .color = formatColorHex(&color_buf, op.color) },
+            .image => DrawOp{ .special = "image", .image = op.image, .x = op.x, .y = op.y, .width = op.width, .height = op.height },
+            .raster => DrawOp{ .special = "raster", .x = op.x, .y = op.y, .width = op.width, .height = op.height, .runs = turn_runs.items[op.runs_start..][0..op.runs_len] },
+        });
+    }
+    jw.endArray();
+}
+
+// ============== Binary Update Encoding ==============
+//
+// Clients that list "binary" in the init support array receive updates as
+// binary frames instead of JSON lines (see output.BinaryWriter for framing).
+// A frame carries the same information as the JSON update, as typed records
+// in this order:
+//
+//   update        gen u32, flags u8 (BinaryFlags), timer u32 (0 = cancel)
+//   window*       id u32, type u8 (WindowType), rock u32, left/top/width/height
+//                 f64, gridwidth/gridheight or graphwidth/graphheight u32
+//   content*      id u32, clear u8; followed by its paragraphs, draw ops and
+//                 grid lines
+//     paragraph   flags u8 (1 append, 2 flowbreak); followed by its spans
+//     text        style u8, hyperlink u32 (0 = none), text string
+//     image       image u32, alignment u8, width u32, height u32
+//     draw        op u8 (BinaryDrawOp), color u32 (0xRRGGBB), image u32,
+//                 x i32, y i32, width u32, height u32, run count u32, runs u32*
+//     line        line u32; followed by its text spans
+//   input*        id u32, type u8 (TextInputType), gen u32, flags u8
+//                 (BinaryInputFlags), xpos u32, ypos u32, initial string,
+//                 terminator count u8, terminator strings
+//   specialinput  type, filemode, filetype strings
+//   debug*        message string
+//
+// Text and image spans belong to the paragraph or grid line before them.
+
+pub const BinaryRecord = enum(u8) {
+    update = 1,
+    window = 2,
+    content = 3,
+    paragraph = 4,
+    text = 5,
+    image = 6,
+    draw = 7,
+    line = 8,
+    input = 9,
+    specialinput = 10,
+    debug = 11,
+};
+
+pub const BinaryFlags = struct {
+    pub const disable: u8 = 1;
+    pub const exit: u8 = 2;
+    pub const windows: u8 = 4; // Window records follow (possibly none)
+    pub const timer: u8 = 8; // The timer field is set
+};
+
+pub const BinaryDrawOp = enum(u8) { fill, erase, setcolor, image, raster };
+
+pub const BinaryInputFlags = struct {
+    pub const mouse: u8 = 1;
+    pub const hyperlink: u8 = 2;
+    pub const position: u8 = 4; // xpos/ypos are set
+};
+
+fn writeBinaryUpdate() void {
+    var bw = output.BinaryWriter{ .out = &output_arena };
+    bw.beginFrame();
+
+    var flags: u8 = 0;
+    if (pending_input_len == 0) flags |= BinaryFlags.disable;
+    if (pending_exit) flags |= BinaryFlags.exit;
+    if (windows_changed) flags |= BinaryFlags.windows;
+    if (pending_timer_set) flags |= BinaryFlags.timer;
+    bw.beginRecord(@intFromEnum(BinaryRecord.update));
+    bw.int(u32, generation);
+    bw.int(u8, flags);
+    bw.int(u32, pending_timer orelse 0);
+    bw.endRecord();
+
+    if (windows_changed) {
+        var win = state.window_list;
+        while (win) |w| : (win = w.next) {
+            if (w.win_type != wintype.Pair) writeBinaryWindow(&bw, windowUpdateFor(w));
+        }
+    }
+    for (pending_content.items[0..pending_content_len]) |*c| writeBinaryContent(&bw, c);
+    for (pending_input[0..pending_input_len]) |*req| writeBinaryInput(&bw, req);
+    if (pending_special) |special| {
+        bw.beginRecord(@intFromEnum(BinaryRecord.specialinput));
+        bw.string(special.type);
+        bw.string(special.filemode);
+        bw.string(special.filetype);
+        bw.endRecord();
+    }
+    for (0..pending_debug_count) |i| {
+        bw.beginRecord(@intFromEnum(BinaryRecord.debug));
+        bw.string(pending_debug[i][0..pending_debug_lens[i]]);
+        bw.endRecord();
+    }
+
+    bw.endFrame();
+    if (output_arena.failed) return;
+    output_arena.recordLine();
+    writeStdout(output_arena.written());
+}
+
+fn writeBinaryWindow(bw: *output.BinaryWriter, w: WindowUpdate) void {
+    bw.beginRecord(@intFromEnum(BinaryRecord.window));
+    bw.int(u32, w.id);
+    bw.int(u8, @intFromEnum(w.type));
+    bw.int(u32, w.rock);
+    bw.float(w.left);
+    bw.float(w.top);
+    bw.float(w.width);
+    bw.float(w.height);
+    bw.int(u32, w.gridwidth orelse w.graphwidth orelse 0);
+    bw.int(u32, w.gridheight orelse w.graphheight orelse 0);
+    bw.endRecord();
+}
+
+fn writeBinaryContent(bw: *output.BinaryWriter, c: *PendingContent) void {
+    bw.beginRecord(@intFromEnum(BinaryRecord.content));
+    bw.int(u32, c.id);
+    bw.int(u8, @intFromBool(c.clear));
+    bw.endRecord();
+
+    for (c.paragraphs.items) |para| {
+        bw.beginRecord(@intFromEnum(BinaryRecord.paragraph));
+        bw.int(u8, @as(u8, @intFromBool(para.append)) | @as(u8, @intFromBool(para.flowbreak)) << 1);
+        bw.endRecord();
+        for (c.spans.items[para.span_start..para.span_end]) |span| writeBinarySpan(bw, span);
+    }
+
+    if (c.draw.items.len > 0) {
+        compactDrawOps(&c.draw, if (state.windows.get(c.id)) |w| graphicsBounds(w) else null);
+        for (c.draw.items) |op| {
+            const runs = if (op.kind == .raster) turn_runs.items[op.runs_start..][0..op.runs_len] else &[_]u32{};
+            const kind: BinaryDrawOp = switch (op.kind) {
+                .fill => .fill,
+                .erase => .erase,
+                .setcolor => .setcolor,
+                .image => .image,
+                .raster => .raster,
+            };
+            bw.beginRecord(@intFromEnum(BinaryRecord.draw));
+            bw.int(u8, @intFromEnum(kind));
+            bw.int(u32, op.color & 0xFFFFFF);
+            bw.int(u32, op.image);
+            bw.int(i32, op.x);
+            bw.int(i32, op.y);
+            bw.int(u32, op.width);
+            bw.int(u32, op.height);
+            bw.int(u32, @intCast(runs.len));
+            for (runs) |r| bw.int(u32, r);
+            bw.endRecord();
+        }
+    }
+
+    if (state.windows.get(c.id)) |w| {
+        if (w.win_type == wintype.TextGrid and gridHasDirtyLines(w)) writeBinaryGridLines(bw, w);
+    }
+}
+
+fn writeBinarySpan(bw: *output.BinaryWriter, span: PendingSpan) void {
+    switch (span.kind) {
+        .text => writeBinaryText(bw, span.style, span.hyperlink, turn_text.items[span.text_start..][0..span.text_len]),
+        .image => {
+            bw.beginRecord(@intFromEnum(BinaryRecord.image));
+            bw.int(u32, span.image);
+            bw.int(u8, @intCast(std.math.clamp(span.alignment, 0, 0xFF)));
+            bw.int(u32, span.width);
+            bw.int(u32, span.height);
+            bw.endRecord();
+        },
+    }
+}
+
+fn writeBinaryText(bw: *output.BinaryWriter, style: glui32, hyperlink: glui32, text: []const u8) void {
+    bw.beginRecord(@intFromEnum(BinaryRecord.text));
+    bw.int(u8, @intCast(@min(style, 0xFF)));
+    bw.int(u32, hyperlink);
+    bw.string(text);
+    bw.endRecord();
+}
+
+// Binary counterpart of writeGridLines
+fn writeBinaryGridLines(bw: *output.BinaryWriter, win: *WindowData) void {
+    const cells = win.grid_cells orelse return;
+    const dirty = win.grid_dirty orelse return;
+
+    for (0..win.grid_height) |row| {
+        if (dirty[row].isEmpty()) continue;
+        const line = cells[row * win.grid_width ..][0..win.grid_width];
+
+        bw.beginRecord(@intFromEnum(BinaryRecord.line));
+        bw.int(u32, @intCast(row));
+        bw.endRecord();
+        const line_end = gridLineEnd(line);
+        var start: usize = 0;
+        while (start < line_end) {
+            const style = line[start].style;
+            var stop = start + 1;
+            while (stop < line_end and line[stop].style == style) stop += 1;
+            grid_text.clearRetainingCapacity();
+            for (line[start..stop]) |cell| appendUtf8(&grid_text, cell.ch);
+            writeBinaryText(bw, style, 0, grid_text.items);
+            start = stop;
+        }
+        markGridLineSent(win, row);
+    }
+}
+
+fn writeBinaryInput(bw: *output.BinaryWriter, req: *const InputRequest) void {
+    var flags: u8 = 0;
+    if (req.mouse orelse false) flags |= BinaryInputFlags.mouse;
+    if (req.hyperlink orelse false) flags |= BinaryInputFlags.hyperlink;
+    if (req.xpos != null and req.ypos != null) flags |= BinaryInputFlags.position;
+
+    bw.beginRecord(@intFromEnum(BinaryRecord.input));
+    bw.int(u32, req.id);
+    bw.int(u8, @intFromEnum(req.type));
+    bw.int(u32, req.gen orelse 0);
+    bw.int(u8, flags);
+    bw.int(u32, req.xpos orelse 0);
+    bw.int(u32, req.ypos orelse 0);
+    bw.string(req.initial orelse "");
+    bw.int(u8, @intCast(req.terminators_count));
+    for (req.terminators_data[0..req.terminators_count]) |t| bw.string(t);
+    bw.endRecord();
+}
+
+// ============== Display List Compaction ==============
+//
+// A graphics window's draw ops for the turn are compacted before sending:
+// background colour changes only go out when they lead the list (as after a
+// clear) or an erase needs them, and once more at the end if the background
+// changed. Runs of same-colour fills that tile a rectangle become one fill,
+// and ops hidden under a later fill or erase are dropped. Games that clear
+// and redraw the whole canvas every frame send only the final frame.
+
+// Later opaque ops remembered when looking for hidden ones
+const max_covers = 32;
+
+fn compactDrawOps(ops: *std.ArrayListUnmanaged(PendingDrawOp), bounds: ?state.PixelRect) void {
+    var out: usize = 0;
+    var sent_color: ?glui32 = null; // Background as the client will have it
+    var pending_color: ?glui32 = null;
+    const items = ops.items;
+    for (items) |op| {
+        switch (op.kind) {
+            // A leading setcolor (as queueClear leaves) goes out first
+            .setcolor => if (out > 0 or sent_color != null or pending_color != null) {
+                pending_color = op.color;
+                continue;
+            } else {
+                sent_color = op.color;
+            },
+            .erase => if (pending_color) |color| {
+                if (color != sent_color) {
+                    items[out] = .{ .kind = .setcolor, .color = color };
+                    out += 1;
+                    sent_color = color;
+                }
+                pending_color = null;
+            },
+            .fill => if (out > 0 and mergeFills(&items[out - 1], op)) continue,
+            .image, .raster => {},
+        }
+        items[out] = op;
+        out += 1;
+    }
+    // Setcolors are only ever dropped (never added), so there is room for one
+    if (pending_color) |color| {
+        if (color != sent_color) {
+            items[out] = .{ .kind = .setcolor, .color = color };
+            out += 1;
+        }
+    }
+
+    // Walk backwards dropping ops inside a later fill or erase
+    var covers: [max_covers]OpRect = undefined;
+    var cover_count: usize = 0;
+    var keep = out;
+    var i = out;
+    while (i > 0) {
+        i -= 1;
+        const op = items[i];
+        if (op.kind == .setcolor) {
+            keep -= 1;
+            items[keep] = op;
+            continue;
+        }
+        const rect = drawOpRect(op, bounds);
+        const hidden = for (covers[0..cover_count]) |cover| {
+            if (rectContains(cover, rect)) break true;
+        } else false;
+        if (hidden) continue;
+        if ((op.kind == .fill or op.kind == .erase) and cover_count < max_covers) {
+            covers[cover_count] = rect;
+            cover_count += 1;
+        }
+        keep -= 1;
+        items[keep] = op;
+    }
+    std.mem.copyForwards(PendingDrawOp, items[0 .. out - keep], items[keep..out]);
+    ops.items.len = out - keep;
+}
+
+// Extend `last` with `next` if both are fills of one colour that together
+// form a rectangle. Edges are compared in i64 (as in drawOpRect), and fills
+// whose combined size would not fit a glui32 are left apart.
+fn mergeFills(last: *PendingDrawOp, next: PendingDrawOp) bool {
+    if (last.kind != .fill or last.color != next.color) return false;
+    if (last.y == next.y and last.height == next.height and @as(i64, last.x) + last.width == next.x) {
+        last.width = std.math.add(glui32, last.width, next.width) catch return false;
+        return true;
+    }
+    if (last.x == next.x and last.width == next.width and @as(i64, last.y) + last.height == next.y) {
+        last.height = std.math.add(glui32, last.height, next.height) catch return false;
+        return true;
+    }
+    return false;
+}
+
+// Pixel area of a graphics window, if known
+fn graphicsBounds(win: *const WindowData) ?state.PixelRect {
+    if (win.win_type != wintype.Graphics) return null;
+    if (win.gfx_pixels != null) return .{ .x1 = win.gfx_width, .y1 = win.gfx_height };
+    if (win.layout_width < 1 or win.layout_height < 1) return null;
+    return .{ .x1 = @intFromFloat(win.layout_width), .y1 = @intFromFloat(win.layout_height) };
+}
+
+// An op's rectangle, clipped to the window when its size is known. Signed
+// coordinates are kept in an i64 box so off-window parts compare correctly.
+const OpRect = struct { x0: i64, y0: i64, x1: i64, y1: i64 };
+
+fn drawOpRect(op: PendingDrawOp, bounds: ?state.PixelRect) OpRect {
+    var r = OpRect{ .x0 = op.x, .y0 = op.y, .x1 = @as(i64, op.x) + op.width, .y1 = @as(i64, op.y) + op.height };
+    if (bounds) |b| {
+        r.x0 = std.math.clamp(r.x0, 0, b.x1);
+        r.y0 = std.math.clamp(r.y0, 0, b.y1);
+        r.x1 = std.math.clamp(r.x1, 0, b.x1);
+        r.y1 = std.math.clamp(r.y1, 0, b.y1);
+    }
+    return r;
+}
+
+fn rectContains(outer: OpRect, inner: OpRect) bool {
+    // Empty (fully off-window) ops are hidden by anything
+    if (inner.x0 >= inner.x1 or inner.y0 >= inner.y1) return true;
+    return outer.x0 <= inner.x0 and outer.y0 <= inner.y0 and outer.x1 >= inner.x1 and outer.y1 >= inner.y1;
+}
+
+// Get (or start) this turn's content entry for a window
+fn contentFor(win_id: u32) ?*PendingContent {
+    // Text arrives a character at a time, almost always for the same window
+    if (last_content < pending_content_len and pending_content.items[last_content].id == win_id) {
+        return &pending_content.items[last_content];
+    }
+    for (pending_content.items[0..pending_content_len], 0..) |*c, i| {
+        if (c.id == win_id) {
+            last_content = i;
+            return c;
+        }
+    }
+    if (pending_content_len == pending_content.items.len) {
+        pending_content.append(allocator, .{}) catch return null;
+    }
+    last_content = pending_content_len;
+    const c = &pending_content.items[pending_content_len];
     pending_content_len += 1;
+    c.reset(win_id);
+    return c;
+}
+
+// Add a span to the window's open paragraph, starting an appended paragraph if needed
+fn appendSpan(c: *PendingContent, span: PendingSpan) void {
+    c.spans.append(allocator, span) catch return;
+    const end: u32 = @intCast(c.spans.items.len);
+    if (c.paragraphs.items.len > 0) {
+        const last = &c.paragraphs.items[c.paragraphs.items.len - 1];
+        if (!last.flowbreak and last.span_end == end - 1) {
+            last.span_end = end;
+            return;
+        }
+    }
+    c.paragraphs.append(allocator, .{ .append = true, .span_start = end - 1, .span_end = end }) catch {
+        c.spans.items.len -= 1;
+    };
+}
+
+// Append text written to a buffer window. Consecutive writes with the same
+// style and hyperlink extend one span; each '\n' ends the current paragraph
+// and opens a new (non-append) one, as GlkOte expects.
+pub fn putBufferText(win_id: u32, text: []const u8, style: glui32, hyperlink: glui32) void {
+    const c = contentFor(win_id) orelse return;
+    var rest = text;
+    while (std.mem.indexOfScalar(u8, rest, '\n')) |nl| {
+        appendRun(c, rest[0..nl], style, hyperlink);
+        const end: u32 = @intCast(c.spans.items.len);
+        c.paragraphs.append(allocator, .{ .span_start = end, .span_end = end }) catch return;
+        rest = rest[nl + 1 ..];
+    }
+    appendRun(c, rest, style, hyperlink);
+}
+
+fn appendRun(c: *PendingContent, text: []const u8, style: glui32, hyperlink: glui32) void {
+    if (text.len == 0) return;
+    const start = turn_text.items.len;
+    turn_text.appendSlice(allocator, text) catch return;
+
+    // Extend the open paragraph's last span if it is the same run
+    if (c.spans.items.len > 0 and c.paragraphs.items.len > 0) {
+        const last = &c.spans.items[c.spans.items.len - 1];
+        const para = c.paragraphs.items[c.paragraphs.items.len - 1];
+        if (last.kind == .text and last.style == style and last.hyperlink == hyperlink and
+            last.text_start + last.text_len == start and para.span_end == c.spans.items.len)
+        {
+            last.text_len += @intCast(text.len);
+            return;
+        }
+    }
+    appendSpan(c, .{
+        .kind = .text,
+        .text_start = @intCast(start),
+        .text_len = @intCast(text.len),
+        .style = style,
+        .hyperlink = hyperlink,
+    });
+}
+
+// Clear a window; anything queued for it earlier in the turn is discarded
+// except the latest background colour, which the clear and later erases use
+pub fn queueClear(win_id: u32) void {
+    const c = contentFor(win_id) orelse return;
+    var background: ?glui32 = null;
+    for (c.draw.items) |op| {
+        if (op.kind == .setcolor) background = op.color;
+    }
+    c.reset(win_id);
+    c.clear = true;
+    if (background) |color| c.draw.append(allocator, .{ .kind = .setcolor, .color = color }) catch {};
+}
+
+fn queueDrawOp(win_id: u32, op: PendingDrawOp) void {
+    const c = contentFor(win_id) orelse return;
+    c.draw.append(allocator, op) catch {};
+}
+
+// Drop pending output for a window that is being closed
+pub fn discardWindowContent(win: *const WindowData) void {
+    const live = pending_content.items[0..pending_content_len];
+    for (live) |*c| {
+        if (c.id != win.id) continue;
+        // Swap with the last live entry so both keep their list capacity
+        std.mem.swap(PendingContent, c, &live[live.len - 1]);
+        pending_content_len -= 1;
+        return;
+    }
 }
 
 pub fn queueInputRequest(win_id: u32, input_type: TextInputType, mouse: bool, hyperlink: bool, xpos: ?u32, ypos: ?u32, initial: ?[]const u8, terminators: ?[]const glui32) void {
@@ -581,28 +1088,6 @@ fn alignmentToString(alignment: glsi32) []const u8 {
     };
 }
 
-// Helper to send a simple update with a single content entry
-fn sendContentUpdate(content: ContentUpdateJson) void {
-    const contents = [_]ContentUpdateJson{content};
-    const update = StateUpdateJson{
-        .gen = generation,
-        .content = &contents,
-        .disable = true, // Content-only updates don't expect input
-    };
-    const fmt_opts = .{std.json.fmt(update, .{ .emit_null_optional_fields = false })};
-    // Try stack buffer first, fall back to heap allocation for large outputs
-    var buf: [131072]u8 = undefined;
-    if (std.fmt.bufPrint(&buf, "{f}", fmt_opts)) |json| {
-        writeStdout(json);
-    } else |_| {
-        const json = std.fmt.allocPrint(allocator, "{f}", fmt_opts) catch return;
-        defer allocator.free(json);
-        writeStdout(json);
-    }
-    writeStdout("\n");
-    generation += 1;
-}
-
 // Glk style number to GlkOte style name mapping
 fn styleToString(style: glui32) []const u8 {
     return switch (style) {
@@ -621,50 +1106,28 @@ fn styleToString(style: glui32) []const u8 {
     };
 }
 
-// Send an image content update for buffer windows using paragraph format per GlkOte spec
-pub fn sendImageUpdate(win_id: u32, image: glui32, alignment: glsi32, img_width: glui32, img_height: glui32) void {
-    // Flush any pending updates first
-    if (pending_content_len > 0 or pending_windows_len > 0 or pending_input_len > 0) {
-        sendUpdate();
-    }
-
-    const alignment_str = alignmentToString(alignment);
-    const content = [_]ContentSpan{.{ .image = .{
+// Queue an image span for a buffer window (paragraph format per GlkOte spec)
+pub fn queueImageUpdate(win_id: u32, image: glui32, alignment: glsi32, img_width: glui32, img_height: glui32) void {
+    const c = contentFor(win_id) orelse return;
+    appendSpan(c, .{
+        .kind = .image,
         .image = image,
-        .alignment = alignment_str,
+        .alignment = alignment,
         .width = img_width,
         .height = img_height,
-    } }};
-    const paragraphs = [_]TextParagraph{.{ .append = true, .content = &content }};
-    sendContentUpdate(.{ .id = win_id, .text = &paragraphs });
+    });
 }
 
-// Send a graphics window image update (includes x, y position)
-// Uses "draw" array with "special" as string value per GlkOte spec
-pub fn sendGraphicsImageUpdate(win_id: u32, image: glui32, x: glsi32, y: glsi32, img_width: glui32, img_height: glui32) void {
-    if (pending_content_len > 0 or pending_windows_len > 0 or pending_input_len > 0) {
-        sendUpdate();
-    }
-
-    const draw_ops = [_]DrawOp{.{
-        .special = "image",
-        .image = image,
-        .x = x,
-        .y = y,
-        .width = img_width,
-        .height = img_height,
-    }};
-    sendContentUpdate(.{ .id = win_id, .draw = &draw_ops });
+// Queue a graphics window image draw (includes x, y position)
+pub fn queueGraphicsImageUpdate(win_id: u32, image: glui32, x: glsi32, y: glsi32, img_width: glui32, img_height: glui32) void {
+    queueDrawOp(win_id, .{ .kind = .image, .image = image, .x = x, .y = y, .width = img_width, .height = img_height });
 }
 
-pub fn sendFlowBreakUpdate(win_id: u32) void {
-    if (pending_content_len > 0 or pending_windows_len > 0 or pending_input_len > 0) {
-        sendUpdate();
-    }
-
+pub fn queueFlowBreakUpdate(win_id: u32) void {
+    const c = contentFor(win_id) orelse return;
     // Use paragraph format with flowbreak flag per GlkOte spec
-    const paragraphs = [_]TextParagraph{.{ .flowbreak = true }};
-    sendContentUpdate(.{ .id = win_id, .text = &paragraphs });
+    const end: u32 = @intCast(c.spans.items.len);
+    c.paragraphs.append(allocator, .{ .flowbreak = true, .span_start = end, .span_end = end }) catch {};
 }
 
 // Helper to format a color integer as CSS hex string "#RRGGBB"
@@ -675,167 +1138,152 @@ fn formatColorHex(buf: []u8, color: glui32) []const u8 {
     return std.fmt.bufPrint(buf, "#{X:0>2}{X:0>2}{X:0>2}", .{ r, g, b }) catch "#000000";
 }
 
-pub fn sendGraphicsFillUpdate(win_id: u32, color: glui32, x: glsi32, y: glsi32, width: glui32, height: glui32) void {
-    if (pending_content_len > 0 or pending_windows_len > 0 or pending_input_len > 0) {
-        sendUpdate();
-    }
-
-    // Format color as CSS hex string
-    var color_buf: [8]u8 = undefined;
-    const color_str = formatColorHex(&color_buf, color);
-
-    const draw_ops = [_]DrawOp{.{
-        .special = "fill",
-        .color = color_str,
-        .x = x,
-        .y = y,
-        .width = width,
-        .height = height,
-    }};
-    sendContentUpdate(.{ .id = win_id, .draw = &draw_ops });
+pub fn queueGraphicsFillUpdate(win_id: u32, color: glui32, x: glsi32, y: glsi32, width: glui32, height: glui32) void {
+    queueDrawOp(win_id, .{ .kind = .fill, .color = color, .x = x, .y = y, .width = width, .height = height });
 }
 
-pub fn sendGraphicsEraseUpdate(win_id: u32, x: glsi32, y: glsi32, width: glui32, height: glui32) void {
-    if (pending_content_len > 0 or pending_windows_len > 0 or pending_input_len > 0) {
-        sendUpdate();
-    }
-
-    const draw_ops = [_]DrawOp{.{
-        .special = "fill",
-        .x = x,
-        .y = y,
-        .width = width,
-        .height = height,
-    }};
-    sendContentUpdate(.{ .id = win_id, .draw = &draw_ops });
+pub fn queueGraphicsEraseUpdate(win_id: u32, x: glsi32, y: glsi32, width: glui32, height: glui32) void {
+    queueDrawOp(win_id, .{ .kind = .erase, .x = x, .y = y, .width = width, .height = height });
 }
 
-pub fn sendGraphicsSetColorUpdate(win_id: u32, color: glui32) void {
-    if (pending_content_len > 0 or pending_windows_len > 0 or pending_input_len > 0) {
-        sendUpdate();
-    }
-
-    // Format color as CSS hex string
-    var color_buf: [8]u8 = undefined;
-    const color_str = formatColorHex(&color_buf, color);
-
-    const draw_ops = [_]DrawOp{.{
-        .special = "setcolor",
-        .color = color_str,
-    }};
-    sendContentUpdate(.{ .id = win_id, .draw = &draw_ops });
+pub fn queueGraphicsSetColorUpdate(win_id: u32, color: glui32) void {
+    queueDrawOp(win_id, .{ .kind = .setcolor, .color = color });
 }
 
-// ============== Text Buffer Management ==============
-
-pub fn flushTextBuffer() void {
-    if (state.text_buffer_len > 0 and state.text_buffer_win != null) {
-        const win = state.text_buffer_win.?;
-        const win_type = win.win_type;
-
-        // For buffer windows, we need to use the paragraph format per GlkOte spec
-        if (win_type == wintype.TextBuffer) {
-            sendBufferTextUpdate(win.id, state.text_buffer[0..state.text_buffer_len], false);
-        } else {
-            // For other window types, queue normally for now
-            const text_copy = allocator.dupe(u8, state.text_buffer[0..state.text_buffer_len]) catch return;
-            queueContentUpdate(win.id, text_copy, false);
+// Queue a region of a graphics window framebuffer as one run-length encoded
+// raster op. `pixels` is the whole framebuffer, `stride` pixels per row.
+pub fn queueGraphicsRaster(win_id: u32, pixels: []const glui32, stride: glui32, rect: state.PixelRect) void {
+    const start = turn_runs.items.len;
+    var y = rect.y0;
+    var count: u32 = 0;
+    var color: glui32 = 0;
+    while (y < rect.y1) : (y += 1) {
+        for (pixels[y * stride + rect.x0 .. y * stride + rect.x1]) |px| {
+            if (count > 0 and px == color) {
+                count += 1;
+                continue;
+            }
+            if (count > 0) turn_runs.appendSlice(allocator, &.{ count, color }) catch return;
+            color = px;
+            count = 1;
         }
-        state.text_buffer_len = 0;
     }
+    if (count > 0) turn_runs.appendSlice(allocator, &.{ count, color }) catch return;
+
+    queueDrawOp(win_id, .{
+        .kind = .raster,
+        .x = @intCast(rect.x0),
+        .y = @intCast(rect.y0),
+        .width = rect.x1 - rect.x0,
+        .height = rect.y1 - rect.y0,
+        .runs_start = @intCast(start),
+        .runs_len = @intCast(turn_runs.items.len - start),
+    });
 }
 
-// Flush dirty grid lines for all grid windows
+// ============== Text Buffer Management ==============
+
+// Make sure every grid window with changed lines has a content entry this turn.
+// The lines themselves are read from the grid buffer when the update is written.
 pub fn flushGridWindows() void {
     var win = state.window_list;
     while (win) |w| : (win = w.next) {
-        if (w.win_type == wintype.TextGrid) {
-            flushGridWindow(w);
+        if (w.win_type == wintype.TextGrid and diffGridLines(w)) {
+            _ = contentFor(w.id);
         }
     }
 }
 
-// Flush dirty lines for a single grid window
-fn flushGridWindow(win: *state.WindowData) void {
-    const grid_buf = win.grid_buffer orelse return;
-    const dirty = win.grid_dirty orelse return;
-
-    // Count dirty lines
-    var dirty_count: usize = 0;
-    for (0..win.grid_height) |i| {
-        if (dirty[i]) dirty_count += 1;
+// Drop dirty ranges whose cells match what the client already has (a status
+// line redrawn with the same text). Returns true if any line still changed.
+fn diffGridLines(win: *WindowData) bool {
+    const cells = win.grid_cells orelse return false;
+    const sent = win.grid_sent orelse return false;
+    const dirty = win.grid_dirty orelse return false;
+
+    var changed = false;
+    for (dirty, 0..) |*range, row| {
+        if (range.isEmpty()) continue;
+        const start = row * win.grid_width + range.start;
+        const len = range.end - range.start;
+        if (std.mem.eql(u8, std.mem.sliceAsBytes(cells[start..][0..len]), std.mem.sliceAsBytes(sent[start..][0..len]))) {
+            range.* = .{};
+        } else {
+            changed = true;
+        }
     }
-    if (dirty_count == 0) return;
+    return changed;
+}
 
-    // Flush any pending updates first
-    if (pending_content_len > 0 or pending_windows_len > 0 or pending_input_len > 0) {
-        sendUpdate();
+fn gridHasDirtyLines(win: *const WindowData) bool {
+    const dirty = win.grid_dirty orelse return false;
+    for (dirty) |range| {
+        if (!range.isEmpty()) return true;
     }
+    return false;
+}
 
-    // Build grid lines array - we need fixed-size arrays for struct serialization
-    // Max 128 lines per state.MAX_GRID_HEIGHT
-    var grid_lines: [state.MAX_GRID_HEIGHT]GridLine = undefined;
-    var grid_text_spans: [state.MAX_GRID_HEIGHT][1]ContentSpan = undefined;
-    var line_count: usize = 0;
+// Write the dirty lines of a grid window and mark them clean.
+// Each line is split into one span per run of cells with the same style.
+fn writeGridLines(jw: *output.JsonWriter, win: *WindowData) void {
+    const cells = win.grid_cells orelse return;
+    const dirty = win.grid_dirty orelse return;
 
+    jw.beginArray();
     for (0..win.grid_height) |row| {
-        if (!dirty[row]) continue;
-
-        // Find the end of meaningful content (trim trailing spaces)
-        var line_end: usize = win.grid_width;
-        while (line_end > 0 and grid_buf[row][line_end - 1] == ' ') {
-            line_end -= 1;
+        if (dirty[row].isEmpty()) continue;
+        const line = cells[row * win.grid_width ..][0..win.grid_width];
+        const line_end = gridLineEnd(line);
+
+        jw.beginObject();
+        jw.field("line");
+        jw.int(row);
+        jw.field("content");
+        jw.beginArray();
+        var start: usize = 0;
+        while (start < line_end) {
+            const style = line[start].style;
+            var stop = start + 1;
+            while (stop < line_end and line[stop].style == style) stop += 1;
+            grid_text.clearRetainingCapacity();
+            for (line[start..stop]) |cell| appendUtf8(&grid_text, cell.ch);
+            jw.write(TextSpan{ .style = styleToString(style), .text = grid_text.items });
+            start = stop;
         }
-
-        // Build text span for this line
-        grid_text_spans[line_count][0] = .{ .text = .{
-            .style = "normal",
-            .text = grid_buf[row][0..line_end],
-        } };
-        grid_lines[line_count] = .{
-            .line = @intCast(row),
-            .content = &grid_text_spans[line_count],
-        };
-        line_count += 1;
-
-        // Mark line as clean
-        dirty[row] = false;
+        jw.endArray();
+        jw.endObject();
+        markGridLineSent(win, row);
     }
-
-    // Send using struct-based serialization
-    sendContentUpdate(.{ .id = win.id, .lines = grid_lines[0..line_count] });
+    jw.endArray();
 }
 
-// Send buffer window text with proper paragraph structure per GlkOte spec
-// Format: {"id": N, "text": [{"append": true, "content": [{"style": "normal", "text": "escaped text"}]}]}
-// With hyperlink: {"content": [{"style": "normal", "text": "click me", "hyperlink": 42}]}
-pub fn sendBufferTextUpdate(win_id: u32, text: []const u8, clear: bool) void {
-    sendStyledBufferTextUpdate(win_id, text, clear, state.current_style, state.current_hyperlink);
+// End of a grid line's meaningful content (trailing unstyled spaces trimmed)
+fn gridLineEnd(line: []const state.GridCell) usize {
+    var end: usize = line.len;
+    while (end > 0 and line[end - 1].ch == ' ' and line[end - 1].style == 0) end -= 1;
+    return end;
 }
 
-// Send buffer window text with explicit style and hyperlink
-fn sendStyledBufferTextUpdate(win_id: u32, text: []const u8, clear: bool, style: glui32, hyperlink: glui32) void {
-    // Flush any other pending updates first
-    if (pending_content_len > 0 or pending_windows_len > 0 or pending_input_len > 0) {
-        sendUpdate();
-    }
+// Remember what the client now shows and mark the line clean
+fn markGridLineSent(win: *WindowData, row: usize) void {
+    const cells = win.grid_cells orelse return;
+    const sent = win.grid_sent orelse return;
+    const dirty = win.grid_dirty orelse return;
+    @memcpy(sent[row * win.grid_width ..][0..win.grid_width], cells[row * win.grid_width ..][0..win.grid_width]);
+    dirty[row] = .{};
+}
 
-    const style_str = styleToString(style);
+// UTF-8 text of the grid span being written
+var grid_text: std.ArrayListUnmanaged(u8) = .empty;
 
-    // Build content span
-    const text_span = TextSpan{
-        .style = style_str,
-        .text = text,
-        .hyperlink = if (hyperlink != 0) hyperlink else null,
+fn appendUtf8(list: *std.ArrayListUnmanaged(u8), ch: u21) void {
+    list.ensureUnusedCapacity(allocator, 4) catch return;
+    var buf: [4]u8 = undefined;
+    const len = std.unicode.utf8Encode(ch, &buf) catch blk: {
+        buf[0] = '?';
+        break :blk 1;
     };
-    const content = [_]ContentSpan{.{ .text = text_span }};
-    const paragraphs = [_]TextParagraph{.{ .append = true, .content = &content }};
-
-    sendContentUpdate(.{
-        .id = win_id,
-        .clear = if (clear) true else null,
-        .text = &paragraphs,
-    });
+    list.appendSliceAssumeCapacity(buf[0..len]);
 }
 
 pub fn ensureGlkInitialized() void {
@@ -843,47 +1291,24 @@ pub fn ensureGlkInitialized() void {
         state.glk_initialized = true;
 
         // Wait for client's init message
-        var buf: [4096]u8 = undefined;
-        const line = readLineFromStdin(&buf) orelse {
+        const line = readLineFromStdin() orelse {
             sendError("No init message received");
             return;
         };
 
-        // Parse the init event (use Raw struct to access support array)
-        const parsed = std.json.parseFromSlice(InputEventRaw, allocator, line, .{
-            .ignore_unknown_fields = true,
-        }) catch {
+        const event = input.parseEvent(line) orelse {
             sendError("Invalid init message");
             return;
         };
-        defer parsed.deinit();
-
-        const event = parsed.value;
-        if (!std.mem.eql(u8, event.type, "init")) {
+        if (event.type != .init) {
             sendError("Expected init message");
             return;
         }
 
-        // Store client metrics
-        if (event.metrics) |m| {
-            if (m.width) |w| state.client_metrics.width = w;
-            if (m.height) |h| state.client_metrics.height = h;
-        }
+        if (event.metrics) |m| storeMetrics(m);
 
-        // Parse client capabilities from support array
-        if (event.support) |support| {
-            for (support) |feature| {
-                if (std.mem.eql(u8, feature, "timer")) {
-                    state.client_support.timer = true;
-                } else if (std.mem.eql(u8, feature, "graphics")) {
-                    state.client_support.graphics = true;
-                } else if (std.mem.eql(u8, feature, "graphicswin")) {
-                    state.client_support.graphicswin = true;
-                } else if (std.mem.eql(u8, feature, "hyperlinks")) {
-                    state.client_support.hyperlinks = true;
-                }
-            }
-        }
+        // Client capabilities from the support array
+        if (event.support) |support| state.client_support = support;
 
         // Per RemGLK spec: interpreter responds with "update", not "init"
         // The first sendUpdate() call from the game will serve as the response
@@ -1015,56 +1440,188 @@ test "fileusageToType masks off TextMode flag" {
 // Returns the selected filename, or null if the user cancelled
 // This function blocks via stdin read (JSPI suspends in browser)
 pub fn sendSpecialInputAndWait(fmode: glui32, usage: glui32) ?[]const u8 {
-    // Flush any pending buffers first
-    flushTextBuffer();
+    // Flush any pending grid lines and rasters first
     flushGridWindows();
+    graphics.flushGraphicsWindows();
 
-    // Build the specialinput update
-    const special = SpecialInput{
+    // Send the specialinput request along with the rest of the turn's output
+    pending_special = .{
         .filemode = filemodeToString(fmode),
         .filetype = fileusageToType(usage),
     };
+    sendUpdate();
 
-    const update = StateUpdateJson{
-        .gen = generation,
-        .specialinput = special,
-        .disable = true, // No regular input expected
-    };
+    // Wait for response (JSPI suspends here in browser)
+    const response_line = readLineFromStdin() orelse return null;
 
-    // Serialize and send
-    var buf: [4096]u8 = undefined;
-    const json = std.fmt.bufPrint(&buf, "{f}", .{std.json.fmt(update, .{ .emit_null_optional_fields = false })}) catch return null;
-    writeStdout(json);
-    writeStdout("\n");
-    generation += 1;
+    const event = input.parseEvent(response_line) orelse return null;
 
-    // Wait for response (JSPI suspends here in browser)
-    var response_buf: [4096]u8 = undefined;
-    const response_line = readLineFromStdin(&response_buf) orelse return null;
+    // Must be a specialresponse with response="fileref_prompt"
+    if (event.type != .specialresponse) return null;
+    const response = event.response orelse return null;
+    if (!std.mem.eql(u8, response, "fileref_prompt")) return null;
+
+    // The filename is in value (null if the user cancelled); return a copy,
+    // since the line buffer is reused by the next read
+    const filename = event.value orelse return null;
+    return allocator.dupe(u8, filename) catch null;
+}
+
+test "putBufferText merges style runs and splits paragraphs on newlines" {
+    defer {
+        pending_content_len = 0;
+        turn_text.clearRetainingCapacity();
+    }
+    putBufferText(1, "Hello ", 0, 0);
+    putBufferText(1, "wor", 1, 0);
+    putBufferText(1, "ld\nNext", 1, 0);
+    putBufferText(1, " line\n", 1, 0);
+
+    const c = contentFor(1).?;
+    try testing.expectEqual(@as(usize, 3), c.paragraphs.items.len);
+    try testing.expect(c.paragraphs.items[0].append);
+    try testing.expect(!c.paragraphs.items[1].append);
+    // "Hello " and "world" in the first paragraph, "Next line" in the second
+    try testing.expectEqual(@as(usize, 3), c.spans.items.len);
+    const next = c.spans.items[2];
+    try testing.expectEqualStrings("Next line", turn_text.items[next.text_start..][0..next.text_len]);
+    // The trailing newline leaves an empty paragraph open for the next turn
+    try testing.expectEqual(c.paragraphs.items[2].span_start, c.paragraphs.items[2].span_end);
+}
 
-    // Parse the response
-    const parsed = std.json.parseFromSlice(InputEventRaw, allocator, response_line, .{
-        .ignore_unknown_fields = true,
-    }) catch return null;
-    defer parsed.deinit();
+test "writeBinaryContent writes a content record then paragraph and span records" {
+    defer {
+        pending_content_len = 0;
+        turn_text.clearRetainingCapacity();
+    }
+    putBufferText(7, "Hi", 1, 3);
+
+    var arena = output.OutputArena{};
+    defer arena.deinit();
+    var bw = output.BinaryWriter{ .out = &arena };
+    writeBinaryContent(&bw, contentFor(7).?);
+    try testing.expectEqualSlices(u8, &.{
+        @intFromEnum(BinaryRecord.content), 5, 0, 0, 0, 7, 0, 0, 0, 0, // id 7, no clear
+        @intFromEnum(BinaryRecord.paragraph), 1, 0, 0, 0, 1, // append
+        @intFromEnum(BinaryRecord.text), 11, 0, 0, 0, 1, 3, 0, 0, 0, 2, 0, 0, 0, 'H', 'i', // style 1, link 3
+    }, arena.written());
+}
 
-    const event = parsed.value;
+test "writeGridLines splits lines into style runs" {
+    var cells = [_]state.GridCell{.{}} ** 8;
+    var sent = [_]state.GridCell{.{}} ** 8;
+    var dirty = [_]state.GridDirty{ .{ .start = 0, .end = 3 }, .{} };
+    var win = WindowData{ .id = 1, .rock = 0, .win_type = wintype.TextGrid, .grid_width = 4, .grid_height = 2, .grid_cells = &cells, .grid_sent = &sent, .grid_dirty = &dirty };
+    cells[0] = .{ .ch = 'a' };
+    cells[1] = .{ .ch = 'b' };
+    cells[2] = .{ .ch = 0xE9, .style = 1 };
+
+    var arena = output.OutputArena{};
+    defer arena.deinit();
+    var jw = output.JsonWriter{ .out = &arena };
+    writeGridLines(&jw, &win);
+    try testing.expectEqualStrings(
+        "[{\"line\":0,\"content\":[{\"style\":\"normal\",\"text\":\"ab\"},{\"style\":\"emphasized\",\"text\":\"\xc3\xa9\"}]}]",
+        arena.written(),
+    );
+    try testing.expect(dirty[0].isEmpty());
+}
 
-    // Must be a specialresponse with response="fileref_prompt"
-    if (!std.mem.eql(u8, event.type, "specialresponse")) return null;
-    if (event.response == null or !std.mem.eql(u8, event.response.?, "fileref_prompt")) return null;
-
-    // Extract the filename from value (string or null)
-    if (event.value) |val| {
-        switch (val) {
-            .string => |s| {
-                // Return a copy of the filename
-                return allocator.dupe(u8, s) catch null;
-            },
-            .null => return null,
-            else => return null,
-        }
+test "diffGridLines skips lines redrawn with the same content" {
+    var cells = [_]state.GridCell{.{}} ** 8;
+    var sent = [_]state.GridCell{.{}} ** 8;
+    var dirty = [_]state.GridDirty{.{}} ** 2;
+    var win = WindowData{ .id = 1, .rock = 0, .win_type = wintype.TextGrid, .grid_width = 4, .grid_height = 2, .grid_cells = &cells, .grid_sent = &sent, .grid_dirty = &dirty };
+
+    // Line 0 already shows "ab"; redrawing it leaves nothing to send
+    cells[0] = .{ .ch = 'a' };
+    cells[1] = .{ .ch = 'b' };
+    sent[0] = cells[0];
+    sent[1] = cells[1];
+    dirty[0].add(0);
+    dirty[0].add(1);
+    try testing.expect(!diffGridLines(&win));
+    try testing.expect(dirty[0].isEmpty());
+
+    // A style change alone is a real change
+    cells[5] = .{ .ch = ' ', .style = 1 };
+    dirty[1].add(1);
+    try testing.expect(diffGridLines(&win));
+    try testing.expectEqual(@as(glui32, 1), dirty[1].start);
+    try testing.expectEqual(@as(glui32, 2), dirty[1].end);
+}
+
+test "queueGraphicsRaster run-length encodes the damaged region" {
+    defer {
+        pending_content_len = 0;
+        turn_runs.clearRetainingCapacity();
     }
+    const w: u32 = 0xFFFFFFFF;
+    const r: u32 = 0xFFFF0000;
+    // 4x3 framebuffer; the damaged region is columns 1..4 of rows 1..3
+    const pixels = [_]u32{
+        w, w, w, w,
+        w, r, r, w,
+        w, r, r, 0,
+    };
+    queueGraphicsRaster(3, &pixels, 4, .{ .x0 = 1, .y0 = 1, .x1 = 4, .y1 = 3 });
 
-    return null;
+    const op = contentFor(3).?.draw.items[0];
+    try testing.expectEqual(@as(glsi32, 1), op.x);
+    try testing.expectEqual(@as(glui32, 3), op.width);
+    try testing.expectEqual(@as(glui32, 2), op.height);
+    try testing.expectEqualSlices(u32, &.{ 2, r, 1, w, 2, r, 1, 0 }, turn_runs.items[op.runs_start..][0..op.runs_len]);
+}
+
+test "queueClear keeps the background colour set before it" {
+    defer pending_content_len = 0;
+    queueGraphicsSetColorUpdate(4, 0x000000);
+    queueGraphicsFillUpdate(4, 0xFF0000, 0, 0, 10, 10);
+    queueGraphicsSetColorUpdate(4, 0x336699);
+    queueClear(4);
+    queueGraphicsFillUpdate(4, 0x00FF00, 20, 20, 5, 5);
+
+    const c = contentFor(4).?;
+    compactDrawOps(&c.draw, .{ .x1 = 100, .y1 = 100 });
+    try testing.expect(c.clear);
+    try testing.expectEqual(@as(usize, 2), c.draw.items.len);
+    try testing.expectEqual(.setcolor, c.draw.items[0].kind);
+    try testing.expectEqual(@as(glui32, 0x336699), c.draw.items[0].color);
+    try testing.expectEqual(.fill, c.draw.items[1].kind);
+}
+
+test "mergeFills handles sizes beyond the signed range" {
+    var last = PendingDrawOp{ .kind = .fill, .x = -10, .y = 0, .width = 0x8000_0000, .height = 2 };
+    // Adjacent, but the combined width would overflow a glui32
+    try testing.expect(!mergeFills(&last, .{ .kind = .fill, .x = 0x7FFF_FFF6, .y = 0, .width = 0x8000_0000, .height = 2 }));
+    try testing.expectEqual(@as(glui32, 0x8000_0000), last.width);
+    // Adjacent and small enough
+    try testing.expect(mergeFills(&last, .{ .kind = .fill, .x = 0x7FFF_FFF6, .y = 0, .width = 5, .height = 2 }));
+    try testing.expectEqual(@as(glui32, 0x8000_0005), last.width);
+}
+
+test "compactDrawOps drops hidden ops and merges fills" {
+    var ops: std.ArrayListUnmanaged(PendingDrawOp) = .empty;
+    defer ops.deinit(allocator);
+    try ops.appendSlice(allocator, &.{
+        .{ .kind = .fill, .color = 0xFF0000, .x = 5, .y = 5, .width = 10, .height = 10 },
+        .{ .kind = .setcolor, .color = 0x000000 },
+        .{ .kind = .setcolor, .color = 0xFFFFFF },
+        .{ .kind = .erase, .x = 0, .y = 0, .width = 100, .height = 100 }, // Full-window erase
+        .{ .kind = .fill, .color = 0x00FF00, .x = 0, .y = 0, .width = 4, .height = 2 },
+        .{ .kind = .fill, .color = 0x00FF00, .x = 4, .y = 0, .width = 6, .height = 2 },
+        .{ .kind = .fill, .color = 0x00FF00, .x = 0, .y = 2, .width = 10, .height = 3 },
+        .{ .kind = .setcolor, .color = 0xFFFFFF },
+    });
+    compactDrawOps(&ops, .{ .x1 = 100, .y1 = 100 });
+
+    const items = ops.items;
+    try testing.expectEqual(@as(usize, 3), items.len);
+    try testing.expectEqual(.setcolor, items[0].kind);
+    try testing.expectEqual(@as(glui32, 0xFFFFFF), items[0].color);
+    try testing.expectEqual(.erase, items[1].kind);
+    // Three tiles merged into one 10x5 fill
+    try testing.expectEqual(.fill, items[2].kind);
+    try testing.expectEqual(@as(glui32, 10), items[2].width);
+    try testing.expectEqual(@as(glui32, 5), items[2].height);
 }
@@ -50,6 +50,11 @@ comptime {
     _ = @import("style.zig");
     _ = @import("dispatch.zig");
     _ = @import("blorb.zig");
+    _ = @import("autosave.zig");
     _ = @import("garglk.zig");
     _ = @import("startup.zig");
+    _ = @import("output.zig");
+    _ = @import("input.zig");
+    _ = @import("filebuf.zig");
+    _ = @import("state.zig");
 }
@@ -2,22 +2,106 @@
 
 const std = @import("std");
 const types = @import("types.zig");
+const filebuf = @import("filebuf.zig");
 
 pub const glui32 = types.glui32;
 pub const glsi32 = types.glsi32;
 pub const DispatchRock = types.DispatchRock;
+pub const FileBuffer = filebuf.FileBuffer;
 
 // Use C allocator to be compatible with C code's malloc/free
-// Note: There's a known issue with free() causing hangs in WASM - see stream.zig glk_stream_close
-pub const allocator = std.heap.c_allocator;
+// Note: There's a known issue with free() causing hangs in WASM - see stream.zig glk_stream_close.
+// Windows, streams and filerefs come from ObjectPools, which never free mid-session.
+// Calls are forwarded through a thin counting wrapper so the number of heap
+// allocations made by the Glk layer can be reported (see protocol.reportStats).
+pub const allocator: std.mem.Allocator = .{ .ptr = undefined, .vtable = &counting_vtable };
+
+pub var alloc_stats: struct {
+    allocs: u64 = 0, // alloc calls plus remaps that moved or grew a block
+    frees: u64 = 0,
+} = .{};
+
+const backing_allocator = std.heap.c_allocator;
+
+const counting_vtable = std.mem.Allocator.VTable{
+    .alloc = countingAlloc,
+    .resize = countingResize,
+    .remap = countingRemap,
+    .free = countingFree,
+};
+
+fn countingAlloc(_: *anyopaque, len: usize, alignment: std.mem.Alignment, ret_addr: usize) ?[*]u8 {
+    alloc_stats.allocs += 1;
+    return backing_allocator.rawAlloc(len, alignment, ret_addr);
+}
+
+fn countingResize(_: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) bool {
+    return backing_allocator.rawResize(memory, alignment, new_len, ret_addr);
+}
+
+fn countingRemap(_: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) ?[*]u8 {
+    if (new_len > memory.len) alloc_stats.allocs += 1;
+    return backing_allocator.rawRemap(memory, alignment, new_len, ret_addr);
+}
+
+fn countingFree(_: *anyopaque, memory: []u8, alignment: std.mem.Alignment, ret_addr: usize) void {
+    alloc_stats.frees += 1;
+    backing_allocator.rawFree(memory, alignment, ret_addr);
+}
 
 // ============== Internal Data Structures ==============
 
-pub const StreamType = enum { window, memory, file };
+pub const StreamType = enum { window, memory, file, resource };
+
+// One character cell of a grid window (packed so lines compare as plain bytes)
+pub const GridCell = packed struct(u32) {
+    ch: u21 = ' ',
+    style: u8 = 0, // Glk style number (style_Normal .. style_User2)
+    reserved: u3 = 0,
+};
+
+// Columns [start, end) of a grid line modified since the line was last sent
+pub const GridDirty = struct {
+    start: glui32 = 0,
+    end: glui32 = 0,
+
+    pub fn isEmpty(self: GridDirty) bool {
+        return self.start >= self.end;
+    }
+
+    pub fn add(self: *GridDirty, col: glui32) void {
+        if (self.isEmpty()) {
+            self.* = .{ .start = col, .end = col + 1 };
+        } else {
+            self.start = @min(self.start, col);
+            self.end = @max(self.end, col + 1);
+        }
+    }
+};
+
+// Pixel rectangle [x0, x1) x [y0, y1) of a graphics window framebuffer
+pub const PixelRect = struct {
+    x0: glui32 = 0,
+    y0: glui32 = 0,
+    x1: glui32 = 0,
+    y1: glui32 = 0,
 
-// Maximum grid window dimensions (in character cells)
-pub const MAX_GRID_WIDTH = 256;
-pub const MAX_GRID_HEIGHT = 128;
+    pub fn isEmpty(self: PixelRect) bool {
+        return self.x0 >= self.x1 or self.y0 >= self.y1;
+    }
+
+    pub fn add(self: *PixelRect, other: PixelRect) void {
+        if (other.isEmpty()) return;
+        if (self.isEmpty()) {
+            self.* = other;
+        } else {
+            self.x0 = @min(self.x0, other.x0);
+            self.y0 = @min(self.y0, other.y0);
+            self.x1 = @max(self.x1, other.x1);
+            self.y1 = @max(self.y1, other.y1);
+        }
+    }
+};
 
 pub const WindowData = struct {
     id: glui32,
@@ -44,6 +128,10 @@ pub const WindowData = struct {
     line_request_uni: bool = false,
     mouse_request: bool = false,
     hyperlink_request: bool = false,
+    // Place in text_request_list while a char or line request is pending
+    text_request_listed: bool = false,
+    text_request_prev: ?*WindowData = null,
+    text_request_next: ?*WindowData = null,
     line_buffer: ?[*]u8 = null,
     line_buffer_uni: ?[*]glui32 = null,
     line_buflen: glui32 = 0,
@@ -59,10 +147,20 @@ pub const WindowData = struct {
     // Grid window state (cursor position and content buffer)
     cursor_x: glui32 = 0,
     cursor_y: glui32 = 0,
-    grid_width: glui32 = 80,
-    grid_height: glui32 = 24,
-    grid_buffer: ?*[MAX_GRID_HEIGHT][MAX_GRID_WIDTH]u8 = null,
-    grid_dirty: ?*[MAX_GRID_HEIGHT]bool = null, // Track which lines have been modified
+    // Grid size in character cells, set from the layout (see window.resizeGrid)
+    grid_width: glui32 = 0,
+    grid_height: glui32 = 0,
+    grid_cells: ?[]GridCell = null, // grid_width * grid_height cells, row by row
+    grid_sent: ?[]GridCell = null, // Cells as last sent to the client (same layout)
+    grid_dirty: ?[]GridDirty = null, // Modified column range of each line
+    // Graphics window framebuffer, used when the client supports "raster"
+    // (see graphics.zig). Pixels are 0xAARRGGBB, row by row; alpha 0 marks
+    // pixels covered by an image, which only the client knows.
+    gfx_width: glui32 = 0,
+    gfx_height: glui32 = 0,
+    gfx_pixels: ?[]glui32 = null,
+    gfx_damage: PixelRect = .{}, // Region changed since the last update
+    gfx_background: glui32 = 0xFFFFFF,
     // Linked list
     prev: ?*WindowData = null,
     next: ?*WindowData = null,
@@ -82,9 +180,13 @@ pub const StreamData = struct {
     is_unicode: bool = false,
     // Retained array rock for memory buffer (for dispatch layer copy-back)
     buf_rock: DispatchRock = .{ .num = 0 },
-    // File stream
-    file: ?std.fs.File = null,
+    // File stream (the buffer owns the open file)
+    file: ?*FileBuffer = null,
+    path: ?[]const u8 = null, // Owned copy of the fileref's filename, for autosave
     textmode: bool = false,
+    // Resource stream: a Blorb chunk read in place from the Blorb file, starting
+    // at res_start; bufptr/buflen hold the position and length within the chunk
+    res_start: u64 = 0,
     // Associated window
     win: ?*WindowData = null,
     // Statistics
@@ -111,6 +213,124 @@ pub const FileRefData = struct {
     next: ?*FileRefData = null,
 };
 
+// ============== Handle Tables ==============
+
+/// Id-indexed table of live objects. Ids are generational handles: the low
+/// 20 bits hold the slot index + 1 and the high 12 bits the slot's generation,
+/// so a stale id never resolves to an object that later reused its slot.
+/// The first ids handed out are 1, 2, 3, ... as with a plain counter.
+pub fn HandleTable(comptime T: type) type {
+    return struct {
+        const Self = @This();
+        const index_bits = 20;
+        const index_mask: glui32 = (1 << index_bits) - 1;
+
+        const Slot = struct {
+            ptr: ?*T = null,
+            generation: u12 = 0,
+        };
+
+        slots: std.ArrayListUnmanaged(Slot) = .empty,
+        free: std.ArrayListUnmanaged(u32) = .empty, // Indices of empty slots
+
+        /// Register an object and return its id, or 0 if the table cannot grow.
+        pub fn insert(self: *Self, ptr: *T) glui32 {
+            const index: u32 = self.free.pop() orelse blk: {
+                if (self.slots.items.len >= index_mask) return 0;
+                // Reserve the free-list entry now so remove() cannot fail
+                self.free.ensureTotalCapacity(allocator, self.slots.items.len + 1) catch return 0;
+                self.slots.append(allocator, .{}) catch return 0;
+                break :blk @intCast(self.slots.items.len - 1);
+            };
+            const slot = &self.slots.items[index];
+            slot.ptr = ptr;
+            return (@as(glui32, slot.generation) << index_bits) | (index + 1);
+        }
+
+        /// Register an object under a given id, as when restoring an autosaved
+        /// session. Returns false if the id's slot is in use or cannot be made.
+        pub fn insertAt(self: *Self, id: glui32, ptr: *T) bool {
+            const low = id & index_mask;
+            if (low == 0) return false;
+            const index = low - 1;
+            while (self.slots.items.len <= index) {
+                self.free.ensureTotalCapacity(allocator, self.slots.items.len + 1) catch return false;
+                self.slots.append(allocator, .{}) catch return false;
+                self.free.appendAssumeCapacity(@intCast(self.slots.items.len - 1));
+            }
+            const slot = &self.slots.items[index];
+            if (slot.ptr != null) return false;
+            const free_pos = std.mem.indexOfScalar(u32, self.free.items, index) orelse return false;
+            _ = self.free.swapRemove(free_pos);
+            slot.ptr = ptr;
+            slot.generation = @truncate(id >> index_bits);
+            return true;
+        }
+
+        pub fn remove(self: *Self, id: glui32) void {
+            const index = self.slotIndex(id) orelse return;
+            const slot = &self.slots.items[index];
+            slot.ptr = null;
+            slot.generation +%= 1;
+            self.free.appendAssumeCapacity(index);
+        }
+
+        pub fn get(self: *const Self, id: glui32) ?*T {
+            const index = self.slotIndex(id) orelse return null;
+            return self.slots.items[index].ptr;
+        }
+
+        fn slotIndex(self: *const Self, id: glui32) ?u32 {
+            const low = id & index_mask;
+            if (low == 0 or low > self.slots.items.len) return null;
+            const slot = self.slots.items[low - 1];
+            if (slot.ptr == null or slot.generation != @as(u12, @truncate(id >> index_bits))) return null;
+            return low - 1;
+        }
+    };
+}
+
+// ============== Object Pools ==============
+
+/// Free-list pool for Glk objects. Objects are carved from slabs and returned
+/// to the free list on destroy; memory goes back to libc only at exit. Games
+/// that open and close memory streams for string work reuse the same few
+/// objects instead of calling malloc/free each time.
+pub fn ObjectPool(comptime T: type) type {
+    return struct {
+        const Self = @This();
+        const slab_len = 16;
+
+        free: std.ArrayListUnmanaged(*T) = .empty,
+        capacity: usize = 0, // Objects carved so far (live + free)
+        // Statistics (reported by protocol.reportStats)
+        hits: u64 = 0, // create() served from the free list
+        misses: u64 = 0, // create() that had to allocate a slab
+
+        /// Return an uninitialized object, or an error if a new slab is needed
+        /// and cannot be allocated.
+        pub fn create(self: *Self) error{OutOfMemory}!*T {
+            if (self.free.pop()) |obj| {
+                self.hits += 1;
+                return obj;
+            }
+            self.misses += 1;
+            // Reserve free-list room for every object so destroy() cannot fail
+            try self.free.ensureTotalCapacity(allocator, self.capacity + slab_len);
+            const slab = try allocator.alloc(T, slab_len);
+            self.capacity += slab_len;
+            var i: usize = slab_len - 1;
+            while (i > 0) : (i -= 1) self.free.appendAssumeCapacity(&slab[i]);
+            return &slab[0];
+        }
+
+        pub fn destroy(self: *Self, obj: *T) void {
+            obj.* = undefined;
+            self.free.appendAssumeCapacity(obj);
+        }
+    };
+}
+
 // ============== Global State ==============
 
 pub var root_window: ?*WindowData = null;
@@ -119,14 +339,56 @@ pub var stream_list: ?*StreamData = null;
 pub var current_stream: ?*StreamData = null;
 pub var fileref_list: ?*FileRefData = null;
 
-pub var window_id_counter: glui32 = 1;
-pub var stream_id_counter: glui32 = 1;
-pub var fileref_id_counter: glui32 = 1;
+// Id -> object tables (ids are the handles sent to the client)
+pub var windows: HandleTable(WindowData) = .{};
+pub var streams: HandleTable(StreamData) = .{};
+pub var filerefs: HandleTable(FileRefData) = .{};
+
+// Storage for Glk objects (see ObjectPool)
+pub var window_pool: ObjectPool(WindowData) = .{};
+pub var stream_pool: ObjectPool(StreamData) = .{};
+pub var fileref_pool: ObjectPool(FileRefData) = .{};
+
+// Number of windows with a pending mouse / hyperlink request, kept in step
+// with the per-window flags by setMouseRequest and setHyperlinkRequest
+pub var mouse_request_count: u32 = 0;
+pub var hyperlink_request_count: u32 = 0;
+
+pub fn setMouseRequest(win: *WindowData, on: bool) void {
+    if (win.mouse_request == on) return;
+    win.mouse_request = on;
+    if (on) mouse_request_count += 1 else mouse_request_count -= 1;
+}
 
-// Text output buffer (fixed size, simple approach)
-pub var text_buffer: [65536]u8 = undefined;
-pub var text_buffer_len: usize = 0;
-pub var text_buffer_win: ?*WindowData = null;
+pub fn setHyperlinkRequest(win: *WindowData, on: bool) void {
+    if (win.hyperlink_request == on) return;
+    win.hyperlink_request = on;
+    if (on) hyperlink_request_count += 1 else hyperlink_request_count -= 1;
+}
+
+// Windows with a pending char or line request, most recent first, so
+// glk_select finds the one to ask for input without walking every window.
+// Kept in step with the per-window flags by syncTextRequest.
+pub var text_request_list: ?*WindowData = null;
+
+/// Add or remove a window from text_request_list after its char or line
+/// request flags change.
+pub fn syncTextRequest(win: *WindowData) void {
+    const pending = win.char_request or win.line_request or win.char_request_uni or win.line_request_uni;
+    if (pending == win.text_request_listed) return;
+    win.text_request_listed = pending;
+    if (pending) {
+        win.text_request_prev = null;
+        win.text_request_next = text_request_list;
+        if (text_request_list) |head| head.text_request_prev = win;
+        text_request_list = win;
+    } else {
+        if (win.text_request_prev) |prev| prev.text_request_next = win.text_request_next else text_request_list = win.text_request_next;
+        if (win.text_request_next) |next| next.text_request_prev = win.text_request_prev;
+        win.text_request_prev = null;
+        win.text_request_next = null;
+    }
+}
 
 // Current text style (Glk style constants: 0=Normal, 1=Emphasized, 2=Preformatted, etc.)
 pub var current_style: glui32 = 0; // style_Normal
@@ -139,15 +401,25 @@ pub var glk_initialized: bool = false;
 pub var client_metrics: struct {
     width: u32 = 80,
     height: u32 = 24,
+    // Grid window character cell size and total margins, in layout units
+    gridcharwidth: f64 = 1,
+    gridcharheight: f64 = 1,
+    gridmarginx: f64 = 0,
+    gridmarginy: f64 = 0,
 } = .{};
 
-// Client capabilities (populated from init message's support array)
-pub var client_support: struct {
+// Client capabilities (populated from init message's support array;
+// field names match the feature strings)
+pub const ClientSupport = struct {
     timer: bool = false,
     graphics: bool = false,
     graphicswin: bool = false,
     hyperlinks: bool = false,
-} = .{};
+    raster: bool = false, // Graphics windows as run-length rasters (see graphics.zig)
+    binary: bool = false, // Updates as binary frames instead of JSON (see protocol.zig)
+};
+
+pub var client_support: ClientSupport = .{};
 
 // Timer state (global, not per-window)
 pub var timer_interval: ?glui32 = null; // null = no timer, value = interval in milliseconds
@@ -159,3 +431,92 @@ pub var debug_stream: ?*StreamData = null;
 
 // Working directory for glkunix
 pub var workdir: ?[]const u8 = null;
+
+// ============== Tests ==============
+
+const testing = std.testing;
+
+test "HandleTable resolves ids and rejects stale ones" {
+    var table: HandleTable(FileRefData) = .{};
+    defer {
+        table.slots.deinit(allocator);
+        table.free.deinit(allocator);
+    }
+    var a = FileRefData{ .id = 0, .rock = 0, .filename = "a", .usage = 0, .textmode = false };
+    var b = FileRefData{ .id = 0, .rock = 0, .filename = "b", .usage = 0, .textmode = false };
+
+    const id_a = table.insert(&a);
+    const id_b = table.insert(&b);
+    try testing.expectEqual(@as(glui32, 1), id_a);
+    try testing.expectEqual(@as(glui32, 2), id_b);
+    try testing.expectEqual(&b, table.get(id_b).?);
+
+    // The freed slot is reused under a new id; the old id stays dead
+    table.remove(id_a);
+    try testing.expect(table.get(id_a) == null);
+    const id_c = table.insert(&b);
+    try testing.expect(id_c != id_a);
+    try testing.expectEqual(&b, table.get(id_c).?);
+    try testing.expect(table.get(id_a) == null);
+
+    try testing.expect(table.get(0) == null);
+    try testing.expect(table.get(99) == null);
+}
+
+test "HandleTable.insertAt restores objects under their saved ids" {
+    var table: HandleTable(FileRefData) = .{};
+    defer {
+        table.slots.deinit(allocator);
+        table.free.deinit(allocator);
+    }
+    var a = FileRefData{ .id = 0, .rock = 0, .filename = "a", .usage = 0, .textmode = false };
+    var b = FileRefData{ .id = 0, .rock = 0, .filename = "b", .usage = 0, .textmode = false };
+
+    // Slot 3 with generation 2, leaving slots 1 and 2 free
+    const saved_id: glui32 = (2 << 20) | 3;
+    try testing.expect(table.insertAt(saved_id, &a));
+    try testing.expectEqual(&a, table.get(saved_id).?);
+    try testing.expect(!table.insertAt(saved_id, &b));
+
+    // The slots skipped over are handed out by insert
+    try testing.expectEqual(@as(glui32, 2), table.insert(&b));
+    try testing.expectEqual(@as(glui32, 1), table.insert(&b));
+    try testing.expect(table.insert(&b) == 4);
+}
+
+test "ObjectPool reuses destroyed objects" {
+    var pool: ObjectPool(StreamData) = .{};
+    const a = try pool.create();
+    const b = try pool.create();
+    try testing.expect(a != b);
+    try testing.expectEqual(@as(u64, 1), pool.misses);
+    try testing.expectEqual(@as(u64, 1), pool.hits);
+
+    pool.destroy(a);
+    try testing.expectEqual(a, try pool.create());
+    try testing.expectEqual(@as(u64, 2), pool.hits);
+    try testing.expectEqual(@as(u64, 1), pool.misses);
+}
+
+test "syncTextRequest keeps text_request_list in step with the request flags" {
+    defer text_request_list = null;
+    var a = WindowData{ .id = 1, .rock = 0, .win_type = 0 };
+    var b = WindowData{ .id = 2, .rock = 0, .win_type = 0 };
+
+    a.line_request = true;
+    syncTextRequest(&a);
+    b.char_request_uni = true;
+    syncTextRequest(&b);
+    syncTextRequest(&b); // No change
+    try testing.expectEqual(&b, text_request_list.?);
+    try testing.expectEqual(&a, b.text_request_next.?);
+
+    b.char_request_uni = false;
+    syncTextRequest(&b);
+    try testing.expectEqual(&a, text_request_list.?);
+    try testing.expect(a.text_request_prev == null);
+
+    a.line_request = false;
+    syncTextRequest(&a);
+    try testing.expect(text_request_list == null);
+}
@@ -5,6 +5,7 @@ const types = @import("types.zig");
 const state = @import("state.zig");
 const dispatch = @import("dispatch.zig");
 const protocol = @import("protocol.zig");
+const blorb = @import("blorb.zig");
 
 const glui32 = types.glui32;
 const glsi32 = types.glsi32;
@@ -16,6 +17,7 @@ const seekmode = types.seekmode;
 const wintype = types.wintype;
 const StreamData = state.StreamData;
 const FileRefData = state.FileRefData;
+const FileBuffer = state.FileBuffer;
 const WindowData = state.WindowData;
 const allocator = state.allocator;
 
@@ -37,20 +39,27 @@ pub export fn glk_stream_open_file(fref_opaque: frefid_t, fmode: glui32, rock: g
         if (err == error.FileNotFound and writable) {
             // Create file for writing
             const new_file = std.fs.cwd().createFile(f.filename, .{ .read = readable }) catch return null;
-            const stream = allocator.create(StreamData) catch {
-                new_file.close();
+            const fb = openFileBuffer(new_file) orelse return null;
+            const stream = state.stream_pool.create() catch {
+                closeFileBuffer(fb);
                 return null;
             };
+            const id = state.streams.insert(stream);
+            if (id == 0) {
+                state.stream_pool.destroy(stream);
+                closeFileBuffer(fb);
+                return null;
+            }
             stream.* = StreamData{
-                .id = state.stream_id_counter,
+                .id = id,
                 .rock = rock,
                 .stream_type = .file,
                 .readable = readable,
                 .writable = writable,
-                .file = new_file,
+                .file = fb,
+                .path = allocator.dupe(u8, f.filename) catch null,
                 .textmode = f.textmode,
             };
-            state.stream_id_counter += 1;
 
             stream.next = state.stream_list;
             if (state.stream_list) |list| list.prev = stream;
@@ -64,21 +73,30 @@ pub export fn glk_stream_open_file(fref_opaque: frefid_t, fmode: glui32, rock: g
         }
         return null;
     };
+    // Write mode replaces the file's contents
+    if (fmode == filemode.Write) file.setEndPos(0) catch {};
 
-    const stream = allocator.create(StreamData) catch {
-        file.close();
+    const fb = openFileBuffer(file) orelse return null;
+    const stream = state.stream_pool.create() catch {
+        closeFileBuffer(fb);
         return null;
     };
+    const id = state.streams.insert(stream);
+    if (id == 0) {
+        state.stream_pool.destroy(stream);
+        closeFileBuffer(fb);
+        return null;
+    }
     stream.* = StreamData{
-        .id = state.stream_id_counter,
+        .id = id,
         .rock = rock,
         .stream_type = .file,
         .readable = readable,
         .writable = writable,
-        .file = file,
+        .file = fb,
+        .path = allocator.dupe(u8, f.filename) catch null,
         .textmode = f.textmode,
     };
-    state.stream_id_counter += 1;
 
     stream.next = state.stream_list;
     if (state.stream_list) |list| list.prev = stream;
@@ -91,13 +109,36 @@ pub export fn glk_stream_open_file(fref_opaque: frefid_t, fmode: glui32, rock: g
     return @ptrCast(stream);
 }
 
+// Wrap an open file in a stream buffer; closes the file on failure
+pub fn openFileBuffer(file: std.fs.File) ?*FileBuffer {
+    const fb = allocator.create(FileBuffer) catch {
+        file.close();
+        return null;
+    };
+    fb.* = FileBuffer.init(file);
+    return fb;
+}
+
+// Flush pending writes, close the file and free the buffer
+fn closeFileBuffer(fb: *FileBuffer) void {
+    _ = fb.flush();
+    fb.file.sync() catch {};
+    fb.file.close();
+    allocator.destroy(fb);
+}
+
 export fn glk_stream_open_memory(buf: ?[*]u8, buflen: glui32, fmode: glui32, rock: glui32) callconv(.c) strid_t {
     const readable = (fmode == filemode.Read or fmode == filemode.ReadWrite);
     const writable = (fmode != filemode.Read);
 
-    const stream = allocator.create(StreamData) catch return null;
+    const stream = state.stream_pool.create() catch return null;
+    const id = state.streams.insert(stream);
+    if (id == 0) {
+        state.stream_pool.destroy(stream);
+        return null;
+    }
     stream.* = StreamData{
-        .id = state.stream_id_counter,
+        .id = id,
         .rock = rock,
         .stream_type = .memory,
         .readable = readable,
@@ -106,7 +147,6 @@ export fn glk_stream_open_memory(buf: ?[*]u8, buflen: glui32, fmode: glui32, roc
         .buflen = buflen,
         .is_unicode = false,
     };
-    state.stream_id_counter += 1;
 
     stream.next = state.stream_list;
     if (state.stream_list) |list| list.prev = stream;
@@ -135,9 +175,14 @@ export fn glk_stream_open_memory_uni(buf: ?[*]glui32, buflen: glui32, fmode: glu
     const readable = (fmode == filemode.Read or fmode == filemode.ReadWrite);
     const writable = (fmode != filemode.Read);
 
-    const stream = allocator.create(StreamData) catch return null;
+    const stream = state.stream_pool.create() catch return null;
+    const id = state.streams.insert(stream);
+    if (id == 0) {
+        state.stream_pool.destroy(stream);
+        return null;
+    }
     stream.* = StreamData{
-        .id = state.stream_id_counter,
+        .id = id,
         .rock = rock,
         .stream_type = .memory,
         .readable = readable,
@@ -146,7 +191,6 @@ export fn glk_stream_open_memory_uni(buf: ?[*]glui32, buflen: glui32, fmode: glu
         .buflen = buflen,
         .is_unicode = true,
     };
-    state.stream_id_counter += 1;
 
     stream.next = state.stream_list;
     if (state.stream_list) |list| list.prev = stream;
@@ -175,16 +219,20 @@ export fn glk_stream_open_file_uni(fref: frefid_t, fmode: glui32, rock: glui32)
 
 // Create window stream (internal helper)
 pub fn createWindowStream(win: *WindowData) ?*StreamData {
-    const stream = allocator.create(StreamData) catch return null;
+    const stream = state.stream_pool.create() catch return null;
+    const id = state.streams.insert(stream);
+    if (id == 0) {
+        state.stream_pool.destroy(stream);
+        return null;
+    }
     stream.* = StreamData{
-        .id = state.stream_id_counter,
+        .id = id,
         .rock = 0,
         .stream_type = .window,
         .readable = false,
         .writable = true,
         .win = win,
     };
-    state.stream_id_counter += 1;
 
     // Add to list
     stream.next = state.stream_list;
@@ -211,10 +259,8 @@ pub export fn glk_stream_close(str_opaque: strid_t, result: ?*stream_result_t) c
         r.writecount = s.writecount;
     }
 
-    if (s.file) |f| {
-        f.sync() catch {};
-        f.close();
-    }
+    if (s.file) |fb| closeFileBuffer(fb);
+    if (s.path) |path| allocator.free(path);
 
     if (state.current_stream == s) state.current_stream = null;
 
@@ -243,8 +289,18 @@ pub export fn glk_stream_close(str_opaque: strid_t, result: ?*stream_result_t) c
     // Remove from list
     if (s.prev) |p| p.next = s.next else state.stream_list = s.next;
     if (s.next) |n| n.prev = s.prev;
+    state.streams.remove(s.id);
+
+    state.stream_pool.destroy(s);
+}
 
-    allocator.destroy(s);
+// Write back buffered file output (at glk_select and glk_exit, so files are
+// complete whenever the interpreter is waiting or has finished)
+pub fn flushFileStreams() void {
+    var str = state.stream_list;
+    while (str) |s| : (str = s.next) {
+        if (s.file) |fb| _ = fb.flush();
+    }
 }
 
 export fn glk_stream_iterate(str_opaque: strid_t, rockptr: ?*glui32) callconv(.c) strid_t {
@@ -267,22 +323,23 @@ export fn glk_stream_get_rock(str_opaque: strid_t) callconv(.c) glui32 {
     return 0;
 }
 
-export fn glk_stream_set_position(str_opaque: strid_t, pos: glsi32, mode: glui32) callconv(.c) void {
+pub export fn glk_stream_set_position(str_opaque: strid_t, pos: glsi32, mode: glui32) callconv(.c) void {
     const str: ?*StreamData = @ptrCast(@alignCast(str_opaque));
     if (str == null) return;
     const s = str.?;
 
     switch (s.stream_type) {
         .file => {
-            if (s.file) |f| {
-                switch (mode) {
-                    seekmode.Current => f.seekBy(pos) catch return,
-                    seekmode.End => f.seekFromEnd(pos) catch return,
-                    else => f.seekTo(@intCast(@max(0, pos))) catch return,
-                }
+            if (s.file) |fb| {
+                const origin: i64 = switch (mode) {
+                    seekmode.Current => @intCast(fb.position()),
+                    seekmode.End => @intCast(fb.endPosition()),
+                    else => 0,
+                };
+                _ = fb.seekTo(@intCast(@max(0, origin + pos)));
             }
         },
-        .memory => {
+        .memory, .resource => {
             if (mode == seekmode.Current) {
                 const new_pos = @as(i64, s.bufptr) + pos;
                 s.bufptr = @intCast(@max(0, @min(new_pos, s.buflen)));
@@ -304,12 +361,12 @@ export fn glk_stream_get_position(str_opaque: strid_t) callconv(.c) glui32 {
 
     switch (s.stream_type) {
         .file => {
-            if (s.file) |f| {
-                return @intCast(f.getPos() catch 0);
+            if (s.file) |fb| {
+                return @truncate(fb.position());
             }
             return 0;
         },
-        .memory => return s.bufptr,
+        .memory, .resource => return s.bufptr,
         .window => return 0,
     }
 }
@@ -341,30 +398,15 @@ pub fn putCharUniToStream(str: ?*StreamData, ch: glui32) void {
             if (s.win) |w| {
                 // For grid windows, write directly to the grid buffer
                 if (w.win_type == wintype.TextGrid) {
-                    putCharToGridWindow(w, if (ch < 256) @intCast(ch) else '?');
-                } else {
-                    // Buffer text output for other window types
-                    if (state.text_buffer_win != w) {
-                        protocol.flushTextBuffer();
-                        state.text_buffer_win = w;
-                    }
-                    // Auto-flush when buffer is nearly full to avoid silent truncation
-                    if (state.text_buffer_len >= state.text_buffer.len - 4) {
-                        protocol.flushTextBuffer();
-                        state.text_buffer_win = w;
-                    }
-                    // UTF-8 encode the character into the text buffer
-                    if (ch < 0x80) {
-                        state.text_buffer[state.text_buffer_len] = @intCast(ch);
-                        state.text_buffer_len += 1;
-                    } else {
-                        var utf8_buf: [4]u8 = undefined;
-                        const len = std.unicode.utf8Encode(@intCast(ch), &utf8_buf) catch return;
-                        for (utf8_buf[0..len]) |b| {
-                            state.text_buffer[state.text_buffer_len] = b;
-                            state.text_buffer_len += 1;
-                        }
-                    }
+                    putCharToGridWindow(w, ch);
+                } else if (w.win_type == wintype.TextBuffer) {
+                    // UTF-8 encode into the window's current style run
+                    var utf8_buf: [4]u8 = undefined;
+                    const len: usize = if (ch < 0x80) blk: {
+                        utf8_buf[0] = @intCast(ch);
+                        break :blk 1;
+                    } else std.unicode.utf8Encode(@intCast(ch), &utf8_buf) catch return;
+                    protocol.putBufferText(w.id, utf8_buf[0..len], state.current_style, state.current_hyperlink);
                 }
             }
         },
@@ -386,28 +428,29 @@ pub fn putCharUniToStream(str: ?*StreamData, ch: glui32) void {
             }
         },
         .file => {
-            if (s.file) |f| {
+            if (s.file) |fb| {
                 if (s.textmode) {
                     // Text mode: UTF-8 encode characters
                     if (ch < 0x80) {
-                        _ = f.write(&[_]u8{@intCast(ch)}) catch return;
+                        _ = fb.writeByte(@intCast(ch));
                     } else {
                         var utf8_buf: [4]u8 = undefined;
                         const len = std.unicode.utf8Encode(@intCast(ch), &utf8_buf) catch return;
-                        _ = f.write(utf8_buf[0..len]) catch return;
+                        _ = fb.write(utf8_buf[0..len]);
                     }
                 } else {
                     // Binary mode: write raw byte
-                    _ = f.write(&[_]u8{if (ch < 256) @intCast(ch) else '?'}) catch return;
+                    _ = fb.writeByte(if (ch < 256) @intCast(ch) else '?');
                 }
             }
         },
+        .resource => {}, // Read-only
     }
 }
 
 // Write a character to a grid window at the current cursor position
-fn putCharToGridWindow(w: *WindowData, ch: u8) void {
-    const grid_buf = w.grid_buffer orelse return;
+fn putCharToGridWindow(w: *WindowData, ch: glui32) void {
+    const cells = w.grid_cells orelse return;
     const dirty = w.grid_dirty orelse return;
 
     // Newline advances to next line
@@ -424,8 +467,11 @@ fn putCharToGridWindow(w: *WindowData, ch: u8) void {
 
     // Write character if within bounds
     if (w.cursor_y < w.grid_height and w.cursor_x < w.grid_width) {
-        grid_buf[w.cursor_y][w.cursor_x] = ch;
-        dirty[w.cursor_y] = true;
+        cells[w.cursor_y * w.grid_width + w.cursor_x] = .{
+            .ch = if (ch <= 0x10FFFF) @intCast(ch) else '?',
+            .style = @truncate(state.current_style),
+        };
+        dirty[w.cursor_y].add(w.cursor_x);
 
         // Advance cursor
         w.cursor_x += 1;
@@ -452,30 +498,134 @@ export fn glk_put_string(s: ?[*:0]const u8) callconv(.c) void {
 
 export fn glk_put_string_stream(str_opaque: strid_t, s: ?[*:0]const u8) callconv(.c) void {
     const s_ptr = s orelse return;
-    const str: ?*StreamData = @ptrCast(@alignCast(str_opaque));
-    for (std.mem.span(s_ptr)) |ch| {
-        putCharToStream(str, ch);
-    }
+    putSliceToStream(@ptrCast(@alignCast(str_opaque)), u8, std.mem.span(s_ptr));
 }
 
 export fn glk_put_buffer(buf: ?[*]const u8, len: glui32) callconv(.c) void {
     glk_put_buffer_stream(@ptrCast(state.current_stream), buf, len);
 }
 
-export fn glk_put_buffer_stream(str_opaque: strid_t, buf: ?[*]const u8, len: glui32) callconv(.c) void {
+pub export fn glk_put_buffer_stream(str_opaque: strid_t, buf: ?[*]const u8, len: glui32) callconv(.c) void {
     const buf_ptr = buf orelse return;
-    const str: ?*StreamData = @ptrCast(@alignCast(str_opaque));
-    for (buf_ptr[0..len]) |ch| {
-        putCharToStream(str, ch);
+    putSliceToStream(@ptrCast(@alignCast(str_opaque)), u8, buf_ptr[0..len]);
+}
+
+/// Write a whole string to a stream: Latin-1 bytes (T = u8) or Unicode
+/// characters (T = glui32). Same result as putCharUniToStream per character,
+/// but the stream is dispatched once and text reaches buffer windows, memory
+/// streams and files as a single copy.
+pub fn putSliceToStream(str: ?*StreamData, comptime T: type, chars: []const T) void {
+    if (str == null or !str.?.writable or chars.len == 0) return;
+    const s = str.?;
+    s.writecount += @intCast(chars.len);
+
+    switch (s.stream_type) {
+        .window => {
+            const w = s.win orelse return;
+            if (w.win_type == wintype.TextGrid) {
+                for (chars) |ch| putCharToGridWindow(w, ch);
+            } else if (w.win_type == wintype.TextBuffer) {
+                const text = encodeUtf8(T, chars) orelse return;
+                protocol.putBufferText(w.id, text, state.current_style, state.current_hyperlink);
+            }
+        },
+        .memory => {
+            const n = @min(chars.len, s.buflen -| s.bufptr);
+            if (s.is_unicode) {
+                const dest = (s.buf_uni orelse return)[s.bufptr..][0..n];
+                if (T == glui32) {
+                    @memcpy(dest, chars[0..n]);
+                } else {
+                    for (dest, chars[0..n]) |*d, ch| d.* = ch;
+                }
+            } else {
+                const dest = (s.buf orelse return)[s.bufptr..][0..n];
+                if (T == u8) {
+                    @memcpy(dest, chars[0..n]);
+                } else {
+                    for (dest, chars[0..n]) |*d, ch| d.* = if (ch < 256) @intCast(ch) else '?';
+                }
+            }
+            s.bufptr += @intCast(n);
+        },
+        .file => {
+            const fb = s.file orelse return;
+            if (s.textmode) {
+                _ = fb.write(encodeUtf8(T, chars) orelse return);
+            } else if (T == u8) {
+                _ = fb.write(chars);
+            } else {
+                // Binary mode: one raw byte per character
+                for (chars) |ch| _ = fb.writeByte(if (ch < 256) @intCast(ch) else '?');
+            }
+        },
+        .resource => {}, // Read-only
     }
 }
 
-export fn glk_set_style(styl: glui32) callconv(.c) void {
-    // Flush current buffer before changing style (so previous text keeps its style)
-    if (state.current_style != styl) {
-        protocol.flushTextBuffer();
-        state.current_style = styl;
+// Scratch space for encodeUtf8, kept between calls
+var utf8_scratch: std.ArrayListUnmanaged(u8) = .empty;
+
+// UTF-8 encode Latin-1 bytes or Unicode characters. ASCII-only byte strings
+// are returned as they are; otherwise the result lives in utf8_scratch until
+// the next call. Returns null if the scratch buffer cannot grow.
+fn encodeUtf8(comptime T: type, chars: []const T) ?[]const u8 {
+    if (T == u8) {
+        if (isAscii(chars)) return chars;
+    }
+
+    const max_len = if (T == u8) 2 else 4; // Bytes per character
+    utf8_scratch.clearRetainingCapacity();
+    utf8_scratch.ensureTotalCapacity(allocator, chars.len * max_len) catch return null;
+    const out = utf8_scratch.allocatedSlice();
+
+    const lanes = 16;
+    var n: usize = 0;
+    var i: usize = 0;
+    while (i < chars.len) {
+        // Copy ASCII a vector at a time
+        if (i + lanes <= chars.len) {
+            const v: @Vector(lanes, T) = chars[i..][0..lanes].*;
+            if (@reduce(.Max, v) < 0x80) {
+                const narrow: @Vector(lanes, u8) = @truncate(v);
+                out[n..][0..lanes].* = narrow;
+                n += lanes;
+                i += lanes;
+                continue;
+            }
+        }
+        const ch: glui32 = chars[i];
+        i += 1;
+        if (ch < 0x80) {
+            out[n] = @intCast(ch);
+            n += 1;
+        } else {
+            const cp: u21 = if (ch <= 0x10FFFF) @intCast(ch) else '?';
+            n += std.unicode.utf8Encode(cp, out[n..]) catch blk: {
+                out[n] = '?'; // Surrogate halves
+                break :blk 1;
+            };
+        }
+    }
+    return out[0..n];
+}
+
+fn isAscii(bytes: []const u8) bool {
+    const lanes = 16;
+    var i: usize = 0;
+    while (i + lanes <= bytes.len) : (i += lanes) {
+        const v: @Vector(lanes, u8) = bytes[i..][0..lanes].*;
+        if (@reduce(.Or, v) & 0x80 != 0) return false;
     }
+    for (bytes[i..]) |b| {
+        if (b & 0x80 != 0) return false;
+    }
+    return true;
+}
+
+export fn glk_set_style(styl: glui32) callconv(.c) void {
+    // Text written from now on starts a new style run
+    state.current_style = styl;
 }
 
 export fn glk_set_style_stream(str_opaque: strid_t, styl: glui32) callconv(.c) void {
@@ -523,14 +673,12 @@ pub fn getCharUniFromStream(str: ?*StreamData) glsi32 {
             return -1;
         },
         .file => {
-            if (s.file) |f| {
-                var byte: [1]u8 = undefined;
-                const n = f.read(&byte) catch return -1;
-                if (n == 0) return -1;
-                return byte[0];
+            if (s.file) |fb| {
+                return fb.readByte() orelse -1;
             }
             return -1;
         },
+        .resource => return getCharFromResource(s),
         .window => return -1,
     }
 }
@@ -570,18 +718,26 @@ export fn glk_get_line_stream(str_opaque: strid_t, buf: ?[*]u8, len: glui32) cal
             }
         },
         .file => {
-            if (s.file) |f| {
+            if (s.file) |fb| {
                 while (count < len - 1) {
-                    var byte: [1]u8 = undefined;
-                    const n = f.read(&byte) catch break;
-                    if (n == 0) break;
-                    b[count] = byte[0];
+                    const byte = fb.readByte() orelse break;
+                    b[count] = byte;
                     count += 1;
                     s.readcount += 1;
-                    if (byte[0] == '\n') break;
+                    if (byte == '\n') break;
                 }
             }
         },
+        .resource => {
+            while (count < len - 1) {
+                var byte: [1]u8 = undefined;
+                if (readResource(s, &byte) == 0) break;
+                b[count] = byte[0];
+                count += 1;
+                s.readcount += 1;
+                if (byte[0] == '\n') break;
+            }
+        },
         .window => {},
     }
 
@@ -589,7 +745,7 @@ export fn glk_get_line_stream(str_opaque: strid_t, buf: ?[*]u8, len: glui32) cal
     return count;
 }
 
-export fn glk_get_buffer_stream(str_opaque: strid_t, buf: ?[*]u8, len: glui32) callconv(.c) glui32 {
+pub export fn glk_get_buffer_stream(str_opaque: strid_t, buf: ?[*]u8, len: glui32) callconv(.c) glui32 {
     const str: ?*StreamData = @ptrCast(@alignCast(str_opaque));
     if (str == null or !str.?.readable or buf == null) return 0;
     const s = str.?;
@@ -620,27 +776,192 @@ export fn glk_get_buffer_stream(str_opaque: strid_t, buf: ?[*]u8, len: glui32) c
             }
         },
         .file => {
-            if (s.file) |f| {
-                const slice = b[0..len];
-                count = @intCast(f.read(slice) catch 0);
+            if (s.file) |fb| {
+                count = @intCast(fb.read(b[0..len]));
                 s.readcount += count;
             }
         },
+        .resource => {
+            count = @intCast(readResource(s, b[0..len]));
+            s.readcount += count;
+        },
         .window => {},
     }
 
     return count;
 }
 
-// Resource streams (stubs)
+// ============== Resource Streams ==============
+
+// Resource streams read their chunk in place, so opening one copies nothing:
+// from the in-memory Blorb file (blorb.blorb_data) when there is one, and
+// otherwise through the Blorb stream's buffer, restoring that stream's own
+// position after each read.
+
 export fn glk_stream_open_resource(filenum: glui32, rock: glui32) callconv(.c) strid_t {
-    _ = filenum;
-    _ = rock;
-    return null;
+    return openResourceStream(filenum, rock, false);
 }
 
 export fn glk_stream_open_resource_uni(filenum: glui32, rock: glui32) callconv(.c) strid_t {
-    _ = filenum;
-    _ = rock;
-    return null;
+    return openResourceStream(filenum, rock, true);
+}
+
+fn openResourceStream(filenum: glui32, rock: glui32, is_unicode: bool) ?*StreamData {
+    const map = blorb.blorb_map orelse return null;
+    var res: blorb.giblorb_result_t = undefined;
+    if (blorb.giblorb_load_resource(map, blorb.giblorb_method_FilePos, &res, blorb.giblorb_ID_Data, filenum) != 0) return null;
+
+    const stream = state.stream_pool.create() catch return null;
+    const id = state.streams.insert(stream);
+    if (id == 0) {
+        state.stream_pool.destroy(stream);
+        return null;
+    }
+    stream.* = StreamData{
+        .id = id,
+        .rock = rock,
+        .stream_type = .resource,
+        .readable = true,
+        .writable = false,
+        // For FORM chunks gi_blorb already points at the FORM header and
+        // includes it in the length, as the Glk spec requires
+        .res_start = res.data.startpos,
+        .buflen = res.length,
+        .is_unicode = is_unicode,
+        .textmode = res.chunktype == blorb.giblorb_ID_TEXT,
+    };
+
+    stream.next = state.stream_list;
+    if (state.stream_list) |list| list.prev = stream;
+    state.stream_list = stream;
+
+    if (dispatch.object_register_fn) |register_fn| {
+        stream.dispatch_rock = register_fn(@ptrCast(stream), dispatch.gidisp_Class_Stream);
+    }
+
+    return stream;
+}
+
+// Read up to dest.len bytes of the chunk at the stream position
+fn readResource(s: *StreamData, dest: []u8) usize {
+    const n = @min(dest.len, s.buflen -| s.bufptr);
+    if (n == 0) return 0;
+
+    // Copy straight from the in-memory Blorb file when there is one
+    if (blorb.blorb_data) |data| {
+        const start: usize = @intCast(s.res_start + s.bufptr);
+        if (start + n > data.len) return 0;
+        @memcpy(dest[0..n], data[start..][0..n]);
+        s.bufptr += @intCast(n);
+        return n;
+    }
+
+    const blorb_stream: *StreamData = @ptrCast(@alignCast(blorb.blorb_file orelse return 0));
+    const fb = blorb_stream.file orelse return 0;
+
+    const saved = fb.position();
+    defer _ = fb.seekTo(saved);
+    if (!fb.seekTo(s.res_start + s.bufptr)) return 0;
+    const count = fb.read(dest[0..n]);
+    s.bufptr += @intCast(count);
+    return count;
+}
+
+// Read one character. Byte streams return bytes; Unicode streams decode UTF-8
+// from TEXT chunks and big-endian 32-bit values from binary chunks.
+fn getCharFromResource(s: *StreamData) glsi32 {
+    var bytes: [4]u8 = undefined;
+    if (!s.is_unicode) {
+        return if (readResource(s, bytes[0..1]) == 1) @as(glsi32, bytes[0]) else -1;
+    }
+    if (!s.textmode) {
+        if (readResource(s, &bytes) != 4) return -1;
+        return @bitCast(std.mem.readInt(glui32, &bytes, .big));
+    }
+    if (readResource(s, bytes[0..1]) != 1) return -1;
+    const len = std.unicode.utf8ByteSequenceLength(bytes[0]) catch return '?';
+    if (len > 1 and readResource(s, bytes[1..len]) != len - 1) return -1;
+    const ch = std.unicode.utf8Decode(bytes[0..len]) catch return '?';
+    return @intCast(ch);
+}
+
+// ============== Tests ==============
+
+const testing = std.testing;
+
+test "resource streams read their chunk in place" {
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const file = try tmp.dir.createFile("story.blb", .{ .read = true });
+    defer file.close();
+    // Chunk data starts at offset 4: "h\u{e9}!" in UTF-8, then one BE word
+    try file.writeAll("FORM" ++ "h\xc3\xa9!" ++ "\x00\x00\x01\x00");
+
+    var fb = FileBuffer.init(file);
+    var blorb_stream = StreamData{ .id = 0, .rock = 0, .stream_type = .file, .readable = true, .writable = false, .file = &fb };
+    blorb.blorb_file = @ptrCast(&blorb_stream);
+    defer blorb.blorb_file = null;
+    try testing.expect(fb.seekTo(2));
+
+    var text = StreamData{ .id = 0, .rock = 0, .stream_type = .resource, .readable = true, .writable = false, .res_start = 4, .buflen = 4, .is_unicode = true, .textmode = true };
+    try testing.expectEqual(@as(glsi32, 'h'), getCharUniFromStream(&text));
+    try testing.expectEqual(@as(glsi32, 0xe9), getCharUniFromStream(&text));
+    try testing.expectEqual(@as(glsi32, '!'), getCharUniFromStream(&text));
+    try testing.expectEqual(@as(glsi32, -1), getCharUniFromStream(&text));
+
+    var binary = StreamData{ .id = 0, .rock = 0, .stream_type = .resource, .readable = true, .writable = false, .res_start = 8, .buflen = 4, .is_unicode = true };
+    try testing.expectEqual(@as(glsi32, 0x100), getCharUniFromStream(&binary));
+
+    var bytes = StreamData{ .id = 0, .rock = 0, .stream_type = .resource, .readable = true, .writable = false, .res_start = 4, .buflen = 4 };
+    var buf: [8]u8 = undefined;
+    try testing.expectEqual(@as(glui32, 4), glk_get_buffer_stream(@ptrCast(&bytes), &buf, buf.len));
+    try testing.expectEqualStrings("h\xc3\xa9!", buf[0..4]);
+
+    // The Blorb stream's own position is untouched
+    try testing.expectEqual(@as(u64, 2), fb.position());
+}
+
+test "putSliceToStream writes whole strings to memory streams" {
+    var bytes: [6]u8 = undefined;
+    var narrow = StreamData{ .id = 0, .rock = 0, .stream_type = .memory, .readable = false, .writable = true, .buf = &bytes, .buflen = bytes.len };
+    putSliceToStream(&narrow, glui32, &[_]glui32{ 'a', 0xe9, 0x263a, 'b' });
+    putSliceToStream(&narrow, u8, "xyz"); // Truncated at the end of the buffer
+    try testing.expectEqualStrings("a\xe9?bxy", &bytes);
+    try testing.expectEqual(@as(glui32, 7), narrow.writecount);
+
+    var chars: [4]glui32 = undefined;
+    var wide = StreamData{ .id = 0, .rock = 0, .stream_type = .memory, .readable = false, .writable = true, .buf_uni = &chars, .buflen = chars.len, .is_unicode = true };
+    putSliceToStream(&wide, u8, "h\xe9");
+    putSliceToStream(&wide, glui32, &[_]glui32{0x263a});
+    try testing.expectEqualSlices(glui32, &[_]glui32{ 'h', 0xe9, 0x263a }, chars[0..wide.bufptr]);
+}
+
+test "encodeUtf8 handles ASCII runs and multi-byte characters" {
+    const ascii = "The quick brown fox jumps over the lazy dog";
+    try testing.expectEqual(@as([*]const u8, ascii.ptr), encodeUtf8(u8, ascii).?.ptr);
+    try testing.expectEqualStrings("caf\xc3\xa9", encodeUtf8(u8, "caf\xe9").?);
+
+    var uni: [20]glui32 = undefined;
+    for (&uni, 0..) |*c, i| c.* = 'a' + @as(glui32, @intCast(i));
+    uni[17] = 0x1F600;
+    try testing.expectEqualStrings("abcdefghijklmnopq\xf0\x9f\x98\x80st", encodeUtf8(glui32, &uni).?);
+}
+
+test "glk_put_buffer_stream encodes a buffer of high Latin-1 bytes to a text file" {
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const file = try tmp.dir.createFile("out.txt", .{ .read = true });
+    defer file.close();
+
+    // Start from an empty scratch buffer so it is sized for exactly this call
+    utf8_scratch.clearAndFree(allocator);
+    var fb = FileBuffer.init(file);
+    var text = StreamData{ .id = 0, .rock = 0, .stream_type = .file, .readable = false, .writable = true, .file = &fb, .textmode = true };
+    const latin1 = [_]u8{0xe9} ** 32;
+    glk_put_buffer_stream(@ptrCast(&text), &latin1, latin1.len);
+    _ = fb.flush();
+
+    var buf: [80]u8 = undefined;
+    const len = try file.preadAll(&buf, 0);
+    try testing.expectEqualStrings("\xc3\xa9" ** 32, buf[0..len]);
 }
@@ -75,11 +75,8 @@ export fn glk_set_terminators_line_event(win_opaque: winid_t, keycodes_ptr: ?[*]
 
 // Hyperlinks
 export fn glk_set_hyperlink(linkval: glui32) callconv(.c) void {
-    // Flush current buffer before changing hyperlink (so previous text keeps its link value)
-    if (state.current_hyperlink != linkval) {
-        protocol.flushTextBuffer();
-        state.current_hyperlink = linkval;
-    }
+    // Text written from now on starts a new run with this link value
+    state.current_hyperlink = linkval;
 }
 
 export fn glk_set_hyperlink_stream(str_opaque: strid_t, linkval: glui32) callconv(.c) void {
@@ -96,14 +93,14 @@ export fn glk_request_hyperlink_event(win_opaque: winid_t) callconv(.c) void {
     if (win == null) return;
     // Hyperlink events are meaningful for buffer and grid windows
     if (win.?.win_type == types.wintype.TextBuffer or win.?.win_type == types.wintype.TextGrid) {
-        win.?.hyperlink_request = true;
+        state.setHyperlinkRequest(win.?, true);
     }
 }
 
 export fn glk_cancel_hyperlink_event(win_opaque: winid_t) callconv(.c) void {
     const win: ?*WindowData = @ptrCast(@alignCast(win_opaque));
     if (win == null) return;
-    win.?.hyperlink_request = false;
+    state.setHyperlinkRequest(win.?, false);
 }
 
 // Debug stream support per GlkOte spec
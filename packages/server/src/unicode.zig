@@ -174,17 +174,12 @@ export fn glk_put_char_uni(ch: glui32) callconv(.c) void {
 
 export fn glk_put_string_uni(s: ?[*:0]const glui32) callconv(.c) void {
     const s_ptr = s orelse return;
-    var ptr = s_ptr;
-    while (ptr[0] != 0) : (ptr += 1) {
-        stream.putCharUniToStream(state.current_stream, ptr[0]);
-    }
+    stream.putSliceToStream(state.current_stream, glui32, std.mem.span(s_ptr));
 }
 
 export fn glk_put_buffer_uni(buf: ?[*]const glui32, len: glui32) callconv(.c) void {
     const buf_ptr = buf orelse return;
-    for (buf_ptr[0..len]) |ch| {
-        stream.putCharUniToStream(state.current_stream, ch);
-    }
+    stream.putSliceToStream(state.current_stream, glui32, buf_ptr[0..len]);
 }
 
 export fn glk_put_char_stream_uni(str: strid_t, ch: glui32) callconv(.c) void {
@@ -194,18 +189,13 @@ export fn glk_put_char_stream_uni(str: strid_t, ch: glui32) callconv(.c) void {
 export fn glk_put_string_stream_uni(str: strid_t, s: ?[*:0]const glui32) callconv(.c) void {
     const s_ptr = s orelse return;
     const str_data = @as(?*state.StreamData, @ptrCast(@alignCast(str)));
-    var ptr = s_ptr;
-    while (ptr[0] != 0) : (ptr += 1) {
-        stream.putCharUniToStream(str_data, ptr[0]);
-    }
+    stream.putSliceToStream(str_data, glui32, std.mem.span(s_ptr));
 }
 
 export fn glk_put_buffer_stream_uni(str: strid_t, buf: ?[*]const glui32, len: glui32) callconv(.c) void {
     const buf_ptr = buf orelse return;
     const str_data = @as(?*state.StreamData, @ptrCast(@alignCast(str)));
-    for (buf_ptr[0..len]) |ch| {
-        stream.putCharUniToStream(str_data, ch);
-    }
+    stream.putSliceToStream(str_data, glui32, buf_ptr[0..len]);
 }
 
 // ============== Unicode Input ==============
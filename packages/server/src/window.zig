@@ -6,6 +6,7 @@ const state = @import("state.zig");
 const stream = @import("stream.zig");
 const dispatch = @import("dispatch.zig");
 const protocol = @import("protocol.zig");
+const graphics = @import("graphics.zig");
 
 const glui32 = types.glui32;
 const winid_t = types.winid_t;
@@ -26,33 +27,19 @@ export fn glk_window_open(split_opaque: winid_t, method: glui32, size: glui32, w
     protocol.ensureGlkInitialized();
 
     // Create the new window
-    const win = allocator.create(WindowData) catch return null;
+    const win = state.window_pool.create() catch return null;
+    const id = state.windows.insert(win);
+    if (id == 0) {
+        state.window_pool.destroy(win);
+        return null;
+    }
     win.* = WindowData{
-        .id = state.window_id_counter,
+        .id = id,
         .rock = rock,
         .win_type = win_type,
     };
-    state.window_id_counter += 1;
-
-    // Initialize grid buffer for grid windows
-    if (win_type == types.wintype.TextGrid) {
-        win.grid_buffer = allocator.create([state.MAX_GRID_HEIGHT][state.MAX_GRID_WIDTH]u8) catch {
-            allocator.destroy(win);
-            return null;
-        };
-        win.grid_dirty = allocator.create([state.MAX_GRID_HEIGHT]bool) catch {
-            allocator.destroy(win.grid_buffer.?);
-            allocator.destroy(win);
-            return null;
-        };
-        // Initialize grid with spaces
-        for (win.grid_buffer.?) |*row| {
-            @memset(row, ' ');
-        }
-        // Clear dirty flags
-        @memset(win.grid_dirty.?, false);
-    }
 
+    // Grid windows get their cell storage from the layout below
     // Add to window list
     win.next = state.window_list;
     if (state.window_list) |list| list.prev = win;
@@ -67,22 +54,27 @@ export fn glk_window_open(split_opaque: winid_t, method: glui32, size: glui32, w
         state.current_stream = win.stream;
     } else {
         // Split an existing window - create a pair window
-        const pair = allocator.create(WindowData) catch {
+        const pair = state.window_pool.create() catch {
             // Cleanup on failure
-            if (win.grid_buffer) |buf| allocator.destroy(buf);
-            if (win.grid_dirty) |dirty| allocator.destroy(dirty);
-            allocator.destroy(win);
+            state.windows.remove(win.id);
+            state.window_pool.destroy(win);
             return null;
         };
+        const pair_id = state.windows.insert(pair);
+        if (pair_id == 0) {
+            state.window_pool.destroy(pair);
+            state.windows.remove(win.id);
+            state.window_pool.destroy(win);
+            return null;
+        }
         pair.* = WindowData{
-            .id = state.window_id_counter,
+            .id = pair_id,
             .rock = 0,
             .win_type = types.wintype.Pair,
             .split_method = method,
             .split_size = size,
             .split_key = win, // The new window is the key window
         };
-        state.window_id_counter += 1;
 
         // Add pair to window list
         pair.next = state.window_list;
@@ -132,9 +124,8 @@ export fn glk_window_open(split_opaque: winid_t, method: glui32, size: glui32, w
     // Recalculate window layout
     recalculateLayout();
 
-    // Queue window updates for all visible windows
-    queueAllWindowUpdates();
-    protocol.sendUpdate();
+    // Resend the window list with the next update
+    protocol.queueWindowsUpdate();
 
     return @ptrCast(win);
 }
@@ -161,26 +152,46 @@ export fn glk_window_close(win_opaque: winid_t, result: ?*stream_result_t) callc
         w.stream = null;
     }
 
+    // Drop pending requests so the request counts and list stay accurate
+    state.setMouseRequest(w, false);
+    state.setHyperlinkRequest(w, false);
+    w.char_request = false;
+    w.line_request = false;
+    w.char_request_uni = false;
+    w.line_request_uni = false;
+    state.syncTextRequest(w);
+
+    // Output still queued for this window has nowhere to go
+    protocol.discardWindowContent(w);
+    protocol.queueWindowsUpdate();
+
     // Unregister from dispatch system
     if (dispatch.object_unregister_fn) |unregister_fn| {
         unregister_fn(@ptrCast(w), dispatch.gidisp_Class_Window, w.dispatch_rock);
     }
 
     // Free grid buffer if allocated
-    if (w.grid_buffer) |buf| {
-        allocator.destroy(buf);
+    if (w.grid_cells) |cells| {
+        allocator.free(cells);
     }
     if (w.grid_dirty) |dirty| {
-        allocator.destroy(dirty);
+        allocator.free(dirty);
+    }
+    if (w.grid_sent) |sent| {
+        allocator.free(sent);
+    }
+    if (w.gfx_pixels) |pixels| {
+        allocator.free(pixels);
     }
 
     // Remove from list
     if (w.prev) |p| p.next = w.next else state.window_list = w.next;
     if (w.next) |n| n.prev = w.prev;
+    state.windows.remove(w.id);
 
     if (state.root_window == w) state.root_window = null;
 
-    allocator.destroy(w);
+    state.window_pool.destroy(w);
 }
 
 export fn glk_window_get_size(win_opaque: winid_t, widthptr: ?*glui32, heightptr: ?*glui32) callconv(.c) void {
@@ -188,7 +199,11 @@ export fn glk_window_get_size(win_opaque: winid_t, widthptr: ?*glui32, heightptr
     if (win) |w| {
         // For grid/buffer windows, return size in character cells
         // For graphics windows, return size in pixels
-        if (w.win_type == types.wintype.TextGrid or w.win_type == types.wintype.TextBuffer) {
+        if (w.win_type == types.wintype.TextGrid and w.grid_cells != null) {
+            // Grid windows report the size of their cell storage
+            if (widthptr) |wp| wp.* = w.grid_width;
+            if (heightptr) |hp| hp.* = w.grid_height;
+        } else if (w.win_type == types.wintype.TextGrid or w.win_type == types.wintype.TextBuffer) {
             // TODO: Use actual character metrics
             const char_width: u32 = 1;
             const char_height: u32 = 1;
@@ -224,9 +239,8 @@ export fn glk_window_set_arrangement(win_opaque: winid_t, method: glui32, size:
     // Recalculate layout after arrangement change
     recalculateLayout();
 
-    // Queue window updates for all visible windows
-    queueAllWindowUpdates();
-    protocol.sendUpdate();
+    // Resend the window list with the next update
+    protocol.queueWindowsUpdate();
 }
 
 export fn glk_window_get_arrangement(win_opaque: winid_t, methodptr: ?*glui32, sizeptr: ?*glui32, keywinptr: ?*winid_t) callconv(.c) void {
@@ -300,24 +314,25 @@ export fn glk_window_clear(win_opaque: winid_t) callconv(.c) void {
     if (win == null) return;
     const w = win.?;
 
-    protocol.flushTextBuffer();
-
     // For grid windows, also clear the grid buffer and reset cursor
     if (w.win_type == types.wintype.TextGrid) {
-        if (w.grid_buffer) |buf| {
-            for (buf) |*row| {
-                @memset(row, ' ');
-            }
+        // The client blanks the grid itself on clear
+        if (w.grid_cells) |cells| {
+            @memset(cells, .{});
+        }
+        if (w.grid_sent) |sent| {
+            @memset(sent, .{});
         }
         if (w.grid_dirty) |dirty| {
-            @memset(dirty, false);
+            @memset(dirty, .{});
         }
         w.cursor_x = 0;
         w.cursor_y = 0;
+    } else if (w.win_type == types.wintype.Graphics) {
+        graphics.clearFramebuffer(w);
     }
 
-    protocol.queueContentUpdate(w.id, null, true);
-    protocol.sendUpdate();
+    protocol.queueClear(w.id);
 }
 
 export fn glk_window_move_cursor(win_opaque: winid_t, xpos: glui32, ypos: glui32) callconv(.c) void {
@@ -328,9 +343,6 @@ export fn glk_window_move_cursor(win_opaque: winid_t, xpos: glui32, ypos: glui32
     // Only valid for grid windows
     if (w.win_type != types.wintype.TextGrid) return;
 
-    // Flush any pending text before moving cursor
-    protocol.flushTextBuffer();
-
     // Clamp to grid dimensions
     w.cursor_x = if (xpos < w.grid_width) xpos else w.grid_width -| 1;
     w.cursor_y = if (ypos < w.grid_height) ypos else w.grid_height -| 1;
@@ -382,6 +394,17 @@ fn layoutWindow(win: *WindowData, left: f64, top: f64, width: f64, height: f64)
     win.layout_width = width;
     win.layout_height = height;
 
+    if (win.win_type == types.wintype.TextGrid) {
+        const metrics = state.client_metrics;
+        resizeGrid(
+            win,
+            gridCells(width, metrics.gridmarginx, metrics.gridcharwidth, 80, max_grid_cols),
+            gridCells(height, metrics.gridmarginy, metrics.gridcharheight, 24, max_grid_rows),
+        );
+    } else if (win.win_type == types.wintype.Graphics) {
+        graphics.resizeFramebuffer(win, @intFromFloat(@max(0, width)), @intFromFloat(@max(0, height)));
+    }
+
     // If this is a pair window, split the space between children
     if (win.win_type == types.wintype.Pair) {
         const child1 = win.child1 orelse return;
@@ -437,13 +460,68 @@ fn layoutWindow(win: *WindowData, left: f64, top: f64, width: f64, height: f64)
     }
 }
 
-/// Queue window updates for all non-pair windows
-fn queueAllWindowUpdates() void {
-    var win = state.window_list;
-    while (win) |w| : (win = w.next) {
-        // Only send updates for non-pair windows
-        if (w.win_type != types.wintype.Pair) {
-            protocol.queueWindowUpdate(w);
+// Upper bound on grid storage, whatever the metrics claim
+const max_grid_cols = 512;
+const max_grid_rows = 256;
+
+// Character cells that fit in a layout dimension, less the window's margins
+fn gridCells(size: f64, margin: f64, char_size: f64, default: glui32, max: glui32) glui32 {
+    if (size < 1) return default;
+    const cells = @floor((size - margin) / char_size);
+    return @intFromFloat(std.math.clamp(cells, 0, @as(f64, @floatFromInt(max))));
+}
+
+/// Size a grid window's cell storage to its layout, keeping the overlapping
+/// content. Every line is marked dirty so the client redraws the new grid.
+pub fn resizeGrid(win: *WindowData, cols: glui32, rows: glui32) void {
+    if (win.grid_cells != null and cols == win.grid_width and rows == win.grid_height) return;
+
+    const count = @as(usize, cols) * rows;
+    const cells = allocator.alloc(state.GridCell, count) catch return;
+    const sent = allocator.alloc(state.GridCell, count) catch {
+        allocator.free(cells);
+        return;
+    };
+    const dirty = allocator.alloc(state.GridDirty, rows) catch {
+        allocator.free(cells);
+        allocator.free(sent);
+        return;
+    };
+    @memset(cells, .{});
+    // No real cell has codepoint 0, so every line differs from what was "sent"
+    @memset(sent, .{ .ch = 0 });
+    @memset(dirty, .{ .start = 0, .end = cols });
+
+    if (win.grid_cells) |old| {
+        const copy_cols = @min(cols, win.grid_width);
+        for (0..@min(rows, win.grid_height)) |y| {
+            @memcpy(cells[y * cols ..][0..copy_cols], old[y * win.grid_width ..][0..copy_cols]);
         }
+        allocator.free(old);
     }
+    if (win.grid_sent) |old| allocator.free(old);
+    if (win.grid_dirty) |old| allocator.free(old);
+
+    win.grid_cells = cells;
+    win.grid_sent = sent;
+    win.grid_dirty = dirty;
+    win.grid_width = cols;
+    win.grid_height = rows;
+    win.cursor_x = @min(win.cursor_x, cols -| 1);
+    win.cursor_y = @min(win.cursor_y, rows -| 1);
+}
+
+// ============== Tests ==============
+
+const testing = std.testing;
+
+test "gridCells converts layout units to character cells" {
+    // Pixel layout: 800 wide, 8px cells, 10px of margin
+    try testing.expectEqual(@as(glui32, 98), gridCells(800, 10, 8, 80, max_grid_cols));
+    // Character-unit layout (the default metrics)
+    try testing.expectEqual(@as(glui32, 80), gridCells(80, 0, 1, 80, max_grid_cols));
+    // Bounded whatever the metrics say, and never negative
+    try testing.expectEqual(@as(glui32, max_grid_cols), gridCells(100000, 0, 1, 80, max_grid_cols));
+    try testing.expectEqual(@as(glui32, 0), gridCells(5, 10, 8, 80, max_grid_cols));
+    try testing.expectEqual(@as(glui32, 24), gridCells(0, 0, 1, 24, max_grid_rows));
 }
@@ -0,0 +1,343 @@
+#!/usr/bin/env bun
+/**
+ * Bench: I/O-path benchmarks for wasiglk interpreters.
+ *
+ * Replays the commands from a regtest file through an interpreter and reports
+ * how much RemGlk output each turn produces and how many heap allocations the
+ * Glk layer makes per turn. Allocation counts come from the `wasiglk-stats`
+ * line the interpreter writes to stderr on exit when WASIGLK_STATS is set.
+ *
+ * With --events, instead measures how many input events per second go through
+ * glk_select: a fixed command is sent repeatedly as fast as the interpreter
+ * answers, and the stdin read() calls per event are reported.
+ *
+ * With --saves, saves and restores the game state repeatedly (Glulx games by
+ * default) to time the file stream path.
+ *
+ * Usage:
+ *   bun bench.ts                            # glulxercise + advent regtests
+ *   bun bench.ts advent.ulx                 # regtests matching a name
+ *   bun bench.ts --events [name]            # events/second through glk_select
+ *   bun bench.ts --saves [name]             # save/restore round trips
+ *
+ * Environment:
+ *   INTERP_DIR  - Path to interpreter binaries (default: ../zig-out/bin)
+ *   PLATFORM    - 'native' or 'wasm' (default: native)
+ */
+
+import {readFileSync, readdirSync, existsSync, statSync, unlinkSync} from "fs";
+import {join, dirname, basename} from "path";
+
+const scriptDir = dirname(new URL(import.meta.url).pathname);
+const interpDir = process.env.INTERP_DIR || join(scriptDir, "../zig-out/bin");
+const platform = process.env.PLATFORM || "native";
+
+const defaultGames = ["glulxercise.ulx", "advent.ulx", "advent.z5"];
+
+interface Session {
+    gamefile: string;
+    commands: {type: string; value: string}[];
+}
+
+interface Stats {
+    updates: number;
+    bytes: number;
+    events: number;
+    reads: number;
+    allocs: number;
+    frees: number;
+    arena_grows: number;
+    arena_capacity: number;
+    pool_hits: number;
+    pool_misses: number;
+}
+
+// ---------------------------------------------------------------------------
+// Regtest parsing (commands only, checks are ignored)
+// ---------------------------------------------------------------------------
+
+function parseSessions(regtestFile: string): Session[] {
+    const content = readFileSync(regtestFile, "utf-8");
+    const gamefile = content.match(/^\*\* game:\s*(.+)/m)?.[1].trim();
+    if (!gamefile) return [];
+
+    const sessions: Session[] = [];
+    for (const raw of content.split("\n")) {
+        const ln = raw.trim();
+        if (ln.startsWith("**")) continue;
+        if (ln.startsWith("*")) {
+            sessions.push({gamefile, commands: []});
+        } else if (ln.startsWith(">") && sessions.length > 0) {
+            const cmd = ln.slice(1);
+            const match = cmd.match(/^\{([a-z_]*)\}/);
+            const type = match ? match[1] : "line";
+            const value = (match ? cmd.slice(match[0].length) : cmd).trim();
+            if (type === "line" || type === "char") {
+                sessions[sessions.length - 1].commands.push({type, value});
+            }
+        }
+    }
+    return sessions;
+}
+
+function getInterpreter(gameFile: string): string | null {
+    if (gameFile.endsWith(".ulx")) return "glulxe";
+    if (/\.z\d$/.test(gameFile)) return "fizmo";
+    if (gameFile.endsWith(".hex")) return "hugo";
+    return null;
+}
+
+function getInterpCmd(interpName: string): string[] {
+    if (platform === "wasm") {
+        return ["wasmtime", "run", "--env", "WASIGLK_STATS=1", "--dir=.", join(interpDir, `${interpName}.wasm`)];
+    }
+    return [join(interpDir, interpName)];
+}
+
+// ---------------------------------------------------------------------------
+// Session runner
+// ---------------------------------------------------------------------------
+
+class Interp {
+    proc: ReturnType<typeof Bun.spawn>;
+    reader: ReadableStreamDefaultReader<Uint8Array>;
+    leftover = "";
+    gen = 0;
+    inputWin: {id: number; type: string} | null = null;
+    special = false;
+
+    constructor(args: string[]) {
+        this.proc = Bun.spawn(args, {
+            stdin: "pipe",
+            stdout: "pipe",
+            stderr: "pipe",
+            cwd: scriptDir,
+            env: {...process.env, WASIGLK_STATS: "1"},
+        });
+        this.reader = (this.proc.stdout as ReadableStream<Uint8Array>).getReader();
+    }
+
+    async send(event: object) {
+        this.proc.stdin!.write(JSON.stringify(event) + "\n");
+        await this.proc.stdin!.flush();
+    }
+
+    /** Read updates until the interpreter waits for input. Returns bytes read. */
+    async readTurn(): Promise<number> {
+        let bytes = 0;
+        while (true) {
+            const nl = this.leftover.indexOf("\n");
+            if (nl >= 0) {
+                const line = this.leftover.slice(0, nl);
+                this.leftover = this.leftover.slice(nl + 1);
+                bytes += Buffer.byteLength(line) + 1;
+                if (!line.trim()) continue;
+                const update = JSON.parse(line);
+                this.gen = update.gen;
+                this.special = update.specialinput !== undefined;
+                if (update.input?.length) this.inputWin = {id: update.input[0].id, type: update.input[0].type};
+                if (update.exit || update.input !== undefined || update.specialinput !== undefined || !update.disable) {
+                    return bytes;
+                }
+                continue;
+            }
+            const {done, value} = await this.reader.read();
+            if (done) return bytes;
+            this.leftover += Buffer.from(value).toString("utf-8");
+        }
+    }
+
+    /** Close stdin so the interpreter exits, then collect its stats line. */
+    async finish(): Promise<Stats | null> {
+        this.proc.stdin!.end();
+        const stderr = await new Response(this.proc.stderr as ReadableStream<Uint8Array>).text();
+        await this.proc.exited;
+        const match = stderr.match(/^wasiglk-stats: (.*)$/m);
+        if (!match) return null;
+        const stats: Record<string, number> = {};
+        for (const pair of match[1].split(" ")) {
+            const [key, val] = pair.split("=");
+            stats[key] = Number(val);
+        }
+        return stats as unknown as Stats;
+    }
+}
+
+const initEvent = {
+    type: "init", gen: 0,
+    metrics: {width: 800, height: 480, gridcharwidth: 10, gridcharheight: 12, buffercharwidth: 10, buffercharheight: 12},
+    support: ["timer", "hyperlinks", "graphics", "graphicswin"],
+};
+
+async function benchSession(interpCmd: string[], session: Session) {
+    const interp = new Interp([...interpCmd, session.gamefile]);
+    await interp.send(initEvent);
+    let bytes = await interp.readTurn();
+    let turns = 1;
+
+    for (const cmd of session.commands) {
+        if (!interp.inputWin) break;
+        const value = cmd.type === "char" && cmd.value === "" ? "return" : cmd.value;
+        await interp.send({type: interp.inputWin.type, gen: interp.gen, window: interp.inputWin.id, value});
+        bytes += await interp.readTurn();
+        turns++;
+    }
+
+    const stats = await interp.finish();
+    return {turns, bytes, stats};
+}
+
+const eventCount = 500;
+
+async function benchEvents(interpCmd: string[], gamefile: string) {
+    const interp = new Interp([...interpCmd, gamefile]);
+    await interp.send(initEvent);
+    await interp.readTurn();
+
+    let events = 0;
+    const start = performance.now();
+    while (events < eventCount && interp.inputWin) {
+        const value = interp.inputWin.type === "char" ? " " : "look";
+        await interp.send({type: interp.inputWin.type, gen: interp.gen, window: interp.inputWin.id, value});
+        await interp.readTurn();
+        events++;
+    }
+    const seconds = (performance.now() - start) / 1000;
+
+    const stats = await interp.finish();
+    return {events, seconds, stats};
+}
+
+const saveCount = 1000;
+const saveFile = "benchsave";
+
+/** Answer the file prompt that a save or restore command raises. */
+async function saveOrRestore(interp: Interp, command: string): Promise<boolean> {
+    if (!interp.inputWin) return false;
+    await interp.send({type: "line", gen: interp.gen, window: interp.inputWin.id, value: command});
+    await interp.readTurn();
+    if (!interp.special) return false;
+    await interp.send({type: "specialresponse", gen: interp.gen, response: "fileref_prompt", value: saveFile});
+    await interp.readTurn();
+    return true;
+}
+
+async function benchSaves(interpCmd: string[], gamefile: string) {
+    const interp = new Interp([...interpCmd, gamefile]);
+    await interp.send(initEvent);
+    await interp.readTurn();
+
+    let roundTrips = 0;
+    const start = performance.now();
+    while (roundTrips < saveCount) {
+        if (!await saveOrRestore(interp, "save")) break;
+        if (!await saveOrRestore(interp, "restore")) break;
+        roundTrips++;
+    }
+    const seconds = (performance.now() - start) / 1000;
+
+    await interp.finish();
+    const savePath = join(scriptDir, saveFile);
+    const saveSize = existsSync(savePath) ? statSync(savePath).size : 0;
+    try { unlinkSync(savePath); } catch {}
+    return {roundTrips, seconds, saveSize};
+}
+
+function findRegtests(filter?: string): string[] {
+    return readdirSync(scriptDir)
+        .filter(f => f.endsWith(".regtest") && !f.includes("profiler"))
+        .filter(f => filter ? f.includes(filter) : defaultGames.some(g => f.startsWith(g)))
+        .sort();
+}
+
+function interpreterFor(file: string): string | null {
+    const sessions = parseSessions(join(scriptDir, file));
+    if (sessions.length === 0) return null;
+    const interpName = getInterpreter(sessions[0].gamefile);
+    if (!interpName) return null;
+    const interpPath = platform === "wasm" ? join(interpDir, `${interpName}.wasm`) : join(interpDir, interpName);
+    if (!existsSync(interpPath)) {
+        console.log(`SKIP: Interpreter ${interpPath} not found`);
+        return null;
+    }
+    return interpName;
+}
+
+// ---------------------------------------------------------------------------
+// Main
+// ---------------------------------------------------------------------------
+
+async function mainEvents(filter?: string) {
+    console.log(`platform: ${platform}`);
+    console.log("game                       events    events/sec   reads/event");
+    for (const file of findRegtests(filter)) {
+        const interpName = interpreterFor(file);
+        if (!interpName) continue;
+        const gamefile = parseSessions(join(scriptDir, file))[0].gamefile;
+        const result = await benchEvents(getInterpCmd(interpName), gamefile);
+        const reads = result.stats?.reads ?? 0;
+        console.log(
+            basename(file, ".regtest").padEnd(26),
+            String(result.events).padStart(7),
+            (result.events / result.seconds).toFixed(0).padStart(13),
+            // +1 for the init event
+            (reads / (result.events + 1)).toFixed(2).padStart(13),
+        );
+    }
+}
+
+async function mainSaves(filter?: string) {
+    console.log(`platform: ${platform}`);
+    console.log("game                       round trips   ms/save+restore   save KB");
+    for (const file of findRegtests(filter ?? "advent.ulx")) {
+        const interpName = interpreterFor(file);
+        if (!interpName) continue;
+        const gamefile = parseSessions(join(scriptDir, file))[0].gamefile;
+        const result = await benchSaves(getInterpCmd(interpName), gamefile);
+        console.log(
+            basename(file, ".regtest").padEnd(26),
+            String(result.roundTrips).padStart(12),
+            (result.seconds * 1000 / Math.max(1, result.roundTrips)).toFixed(3).padStart(17),
+            (result.saveSize / 1024).toFixed(1).padStart(9),
+        );
+    }
+}
+
+async function main() {
+    if (process.argv[2] === "--events") return mainEvents(process.argv[3]);
+    if (process.argv[2] === "--saves") return mainSaves(process.argv[3]);
+    const filter = process.argv[2];
+    const regtestFiles = findRegtests(filter);
+
+    console.log("game                        turns   bytes/turn   allocs/turn   arena grows   arena KB   pool hits   pool misses");
+    for (const file of regtestFiles) {
+        const interpName = interpreterFor(file);
+        if (!interpName) continue;
+        const sessions = parseSessions(join(scriptDir, file));
+
+        let turns = 0, bytes = 0, allocs = 0, grows = 0, capacity = 0, hits = 0, misses = 0;
+        for (const session of sessions) {
+            const result = await benchSession(getInterpCmd(interpName), session);
+            turns += result.turns;
+            bytes += result.bytes;
+            allocs += result.stats?.allocs ?? 0;
+            grows += result.stats?.arena_grows ?? 0;
+            capacity = Math.max(capacity, result.stats?.arena_capacity ?? 0);
+            hits += result.stats?.pool_hits ?? 0;
+            misses += result.stats?.pool_misses ?? 0;
+        }
+
+        console.log(
+            basename(file, ".regtest").padEnd(26),
+            String(turns).padStart(7),
+            (bytes / turns).toFixed(0).padStart(12),
+            (allocs / turns).toFixed(2).padStart(13),
+            String(grows).padStart(13),
+            (capacity / 1024).toFixed(1).padStart(10),
+            String(hits).padStart(11),
+            String(misses).padStart(13),
+        );
+    }
+}
+
+main().catch(e => { console.error(e); process.exit(1); });
@@ -26,6 +26,7 @@ export async function check() {
 export async function build(...args: string[]) {
     await testZig();
     await buildZig(...args);
+    if (args.includes('-Dpreinit=true')) await preinit();
     await optimize();
     await testServer();
 }
@@ -37,6 +38,30 @@ export async function buildZig(...args: string[]) {
     await $`zig build --build-file packages/server/build.zig --prefix packages/server/zig-out ${optimize} ${args}`;
 }
 
+// Snapshot interpreters built with -Dpreinit=true using Wizer, so the C runtime
+// and static constructors have already run when a session starts
+export async function preinit() {
+    const glob = new Glob("packages/server/zig-out/bin/*.wasm");
+    const wasmFiles = Array.from(glob.scanSync("."));
+
+    if (wasmFiles.length === 0) {
+        throw new Error("No WASM files found - run buildZig -Dpreinit=true first");
+    }
+
+    console.log(`Pre-initializing ${wasmFiles.length} WASM files with Wizer...`);
+
+    await Promise.all(wasmFiles.map(async (f) => {
+        await $`wizer --allow-wasi \
+            --wasm-bulk-memory true \
+            --wasm-reference-types true \
+            --init-func wizer.initialize \
+            -r _start=wizer.resume \
+            ${f} -o ${f}.preinit`.quiet();
+        await $`mv ${f}.preinit ${f}`;
+        console.log(`  ${f.split('/').pop()}: pre-initialized`);
+    }));
+}
+
 // Optimize WASM binaries with Binaryen wasm-opt
 export async function optimize() {
     const glob = new Glob("packages/server/zig-out/bin/*.wasm");
@@ -103,6 +128,13 @@ export async function testServer(...args: string[]) {
     await $`PLATFORM=wasm bun packages/server/tests/regtest.ts ${args}`;
 }
 
+// Run server I/O benchmarks (bytes and allocations per turn on the regtest games,
+// events/second through glk_select with --events, save/restore timing with --saves;
+// PLATFORM=wasm for wasm builds)
+export async function benchServer(...args: string[]) {
+    await $`bun packages/server/tests/bench.ts ${args}`;
+}
+
 // Run all tests (Zig + client unit tests + E2E)
 export async function test(...args: string[]) {
     await testZig();
@@ -238,8 +270,8 @@ export async function ci() {
 
 // Command dispatch - same pattern as bodar.ts
 const commands: Record<string, Function> = {
-    version, clean, check, build, buildZig, optimize, bundle,
-    testZig, testClient, testServer, test, testE2E, testHeaded,
+    version, clean, check, build, buildZig, preinit, optimize, bundle,
+    testZig, testClient, testServer, benchServer, test, testE2E, testHeaded,
     demo, serve, jsr, publish, ci
 };
 